@@ -1,118 +1,186 @@
+#include <sys/stat.h>
 #include "audio_player.h"
 
+// Entries sit in a hash map for lookup and on a doubly-linked list in use
+// order, so a hit, an insert and an eviction are all constant time.
+
+static void lru_unlink(AudioBufferCache *cache, CachedAudioBuffer *entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else cache->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else cache->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(AudioBufferCache *cache, CachedAudioBuffer *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->lru_prev = entry;
+    cache->lru_head = entry;
+    if (!cache->lru_tail) cache->lru_tail = entry;
+}
+
+static void free_cache_entry(CachedAudioBuffer *entry) {
+    pcm_block_unref(entry->block);   // Freed once playback lets go too
+    free(entry->filepath);
+    free(entry);
+}
+
+static void remove_cache_entry(AudioBufferCache *cache, CachedAudioBuffer *entry) {
+    g_hash_table_remove(cache->index, entry->filepath);
+    lru_unlink(cache, entry);
+    cache->count--;
+    cache->total_memory -= entry->memory_size;
+    free_cache_entry(entry);
+}
+
 void init_audio_cache(AudioBufferCache *cache, size_t max_memory_mb) {
-    cache->buffers = NULL;
+    cache->index = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->lru_head = NULL;
+    cache->lru_tail = NULL;
     cache->count = 0;
-    cache->capacity = 0;
     cache->total_memory = 0;
     cache->max_memory = max_memory_mb * 1024 * 1024;
+    memset(&cache->stats, 0, sizeof(cache->stats));
     printf("Audio cache initialized with %zu MB limit\n", max_memory_mb);
 }
 
 CachedAudioBuffer* find_in_cache(AudioBufferCache *cache, const char *filepath) {
-    for (int i = 0; i < cache->count; i++) {
-        if (strcmp(cache->buffers[i]->filepath, filepath) == 0) {
-            cache->buffers[i]->last_access = time(NULL);
-            printf("Cache HIT: %s\n", filepath);
-            return cache->buffers[i];
-        }
+    CachedAudioBuffer *entry = cache->index ?
+        (CachedAudioBuffer*)g_hash_table_lookup(cache->index, filepath) : NULL;
+    if (!entry) {
+        cache->stats.misses++;
+        return NULL;
     }
-    printf("Cache MISS: %s\n", filepath);
-    return NULL;
-}
 
-void evict_oldest_from_cache(AudioBufferCache *cache) {
-    if (cache->count == 0) return;
-    
-    // Find oldest (LRU)
-    int oldest_idx = 0;
-    time_t oldest_time = cache->buffers[0]->last_access;
-    
-    for (int i = 1; i < cache->count; i++) {
-        if (cache->buffers[i]->last_access < oldest_time) {
-            oldest_time = cache->buffers[i]->last_access;
-            oldest_idx = i;
-        }
+    // A file edited since it was decoded is decoded again
+    if (entry->has_file_stat &&
+        is_file_modified(filepath, entry->modification_time, entry->file_size)) {
+        remove_cache_entry(cache, entry);
+        cache->stats.invalidations++;
+        cache->stats.misses++;
+        return NULL;
     }
-    
-    CachedAudioBuffer *evicted = cache->buffers[oldest_idx];
-    printf("Cache EVICT: %s (%.2f MB, last used %ld sec ago)\n", 
-           evicted->filepath,
-           evicted->memory_size / (1024.0 * 1024.0),
-           time(NULL) - evicted->last_access);
-    
-    cache->total_memory -= evicted->memory_size;
-    free(evicted->data);
-    free(evicted->filepath);
-    free(evicted);
-    
-    // Shift array down
-    for (int i = oldest_idx; i < cache->count - 1; i++) {
-        cache->buffers[i] = cache->buffers[i + 1];
+
+    entry->last_access = time(NULL);
+    if (entry != cache->lru_head) {
+        lru_unlink(cache, entry);
+        lru_push_front(cache, entry);
     }
-    cache->count--;
+    cache->stats.hits++;
+    return entry;
 }
 
-void add_to_cache(AudioBufferCache *cache, const char *filepath, 
-                  int16_t *data, size_t length, int sample_rate, 
-                  int channels, int bits_per_sample, double song_duration) {
-    
-    size_t memory_size = length * sizeof(int16_t);
-    
-    // Evict until we have space
-    while (cache->total_memory + memory_size > cache->max_memory && cache->count > 0) {
-        evict_oldest_from_cache(cache);
+// Lookup without touching the LRU order or the counters
+bool audio_cache_contains(const AudioBufferCache *cache, const char *filepath) {
+    return cache->index && g_hash_table_contains(cache->index, filepath);
+}
+
+// Drop the least recently used entry that no player is holding. Entries in
+// use are skipped, so their eviction waits until the player lets go; only
+// the track playing now and the one being loaded are ever in use.
+static bool evict_oldest_from_cache(AudioBufferCache *cache) {
+    CachedAudioBuffer *victim = cache->lru_tail;
+    while (victim && pcm_block_refs(victim->block) > 1) {
+        victim = victim->lru_prev;
     }
-    
-    // Don't cache if single file is larger than max
+    if (!victim) return false;
+
+    remove_cache_entry(cache, victim);
+    cache->stats.evictions++;
+    return true;
+}
+
+// The cache takes its own reference to block; the caller keeps theirs
+void add_to_cache(AudioBufferCache *cache, const char *filepath,
+                  PCMBlock *block, int sample_rate,
+                  int channels, int bits_per_sample, double song_duration) {
+
+    if (!block || !cache->index) return;
+    size_t memory_size = block->mapped_size;
+
+    // Don't cache if single file is larger than max, and keep whatever is
+    // cached for the path already
     if (memory_size > cache->max_memory) {
-        printf("Cache SKIP: %s too large (%.2f MB)\n", 
+        printf("Cache SKIP: %s too large (%.2f MB)\n",
                filepath, memory_size / (1024.0 * 1024.0));
         return;
     }
-    
-    // Expand capacity if needed
-    if (cache->count >= cache->capacity) {
-        int new_capacity = cache->capacity == 0 ? 10 : cache->capacity * 2;
-        CachedAudioBuffer **new_buffers = realloc(cache->buffers, 
-                                                   new_capacity * sizeof(CachedAudioBuffer*));
-        if (!new_buffers) return;
-        cache->buffers = new_buffers;
-        cache->capacity = new_capacity;
+
+    // Replace an existing entry for the same path
+    CachedAudioBuffer *existing = (CachedAudioBuffer*)g_hash_table_lookup(cache->index, filepath);
+    if (existing) {
+        remove_cache_entry(cache, existing);
+        cache->stats.invalidations++;
+    }
+
+    // Evict until we have space
+    while (cache->total_memory + memory_size > cache->max_memory) {
+        if (!evict_oldest_from_cache(cache)) {
+            printf("Cache SKIP: %s, everything cached is in use\n", filepath);
+            return;
+        }
     }
-    
+
     // Create new cache entry
-    CachedAudioBuffer *cached = malloc(sizeof(CachedAudioBuffer));
+    CachedAudioBuffer *cached = (CachedAudioBuffer*)calloc(1, sizeof(CachedAudioBuffer));
+    if (!cached) return;
     cached->filepath = strdup(filepath);
-    cached->data = data;  // Takes ownership
-    cached->length = length;
+    if (!cached->filepath) {
+        free(cached);
+        return;
+    }
+    cached->block = pcm_block_ref(block);
+    cached->length = block->length;
     cached->sample_rate = sample_rate;
     cached->channels = channels;
     cached->bits_per_sample = bits_per_sample;
     cached->song_duration = song_duration;
     cached->last_access = time(NULL);
     cached->memory_size = memory_size;
-    
-    cache->buffers[cache->count++] = cached;
+
+    struct stat file_stat;
+    if (stat(filepath, &file_stat) == 0) {
+        cached->has_file_stat = true;
+        cached->modification_time = file_stat.st_mtime;
+        cached->file_size = file_stat.st_size;
+    }
+
+    g_hash_table_insert(cache->index, cached->filepath, cached);
+    lru_push_front(cache, cached);
+    cache->count++;
     cache->total_memory += memory_size;
-    
-    printf("Cache ADD: %s (%.2f MB) - Cache now %d files, %.2f/%.2f MB\n",
-           filepath,
-           memory_size / (1024.0 * 1024.0),
-           cache->count,
-           cache->total_memory / (1024.0 * 1024.0),
-           cache->max_memory / (1024.0 * 1024.0));
+    cache->stats.insertions++;
+}
+
+void get_audio_cache_stats(const AudioBufferCache *cache, CacheStats *stats) {
+    *stats = cache->stats;
+    stats->entries = cache->count;
+    stats->bytes = cache->total_memory;
 }
 
 void cleanup_audio_cache(AudioBufferCache *cache) {
-    for (int i = 0; i < cache->count; i++) {
-        free(cache->buffers[i]->data);
-        free(cache->buffers[i]->filepath);
-        free(cache->buffers[i]);
+    if (cache->index) {
+        CacheStats stats;
+        get_audio_cache_stats(cache, &stats);
+        printf("Audio cache: %llu hits, %llu misses, %llu evictions, %zu files (%.2f MB)\n",
+               (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+               (unsigned long long)stats.evictions, stats.entries,
+               stats.bytes / (1024.0 * 1024.0));
+    }
+
+    CachedAudioBuffer *entry = cache->lru_head;
+    while (entry) {
+        CachedAudioBuffer *next = entry->lru_next;
+        free_cache_entry(entry);
+        entry = next;
+    }
+    if (cache->index) {
+        g_hash_table_destroy(cache->index);
     }
-    free(cache->buffers);
-    cache->buffers = NULL;
+    cache->index = NULL;
+    cache->lru_head = NULL;
+    cache->lru_tail = NULL;
     cache->count = 0;
-    cache->capacity = 0;
     cache->total_memory = 0;
 }
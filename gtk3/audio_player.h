@@ -28,29 +28,55 @@
 #include "audioconverter.h"
 #include "convertoggtowav.h"
 #include "convertflactowav.h"
+#include "audio_stream.h"
+#include "resampler.h"
+#include "disk_cache.h"
+#include "metadata_index.h"
+#include "metadata_scanner.h"
+#include "prefetch.h"
 #include "equalizer.h"
 #include "visualization.h"
 #include "cdg.h"
 #include "zip_support.h"
 
+// Counters shared by both caches, see get_audio_cache_stats() and
+// get_conversion_cache_stats()
 typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;        // Dropped to make room
+    uint64_t invalidations;    // Dropped because the entry went stale
+    size_t entries;
+    size_t bytes;
+} CacheStats;
+
+typedef struct CachedAudioBuffer {
     char *filepath;
-    int16_t *data;
+    PCMBlock *block;      // Cache's own reference, shared with the player on a hit
     size_t length;
     int sample_rate;
     int channels;
     int bits_per_sample;
     double song_duration;
     time_t last_access;
-    size_t memory_size;  // in bytes
+    size_t memory_size;  // in bytes, as mapped
+    bool has_file_stat;  // False for virtual files, which never change
+    time_t modification_time;   // Of the file when it was cached
+    off_t file_size;
+    struct CachedAudioBuffer *lru_prev;   // Towards most recently used
+    struct CachedAudioBuffer *lru_next;   // Towards least recently used
 } CachedAudioBuffer;
 
+// Hash map from path to entry plus an LRU list threaded through the entries
 typedef struct {
-    CachedAudioBuffer **buffers;
+    GHashTable *index;            // filepath -> CachedAudioBuffer*, keys owned by the entries
+    CachedAudioBuffer *lru_head;  // Most recently used
+    CachedAudioBuffer *lru_tail;  // Least recently used
     int count;
-    int capacity;
     size_t total_memory;  // Track total memory used
     size_t max_memory;    // Maximum memory to use (e.g., 500 MB)
+    CacheStats stats;
 } AudioBufferCache;
 
 typedef struct {
@@ -137,27 +163,61 @@ typedef struct {
 
 
 // Conversion Cache Entries.
-typedef struct {
+typedef struct ConversionCacheEntry {
     char *original_path;
     char *virtual_filename;
     time_t modification_time;
     off_t file_size;
+    size_t memory_size;       // Of the converted virtual file
+    struct ConversionCacheEntry *lru_prev;
+    struct ConversionCacheEntry *lru_next;
 } ConversionCacheEntry;
 
-// Cache File Conversion
+#define CONVERSION_CACHE_MAX_ENTRIES 256
+
+// Cache File Conversion, same layout as AudioBufferCache
 typedef struct {
-    ConversionCacheEntry *entries;
+    GHashTable *index;        // original_path -> ConversionCacheEntry*
+    ConversionCacheEntry *lru_head;
+    ConversionCacheEntry *lru_tail;
     int count;
-    int capacity;
+    size_t total_memory;
+    CacheStats stats;
 } ConversionCache;
 
-// Audio buffer structure
+// Audio buffer structure (GUI-side view of the current source)
 typedef struct {
-    int16_t *data;
+    PCMBlock *block;    // Not a reference, valid while it is the current source
+    const int16_t *data;
     size_t length;
-    size_t position;
+    std::atomic<size_t> position;   // Published by the audio callback
 } AudioBuffer;
 
+// Playback state owned by the audio callback. The GUI thread only changes it
+// through AudioPlayer::audio_commands, see post_audio_command().
+#define AUDIO_MAX_SOURCE_CHANNELS 8
+
+typedef struct {
+    PCMBlock *block;           // Returned through retired_sources when replaced
+    const int16_t *data;       // block->data
+    AudioStream *stream;
+    size_t length;
+    size_t position;           // In source samples
+    int channels;              // Of the source
+    int sample_rate;           // Of the source
+    bool playing;
+    int volume;
+    double speed;
+    bool preserve_pitch;
+    
+    // Source -> [time stretch] -> resampler -> device rate and channels
+    bool stretching;           // Time stretch stage is in the chain
+    Resampler resampler;
+    TimeStretch stretch;
+    int16_t frame[AUDIO_MAX_SOURCE_CHANNELS];   // Source frame being assembled
+    int frame_fill;
+} AudioRTState;
+
 // Play queue structure
 typedef struct {
     char **files;           // Array of file paths
@@ -198,6 +258,8 @@ typedef struct {
     GtkWidget *queue_search_entry;
     guint queue_filter_timeout_id;
     char queue_filter_text[256];
+    GHashTable *queue_pending_rows;   // Path -> GArray of rows waiting for the scanner
+    guint queue_refresh_id;           // Rebuild once scanned tags may change the filtering
     
     bool is_loaded;
     bool is_playing;
@@ -209,16 +271,29 @@ typedef struct {
     guint update_timer_id;
     
     AudioBuffer audio_buffer;
+    AudioStream *stream;       // Set instead of audio_buffer.data while streaming
     SDL_AudioDeviceID audio_device;
     SDL_AudioSpec audio_spec;
-    pthread_mutex_t audio_mutex;
+
+    // Lock-free link to the audio callback
+    AudioRTState rt;
+    AudioCommandQueue audio_commands;       // GUI -> callback
+    AudioCommandQueue retired_sources;      // Callback -> GUI, buffers to free
+    std::atomic<bool> playback_ended;       // Set by the callback at end of track
+    std::atomic<unsigned long> underrun_count;
+    unsigned long reported_underruns;
+    bool audio_device_paused;               // Callback can't run while set
     
     // Audio format info for seeking calculations
     int sample_rate;
     int channels;
     int bits_per_sample;
     double playback_speed;
-    double speed_accumulator;  // For fractional sample stepping
+    bool preserve_pitch;
+    ResampleQuality resample_quality;
+    ResampleQuality posted_filter_quality;  // Of the last filter sent to the callback
+    double posted_filter_cutoff;
+    GtkWidget *preserve_pitch_check;
     
     Visualizer *visualizer;
     GtkWidget *vis_controls;
@@ -250,6 +325,10 @@ typedef struct {
     bool minimized_to_tray;
     
     AudioBufferCache audio_cache; 
+    DiskCache disk_cache;         // Decoded PCM kept across restarts
+    MetadataIndex metadata_index; // Queue tags and durations kept across restarts
+    MetadataScanner metadata_scanner;  // Fills queue columns in from the index
+    Prefetcher prefetch;          // Decodes upcoming queue entries into audio_cache
 
 #ifndef _WIN32
     guint dbus_owner_id;
@@ -282,10 +361,6 @@ extern double playTime;
 extern bool isPlaying;
 extern bool paused;
 extern int globalVolume;
-extern double playwait;
-
-// External functions from midiplayer
-extern void processEvents(void);
 
 // Global player instance
 extern AudioPlayer *player;
@@ -318,6 +393,7 @@ bool reorder_queue_item(PlayQueue *queue, int from_index, int to_index);
 void on_queue_model_row_deleted(GtkTreeModel *model, GtkTreePath *path, gpointer user_data);
 void on_queue_model_row_inserted(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer user_data);
 void cleanup_queue_filter(AudioPlayer *player);
+void on_queue_metadata_scanned(ScannedTrack *tracks, int count, void *user_data);
 GtkWidget* create_queue_search_bar(AudioPlayer *player);
 void update_queue_display_with_filter(AudioPlayer *player, bool scroll_to_current = true);
 bool matches_filter(const char *text, const char *filter);
@@ -334,7 +410,7 @@ bool get_settings_path(char *path, size_t path_size);
 
 // Audio functions
 void audio_callback(void* userdata, Uint8* stream, int len);
-bool init_audio(AudioPlayer *player, int sample_rate = SAMPLE_RATE, int channels = AUDIO_CHANNELS);
+bool init_audio(AudioPlayer *player);
 
 // Tray Icon
 void on_tray_icon_activate(GtkStatusIcon *status_icon, gpointer user_data);
@@ -356,6 +432,16 @@ bool convert_audio_to_wav(AudioPlayer *player, const char* filename);
 bool convert_ogg_to_wav(AudioPlayer *player, const char* filename);
 bool convert_flac_to_wav(AudioPlayer *player, const char* filename);
 bool load_wav_file(AudioPlayer *player, const char* wav_path);
+bool load_stream_file(AudioPlayer *player, const char* filename);
+bool has_audio_source(AudioPlayer *player);
+void set_audio_source(AudioPlayer *player, PCMBlock *block, AudioStream *stream, size_t length);
+void release_audio_source(AudioPlayer *player);
+void post_audio_command(AudioPlayer *player, AudioCommandType type, size_t position = 0, int ivalue = 0, double dvalue = 0.0);
+void collect_retired_audio(AudioPlayer *player);
+void update_resample_filter(AudioPlayer *player);
+void schedule_prefetch(AudioPlayer *player);
+void collect_prefetched_audio(AudioPlayer *player);
+unsigned long get_audio_underrun_count(AudioPlayer *player);
 bool load_file(AudioPlayer *player, const char *filename);
 bool load_file_from_queue(AudioPlayer *player);
 int scale_size(int base_size, int screen_dimension, int base_dimension);
@@ -395,12 +481,14 @@ bool remove_from_queue(PlayQueue *queue, int index);
 void on_queue_item_clicked(GtkListBox *listbox, GtkListBoxRow *row, gpointer user_data);
 double get_scale_factor(GtkWidget *widget);
 void on_speed_changed(GtkRange *range, gpointer user_data);
+void on_preserve_pitch_toggled(GtkToggleButton *button, gpointer user_data);
 
 // Caching
 void init_conversion_cache(ConversionCache *cache);
 void cleanup_conversion_cache(ConversionCache *cache);
 const char* get_cached_conversion(ConversionCache *cache, const char* original_path);
 void add_to_conversion_cache(ConversionCache *cache, const char* original_path, const char* virtual_filename);
+void get_conversion_cache_stats(const ConversionCache *cache, CacheStats *stats);
 bool is_file_modified(const char* filepath, time_t cached_time, off_t cached_size);
 
 // GUI creation function
@@ -474,9 +562,11 @@ bool generate_karaoke_zip_from_lrc(const std::string& lrc_path, std::string& out
 
 void init_audio_cache(AudioBufferCache *cache, size_t max_memory_mb);
 CachedAudioBuffer* find_in_cache(AudioBufferCache *cache, const char *filepath);
+bool audio_cache_contains(const AudioBufferCache *cache, const char *filepath);
 void add_to_cache(AudioBufferCache *cache, const char *filepath, 
-                  int16_t *data, size_t length, int sample_rate, 
+                  PCMBlock *block, int sample_rate, 
                   int channels, int bits_per_sample, double song_duration);
 void cleanup_audio_cache(AudioBufferCache *cache);
+void get_audio_cache_stats(const AudioBufferCache *cache, CacheStats *stats);
 
 #endif // AUDIO_PLAYER_H
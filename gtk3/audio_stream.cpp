@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <glib.h>
+#include "audio_stream.h"
+#include "convertflactowav.h"
+#include "convertoggtowav.h"
+#include "convertopustowav.h"
+#include "audioconverter.h"
+
+// ---------------------------------------------------------------------------
+// PCM ring buffer
+// ---------------------------------------------------------------------------
+
+bool pcm_ring_init(PCMRingBuffer *ring, size_t min_capacity) {
+    size_t capacity = 1;
+    while (capacity < min_capacity) capacity <<= 1;
+
+    ring->data = (int16_t*)malloc(capacity * sizeof(int16_t));
+    if (!ring->data) {
+        printf("Failed to allocate PCM ring buffer (%zu samples)\n", capacity);
+        return false;
+    }
+    ring->capacity = capacity;
+    ring->mask = capacity - 1;
+    ring->write_pos.store(0);
+    ring->read_pos.store(0);
+    return true;
+}
+
+void pcm_ring_free(PCMRingBuffer *ring) {
+    free(ring->data);
+    ring->data = NULL;
+    ring->capacity = 0;
+    ring->mask = 0;
+}
+
+size_t pcm_ring_available(PCMRingBuffer *ring) {
+    size_t w = ring->write_pos.load(std::memory_order_acquire);
+    size_t r = ring->read_pos.load(std::memory_order_acquire);
+    return w - r;
+}
+
+size_t pcm_ring_space(PCMRingBuffer *ring) {
+    return ring->capacity - pcm_ring_available(ring);
+}
+
+size_t pcm_ring_write(PCMRingBuffer *ring, const int16_t *src, size_t count) {
+    size_t w = ring->write_pos.load(std::memory_order_relaxed);
+    size_t r = ring->read_pos.load(std::memory_order_acquire);
+    size_t space = ring->capacity - (w - r);
+    if (count > space) count = space;
+    if (count == 0) return 0;
+
+    size_t start = w & ring->mask;
+    size_t first = ring->capacity - start;
+    if (first > count) first = count;
+    memcpy(ring->data + start, src, first * sizeof(int16_t));
+    if (count > first) {
+        memcpy(ring->data, src + first, (count - first) * sizeof(int16_t));
+    }
+
+    ring->write_pos.store(w + count, std::memory_order_release);
+    return count;
+}
+
+size_t pcm_ring_read(PCMRingBuffer *ring, int16_t *dst, size_t count) {
+    size_t r = ring->read_pos.load(std::memory_order_relaxed);
+    size_t w = ring->write_pos.load(std::memory_order_acquire);
+    size_t available = w - r;
+    if (count > available) count = available;
+    if (count == 0) return 0;
+
+    size_t start = r & ring->mask;
+    size_t first = ring->capacity - start;
+    if (first > count) first = count;
+    memcpy(dst, ring->data + start, first * sizeof(int16_t));
+    if (count > first) {
+        memcpy(dst + first, ring->data, (count - first) * sizeof(int16_t));
+    }
+
+    ring->read_pos.store(r + count, std::memory_order_release);
+    return count;
+}
+
+// ---------------------------------------------------------------------------
+// Producer thread
+// ---------------------------------------------------------------------------
+
+static void* stream_producer_thread(void *arg) {
+    AudioStream *stream = (AudioStream*)arg;
+    StreamDecoder *dec = stream->decoder;
+    size_t chunk_samples = STREAM_DECODE_FRAMES * stream->channels;
+
+    int16_t *scratch = (int16_t*)malloc(chunk_samples * sizeof(int16_t));
+    if (!scratch) {
+        stream->failed.store(true);
+        return NULL;
+    }
+
+    unsigned handled = stream->seek_done.load();
+
+    while (!stream->stop_requested.load()) {
+        unsigned request = stream->seek_request.load(std::memory_order_acquire);
+        if (request != handled) {
+            uint64_t frame = stream->seek_frame.load();
+            if (!dec->seek(dec, frame)) {
+                printf("Stream seek to frame %llu failed\n", (unsigned long long)frame);
+            }
+            handled = request;
+            stream->eof.store(false);
+            stream->flush_pos.store(stream->ring.write_pos.load(std::memory_order_relaxed));
+            stream->seek_done.store(handled, std::memory_order_release);
+            continue;
+        }
+
+        // Stay alive at end of stream so playback can still seek backwards
+        if (stream->eof.load()) {
+            g_usleep(5000);
+            continue;
+        }
+
+        // Wait until a whole decode step fits, the ring only ever holds complete frames
+        if (pcm_ring_space(&stream->ring) < chunk_samples) {
+            g_usleep(5000);
+            continue;
+        }
+
+        size_t frames = dec->read(dec, scratch, STREAM_DECODE_FRAMES);
+        if (frames == 0) {
+            stream->eof.store(true, std::memory_order_release);
+            continue;
+        }
+
+        pcm_ring_write(&stream->ring, scratch, frames * stream->channels);
+    }
+
+    free(scratch);
+    return NULL;
+}
+
+static void stream_stop_producer(AudioStream *stream) {
+    if (!stream->thread_started) return;
+    stream->stop_requested.store(true);
+    pthread_join(stream->thread, NULL);
+    stream->thread_started = false;
+}
+
+// ---------------------------------------------------------------------------
+// Public API
+// ---------------------------------------------------------------------------
+
+static void get_lower_extension(const char *filename, char *ext_lower, size_t size) {
+    ext_lower[0] = '\0';
+    const char *ext = strrchr(filename, '.');
+    if (!ext) return;
+
+    strncpy(ext_lower, ext, size - 1);
+    ext_lower[size - 1] = '\0';
+    for (int i = 0; ext_lower[i]; i++) {
+        ext_lower[i] = tolower(ext_lower[i]);
+    }
+}
+
+bool is_streamable_file(const char *filename) {
+    char ext_lower[10];
+    get_lower_extension(filename, ext_lower, sizeof(ext_lower));
+
+    return strcmp(ext_lower, ".flac") == 0 ||
+           strcmp(ext_lower, ".ogg") == 0 ||
+           strcmp(ext_lower, ".opus") == 0 ||
+           strcmp(ext_lower, ".mid") == 0 ||
+           strcmp(ext_lower, ".midi") == 0;
+}
+
+AudioStream* audio_stream_open(const char *filename) {
+    char ext_lower[10];
+    get_lower_extension(filename, ext_lower, sizeof(ext_lower));
+
+    StreamDecoder *dec = NULL;
+    if (strcmp(ext_lower, ".flac") == 0) {
+        dec = flac_stream_decoder_open(filename);
+    } else if (strcmp(ext_lower, ".ogg") == 0) {
+        dec = ogg_stream_decoder_open(filename);
+    } else if (strcmp(ext_lower, ".opus") == 0) {
+        dec = opus_stream_decoder_open(filename);
+    } else if (strcmp(ext_lower, ".mid") == 0 || strcmp(ext_lower, ".midi") == 0) {
+        dec = midi_stream_decoder_open(filename);
+    }
+
+    if (!dec) return NULL;
+
+    // Without a known length the progress bar and seeking can't work, let the
+    // caller fall back to a full decode instead
+    if (dec->total_frames == 0 || dec->sample_rate <= 0 || dec->channels <= 0) {
+        printf("Stream %s has no usable length, not streaming\n", filename);
+        dec->close(dec);
+        return NULL;
+    }
+
+    AudioStream *stream = new AudioStream();
+    stream->decoder = dec;
+    stream->sample_rate = dec->sample_rate;
+    stream->channels = dec->channels;
+    stream->total_frames = dec->total_frames;
+    stream->thread_started = false;
+    stream->stop_requested.store(false);
+    stream->eof.store(false);
+    stream->failed.store(false);
+    stream->seek_frame.store(0);
+    stream->seek_request.store(0);
+    stream->seek_done.store(0);
+    stream->flush_pos.store(0);
+    stream->consumer_requested = 0;
+    stream->consumer_flushed = 0;
+    stream->stage_pos = 0;
+    stream->stage_len = 0;
+
+    size_t ring_samples = (size_t)dec->sample_rate * dec->channels * STREAM_RING_SECONDS;
+    if (!pcm_ring_init(&stream->ring, ring_samples)) {
+        dec->close(dec);
+        delete stream;
+        return NULL;
+    }
+
+    printf("Streaming %s: %d Hz, %d channels, %llu frames\n", dec->format,
+           stream->sample_rate, stream->channels, (unsigned long long)stream->total_frames);
+    return stream;
+}
+
+bool audio_stream_start(AudioStream *stream) {
+    if (stream->thread_started) return true;
+
+    stream->stop_requested.store(false);
+    if (pthread_create(&stream->thread, NULL, stream_producer_thread, stream) != 0) {
+        printf("Failed to start stream decoder thread\n");
+        return false;
+    }
+    stream->thread_started = true;
+    return true;
+}
+
+bool audio_stream_wait_prebuffer(AudioStream *stream, int prebuffer_ms, int timeout_ms) {
+    size_t wanted = (size_t)stream->sample_rate * stream->channels * prebuffer_ms / 1000;
+    if (wanted > stream->ring.capacity / 2) wanted = stream->ring.capacity / 2;
+
+    for (int waited = 0; waited < timeout_ms; waited += 2) {
+        if (stream->failed.load()) return false;
+        if (stream->eof.load() || pcm_ring_available(&stream->ring) >= wanted) return true;
+        g_usleep(2000);
+    }
+
+    printf("Stream prebuffer timed out\n");
+    return pcm_ring_available(&stream->ring) > 0;
+}
+
+void audio_stream_close(AudioStream *stream) {
+    if (!stream) return;
+
+    stream_stop_producer(stream);
+    if (stream->decoder) {
+        stream->decoder->close(stream->decoder);
+        stream->decoder = NULL;
+    }
+    pcm_ring_free(&stream->ring);
+    delete stream;
+}
+
+// ---------------------------------------------------------------------------
+// Consumer side
+// ---------------------------------------------------------------------------
+
+void audio_stream_request_seek(AudioStream *stream, uint64_t frame) {
+    if (frame >= stream->total_frames) frame = stream->total_frames - 1;
+
+    // Whatever is staged or still in the ring is pre-seek audio
+    stream->stage_pos = 0;
+    stream->stage_len = 0;
+    stream->consumer_requested++;
+    stream->seek_frame.store(frame);
+    stream->seek_request.store(stream->consumer_requested, std::memory_order_release);
+}
+
+bool audio_stream_seek_pending(AudioStream *stream) {
+    return stream->consumer_flushed != stream->consumer_requested;
+}
+
+// Drop ring contents the producer wrote before its latest seek
+static void stream_apply_flush(AudioStream *stream) {
+    unsigned done = stream->seek_done.load(std::memory_order_acquire);
+    if (done == stream->consumer_flushed) return;
+
+    size_t flush = stream->flush_pos.load();
+    size_t r = stream->ring.read_pos.load(std::memory_order_relaxed);
+    if ((ptrdiff_t)(flush - r) > 0) {
+        stream->ring.read_pos.store(flush, std::memory_order_release);
+    }
+    stream->stage_pos = 0;
+    stream->stage_len = 0;
+    stream->consumer_flushed = done;
+}
+
+// Make sure the staging buffer holds the current sample. Samples skipped past
+// the end of the stage (playback speed > 1) are dropped from the next refill.
+bool audio_stream_fill(AudioStream *stream) {
+    if (stream->consumer_flushed != stream->consumer_requested) {
+        stream_apply_flush(stream);
+        if (audio_stream_seek_pending(stream)) return false;
+    }
+    if (stream->stage_pos < stream->stage_len) return true;
+
+    size_t carry = stream->stage_pos - stream->stage_len;
+    size_t got = pcm_ring_read(&stream->ring, stream->stage, STREAM_STAGE_SAMPLES);
+    if (got == 0) {
+        // Underrun or end of stream, keep the carry for the next attempt
+        stream->stage_pos = carry;
+        stream->stage_len = 0;
+        return false;
+    }
+
+    stream->stage_len = got;
+    stream->stage_pos = carry < got ? carry : got;
+    return stream->stage_pos < stream->stage_len;
+}
+
+int16_t audio_stream_current(AudioStream *stream) {
+    return stream->stage[stream->stage_pos];
+}
+
+void audio_stream_advance(AudioStream *stream) {
+    stream->stage_pos++;
+}
+
+bool audio_stream_finished(AudioStream *stream) {
+    return !audio_stream_seek_pending(stream) &&
+           stream->eof.load(std::memory_order_acquire) &&
+           stream->stage_pos >= stream->stage_len &&
+           pcm_ring_available(&stream->ring) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Command queue
+// ---------------------------------------------------------------------------
+
+bool audio_command_push(AudioCommandQueue *queue, const AudioCommand *cmd) {
+    size_t head = queue->head.load(std::memory_order_relaxed);
+    size_t tail = queue->tail.load(std::memory_order_acquire);
+    if (head - tail >= AUDIO_COMMAND_QUEUE_SIZE) return false;
+
+    queue->items[head & (AUDIO_COMMAND_QUEUE_SIZE - 1)] = *cmd;
+    queue->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool audio_command_pop(AudioCommandQueue *queue, AudioCommand *cmd) {
+    size_t tail = queue->tail.load(std::memory_order_relaxed);
+    size_t head = queue->head.load(std::memory_order_acquire);
+    if (tail == head) return false;
+
+    *cmd = queue->items[tail & (AUDIO_COMMAND_QUEUE_SIZE - 1)];
+    queue->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
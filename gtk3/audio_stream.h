@@ -0,0 +1,139 @@
+#ifndef AUDIO_STREAM_H
+#define AUDIO_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <atomic>
+#include "pcm_block.h"
+#include "resampler.h"
+
+// Streaming playback: a producer thread decodes the file in small chunks into
+// a bounded PCM ring buffer which the SDL audio callback drains. Playback can
+// start as soon as a short prebuffer is filled and memory use no longer grows
+// with the length of the track.
+
+#define STREAM_RING_SECONDS   2      // Decoded audio kept ahead of playback
+#define STREAM_PREBUFFER_MS   300    // Audio decoded before playback starts
+#define STREAM_DECODE_FRAMES  4096   // Frames decoded per producer step
+#define STREAM_STAGE_SAMPLES  2048   // Samples pulled from the ring per refill
+
+// Single-producer / single-consumer ring of interleaved 16-bit samples.
+// The producer only advances write_pos and the consumer only advances
+// read_pos, so neither side needs a lock.
+typedef struct {
+    int16_t *data;
+    size_t capacity;   // In samples, always a power of two
+    size_t mask;
+    std::atomic<size_t> write_pos;
+    std::atomic<size_t> read_pos;
+} PCMRingBuffer;
+
+bool pcm_ring_init(PCMRingBuffer *ring, size_t min_capacity);
+void pcm_ring_free(PCMRingBuffer *ring);
+size_t pcm_ring_available(PCMRingBuffer *ring);
+size_t pcm_ring_space(PCMRingBuffer *ring);
+size_t pcm_ring_write(PCMRingBuffer *ring, const int16_t *src, size_t count);
+size_t pcm_ring_read(PCMRingBuffer *ring, int16_t *dst, size_t count);
+
+// Incremental decoder for one file format. read() returns interleaved 16-bit
+// frames (0 at end of stream), seek() positions on an absolute frame.
+typedef struct StreamDecoder StreamDecoder;
+struct StreamDecoder {
+    const char *format;
+    int sample_rate;
+    int channels;
+    uint64_t total_frames;
+    void *state;
+
+    size_t (*read)(StreamDecoder *dec, int16_t *out, size_t max_frames);
+    bool (*seek)(StreamDecoder *dec, uint64_t frame);
+    void (*close)(StreamDecoder *dec);
+};
+
+typedef struct AudioStream {
+    StreamDecoder *decoder;
+    PCMRingBuffer ring;
+    int sample_rate;
+    int channels;
+    uint64_t total_frames;
+
+    // Producer thread
+    pthread_t thread;
+    bool thread_started;
+    std::atomic<bool> stop_requested;
+    std::atomic<bool> eof;
+    std::atomic<bool> failed;
+
+    // Seek handshake. The consumer bumps seek_request; the producer seeks the
+    // decoder, records where post-seek data starts in flush_pos and then
+    // publishes seek_done. The consumer skips everything before flush_pos.
+    std::atomic<uint64_t> seek_frame;
+    std::atomic<unsigned> seek_request;
+    std::atomic<unsigned> seek_done;
+    std::atomic<size_t> flush_pos;
+
+    // Consumer-side state, only touched by the audio callback
+    unsigned consumer_requested;
+    unsigned consumer_flushed;
+    int16_t stage[STREAM_STAGE_SAMPLES];
+    size_t stage_pos;
+    size_t stage_len;
+} AudioStream;
+
+bool is_streamable_file(const char *filename);
+
+AudioStream* audio_stream_open(const char *filename);
+bool audio_stream_start(AudioStream *stream);
+bool audio_stream_wait_prebuffer(AudioStream *stream, int prebuffer_ms, int timeout_ms);
+void audio_stream_close(AudioStream *stream);
+
+// Consumer side, called from the audio callback. None of these block.
+void audio_stream_request_seek(AudioStream *stream, uint64_t frame);
+bool audio_stream_seek_pending(AudioStream *stream);
+bool audio_stream_fill(AudioStream *stream);
+int16_t audio_stream_current(AudioStream *stream);
+void audio_stream_advance(AudioStream *stream);
+bool audio_stream_finished(AudioStream *stream);
+
+// Commands posted by the GUI thread to the audio callback. The callback owns
+// the playback state and applies these at the start of each block, so it
+// never has to take a lock shared with the GUI.
+typedef enum {
+    AUDIO_CMD_SET_SOURCE,   // block/stream/length/channels/sample_rate; old source is retired
+    AUDIO_CMD_PLAY,
+    AUDIO_CMD_PAUSE,
+    AUDIO_CMD_STOP,         // Pause and rewind
+    AUDIO_CMD_SEEK,         // position in interleaved samples
+    AUDIO_CMD_VOLUME,       // ivalue 0-100+
+    AUDIO_CMD_SPEED,        // dvalue
+    AUDIO_CMD_RESAMPLE_FILTER,    // filter, built by the GUI thread; the old one is retired
+    AUDIO_CMD_PRESERVE_PITCH      // ivalue 0/1
+} AudioCommandType;
+
+typedef struct {
+    AudioCommandType type;
+    size_t position;
+    size_t length;
+    int ivalue;
+    int sample_rate;
+    double dvalue;
+    PCMBlock *block;       // Reference owned by whoever holds the command
+    AudioStream *stream;
+    ResampleFilter *filter;
+} AudioCommand;
+
+#define AUDIO_COMMAND_QUEUE_SIZE 256   // Power of two
+
+// Single-producer / single-consumer command queue, same scheme as the PCM ring
+typedef struct {
+    AudioCommand items[AUDIO_COMMAND_QUEUE_SIZE];
+    std::atomic<size_t> head;   // Next slot to write, producer only
+    std::atomic<size_t> tail;   // Next slot to read, consumer only
+} AudioCommandQueue;
+
+bool audio_command_push(AudioCommandQueue *queue, const AudioCommand *cmd);
+bool audio_command_pop(AudioCommandQueue *queue, AudioCommand *cmd);
+
+#endif // AUDIO_STREAM_H
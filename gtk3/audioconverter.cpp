@@ -11,13 +11,7 @@
 #include <windows.h>
 #endif
 
-// External variables and functions needed from midiplayer.cpp
-extern double playTime;
-extern bool isPlaying;
-extern double playwait;
-extern int globalVolume;
-extern void processEvents();
-
+// External functions needed from convertmidi.cpp
 bool convertMidiToWav(const char* midi_filename, const char* wav_filename, int volume);
 
 // In-memory MIDI to WAV conversion function
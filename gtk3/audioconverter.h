@@ -2,6 +2,7 @@
 #define AUDIO_CONVERTER_H
 
 #include <vector>
+#include "audio_stream.h"
 
 // Function to convert MP3 data to WAV data in memory
 bool convertMp3ToWavInMemory(const std::vector<uint8_t>& mp3Data, std::vector<uint8_t>& wavData);
@@ -10,4 +11,7 @@ bool convertMp3ToWavInMemory(const std::vector<uint8_t>& mp3Data, std::vector<ui
 bool convertMidiToWavInMemory(const std::vector<uint8_t>& midiData, std::vector<uint8_t>& wavData);
 bool convertMidiToWav(const char* midi_filename, const char* wav_filename, int volume);
 
+// Synthesise a MIDI file live for streaming playback (see audio_stream.h)
+StreamDecoder* midi_stream_decoder_open(const char* midi_filename);
+
 #endif // AUDIO_CONVERTER_H
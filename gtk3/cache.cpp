@@ -2,21 +2,76 @@
 #include "vfs.h"
 #include "audio_player.h"
 
+// Same structure as the audio cache: a hash map for lookup and an LRU list
+// threaded through the entries, so lookups and evictions never scan.
+
+static void lru_unlink(ConversionCache *cache, ConversionCacheEntry *entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else cache->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else cache->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(ConversionCache *cache, ConversionCacheEntry *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->lru_prev = entry;
+    cache->lru_head = entry;
+    if (!cache->lru_tail) cache->lru_tail = entry;
+}
+
+static void free_conversion_entry(ConversionCacheEntry *entry) {
+    g_free(entry->original_path);
+    g_free(entry->virtual_filename);
+    g_free(entry);
+}
+
+// Unlink an entry and free it. An evicted entry also takes its converted
+// virtual file with it, nothing else refers to that name.
+static void remove_conversion_entry(ConversionCache *cache, ConversionCacheEntry *entry, bool delete_file) {
+    g_hash_table_remove(cache->index, entry->original_path);
+    lru_unlink(cache, entry);
+    cache->count--;
+    cache->total_memory -= entry->memory_size;
+    if (delete_file && get_virtual_file(entry->virtual_filename)) {
+        delete_virtual_file(entry->virtual_filename);
+    }
+    free_conversion_entry(entry);
+}
+
 void init_conversion_cache(ConversionCache *cache) {
-    cache->entries = NULL;
+    cache->index = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->lru_head = NULL;
+    cache->lru_tail = NULL;
     cache->count = 0;
-    cache->capacity = 0;
+    cache->total_memory = 0;
+    memset(&cache->stats, 0, sizeof(cache->stats));
 }
 
 void cleanup_conversion_cache(ConversionCache *cache) {
-    for (int i = 0; i < cache->count; i++) {
-        g_free(cache->entries[i].original_path);
-        g_free(cache->entries[i].virtual_filename);
+    if (cache->index) {
+        CacheStats stats;
+        get_conversion_cache_stats(cache, &stats);
+        printf("Conversion cache: %llu hits, %llu misses, %llu evictions, %zu entries\n",
+               (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+               (unsigned long long)stats.evictions, stats.entries);
+    }
+    
+    ConversionCacheEntry *entry = cache->lru_head;
+    while (entry) {
+        ConversionCacheEntry *next = entry->lru_next;
+        free_conversion_entry(entry);
+        entry = next;
     }
-    g_free(cache->entries);
-    cache->entries = NULL;
+    if (cache->index) {
+        g_hash_table_destroy(cache->index);
+    }
+    cache->index = NULL;
+    cache->lru_head = NULL;
+    cache->lru_tail = NULL;
     cache->count = 0;
-    cache->capacity = 0;
+    cache->total_memory = 0;
 }
 
 bool is_file_modified(const char* filepath, time_t cached_time, off_t cached_size) {
@@ -29,41 +84,34 @@ bool is_file_modified(const char* filepath, time_t cached_time, off_t cached_siz
 }
 
 const char* get_cached_conversion(ConversionCache *cache, const char* original_path) {
-    for (int i = 0; i < cache->count; i++) {
-        if (strcmp(cache->entries[i].original_path, original_path) == 0) {
-            // Check if the original file has been modified since caching
-            if (!is_file_modified(original_path, cache->entries[i].modification_time, cache->entries[i].file_size)) {
-                // Check if virtual file still exists by trying to get it
-                VirtualFile* vf = get_virtual_file(cache->entries[i].virtual_filename);
-                if (vf != NULL) {
-                    printf("Cache hit: Using cached conversion %s for %s\n", 
-                           cache->entries[i].virtual_filename, original_path);
-                    return cache->entries[i].virtual_filename;
-                } else {
-                    printf("Cache miss: Virtual file %s no longer exists\n", cache->entries[i].virtual_filename);
-                }
-            } else {
-                printf("Cache miss: File %s has been modified since caching\n", original_path);
-            }
-            
-            // Remove invalid cache entry
-            g_free(cache->entries[i].original_path);
-            g_free(cache->entries[i].virtual_filename);
-            
-            // Shift remaining entries
-            for (int j = i; j < cache->count - 1; j++) {
-                cache->entries[j] = cache->entries[j + 1];
-            }
-            cache->count--;
-            return NULL;
-        }
+    ConversionCacheEntry *entry = cache->index ?
+        (ConversionCacheEntry*)g_hash_table_lookup(cache->index, original_path) : NULL;
+    if (!entry) {
+        cache->stats.misses++;
+        return NULL;
+    }
+    
+    // The original must be unchanged since caching and the converted
+    // virtual file must still be around
+    if (is_file_modified(original_path, entry->modification_time, entry->file_size) ||
+        get_virtual_file(entry->virtual_filename) == NULL) {
+        remove_conversion_entry(cache, entry, true);
+        cache->stats.invalidations++;
+        cache->stats.misses++;
+        return NULL;
     }
     
-    printf("Cache miss: No cached conversion found for %s\n", original_path);
-    return NULL;
+    if (entry != cache->lru_head) {
+        lru_unlink(cache, entry);
+        lru_push_front(cache, entry);
+    }
+    cache->stats.hits++;
+    return entry->virtual_filename;
 }
 
 void add_to_conversion_cache(ConversionCache *cache, const char* original_path, const char* virtual_filename) {
+    if (!cache->index) return;
+    
     // Get file stats for the original file
     struct stat file_stat;
     if (stat(original_path, &file_stat) != 0) {
@@ -71,25 +119,37 @@ void add_to_conversion_cache(ConversionCache *cache, const char* original_path,
         return;
     }
     
-    // Expand cache if needed
-    if (cache->count >= cache->capacity) {
-        int new_capacity = cache->capacity == 0 ? 10 : cache->capacity * 2;
-        ConversionCacheEntry *new_entries = (ConversionCacheEntry*)g_realloc(cache->entries, 
-                                                      new_capacity * sizeof(ConversionCacheEntry));
-        if (!new_entries) {
-            printf("Warning: Failed to expand conversion cache\n");
-            return;
-        }
-        cache->entries = new_entries;
-        cache->capacity = new_capacity;
+    ConversionCacheEntry *existing = (ConversionCacheEntry*)g_hash_table_lookup(cache->index, original_path);
+    if (existing) {
+        // Keep the virtual file if the new entry reuses it
+        bool same_file = strcmp(existing->virtual_filename, virtual_filename) == 0;
+        remove_conversion_entry(cache, existing, !same_file);
+        cache->stats.invalidations++;
     }
     
-    // Add new entry
-    cache->entries[cache->count].original_path = g_strdup(original_path);
-    cache->entries[cache->count].virtual_filename = g_strdup(virtual_filename);
-    cache->entries[cache->count].modification_time = file_stat.st_mtime;
-    cache->entries[cache->count].file_size = file_stat.st_size;
-    cache->count++;
+    while (cache->count >= CONVERSION_CACHE_MAX_ENTRIES && cache->lru_tail) {
+        remove_conversion_entry(cache, cache->lru_tail, true);
+        cache->stats.evictions++;
+    }
+    
+    ConversionCacheEntry *entry = g_new0(ConversionCacheEntry, 1);
+    entry->original_path = g_strdup(original_path);
+    entry->virtual_filename = g_strdup(virtual_filename);
+    entry->modification_time = file_stat.st_mtime;
+    entry->file_size = file_stat.st_size;
+    
+    VirtualFile *vf = get_virtual_file(virtual_filename);
+    entry->memory_size = vf ? virtual_file_size(vf) : 0;
     
-    printf("Added to conversion cache: %s -> %s\n", original_path, virtual_filename);
+    g_hash_table_insert(cache->index, entry->original_path, entry);
+    lru_push_front(cache, entry);
+    cache->count++;
+    cache->total_memory += entry->memory_size;
+    cache->stats.insertions++;
+}
+
+void get_conversion_cache_stats(const ConversionCache *cache, CacheStats *stats) {
+    *stats = cache->stats;
+    stats->entries = cache->count;
+    stats->bytes = cache->total_memory;
 }
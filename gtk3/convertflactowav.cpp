@@ -327,3 +327,167 @@ bool convert_flac_to_wav(AudioPlayer *player, const char* filename) {
     printf("FLAC conversion to virtual file complete\n");
     return true;
 }
+
+// Streaming decoder: decodes one FLAC frame at a time straight from the file
+struct FlacStreamState {
+    FLAC__StreamDecoder* decoder;
+    std::vector<int16_t> pending;   // Interleaved samples of the last decoded frame
+    size_t pending_pos;
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t bits_per_sample;
+    uint64_t total_samples;
+    bool error_occurred;
+};
+
+static FLAC__StreamDecoderWriteStatus flac_stream_write_callback(
+    const FLAC__StreamDecoder* decoder, const FLAC__Frame* frame,
+    const FLAC__int32* const buffer[], void* client_data) {
+    (void)decoder;
+    FlacStreamState* state = (FlacStreamState*)client_data;
+
+    uint32_t samples = frame->header.blocksize;
+    uint32_t channels = frame->header.channels;
+    int bits = (int)frame->header.bits_per_sample;
+
+    state->pending.clear();
+    state->pending_pos = 0;
+    state->pending.reserve(samples * channels);
+
+    for (uint32_t i = 0; i < samples; i++) {
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            FLAC__int32 sample = buffer[ch][i];
+            if (bits > 16) {
+                sample >>= (bits - 16);
+            } else if (bits < 16) {
+                sample <<= (16 - bits);
+            }
+            state->pending.push_back((int16_t)sample);
+        }
+    }
+
+    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void flac_stream_metadata_callback(const FLAC__StreamDecoder* decoder,
+                                          const FLAC__StreamMetadata* metadata, void* client_data) {
+    (void)decoder;
+    FlacStreamState* state = (FlacStreamState*)client_data;
+
+    if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
+        state->sample_rate = metadata->data.stream_info.sample_rate;
+        state->channels = metadata->data.stream_info.channels;
+        state->bits_per_sample = metadata->data.stream_info.bits_per_sample;
+        state->total_samples = metadata->data.stream_info.total_samples;
+    }
+}
+
+static void flac_stream_error_callback(const FLAC__StreamDecoder* decoder,
+                                       FLAC__StreamDecoderErrorStatus status, void* client_data) {
+    (void)decoder;
+    FlacStreamState* state = (FlacStreamState*)client_data;
+
+    printf("FLAC stream decoder error: %s\n", FLAC__StreamDecoderErrorStatusString[status]);
+    state->error_occurred = true;
+}
+
+static size_t flac_stream_read(StreamDecoder* dec, int16_t* out, size_t max_frames) {
+    FlacStreamState* state = (FlacStreamState*)dec->state;
+
+    while (state->pending_pos >= state->pending.size()) {
+        if (FLAC__stream_decoder_get_state(state->decoder) == FLAC__STREAM_DECODER_END_OF_STREAM) {
+            return 0;
+        }
+        state->pending.clear();
+        state->pending_pos = 0;
+        if (!FLAC__stream_decoder_process_single(state->decoder)) {
+            return 0;
+        }
+    }
+
+    size_t available_frames = (state->pending.size() - state->pending_pos) / dec->channels;
+    size_t frames = available_frames < max_frames ? available_frames : max_frames;
+    size_t count = frames * dec->channels;
+
+    memcpy(out, state->pending.data() + state->pending_pos, count * sizeof(int16_t));
+    state->pending_pos += count;
+    return frames;
+}
+
+static bool flac_stream_seek(StreamDecoder* dec, uint64_t frame) {
+    FlacStreamState* state = (FlacStreamState*)dec->state;
+
+    // The write callback delivers the frame starting at the seek target
+    state->pending.clear();
+    state->pending_pos = 0;
+
+    if (!FLAC__stream_decoder_seek_absolute(state->decoder, frame)) {
+        if (FLAC__stream_decoder_get_state(state->decoder) == FLAC__STREAM_DECODER_SEEK_ERROR) {
+            FLAC__stream_decoder_flush(state->decoder);
+        }
+        return false;
+    }
+    return true;
+}
+
+static void flac_stream_close(StreamDecoder* dec) {
+    FlacStreamState* state = (FlacStreamState*)dec->state;
+    if (state) {
+        FLAC__stream_decoder_finish(state->decoder);
+        FLAC__stream_decoder_delete(state->decoder);
+        delete state;
+    }
+    delete dec;
+}
+
+StreamDecoder* flac_stream_decoder_open(const char* filename) {
+    FlacStreamState* state = new FlacStreamState();
+    state->pending_pos = 0;
+    state->sample_rate = 0;
+    state->channels = 0;
+    state->bits_per_sample = 0;
+    state->total_samples = 0;
+    state->error_occurred = false;
+
+    state->decoder = FLAC__stream_decoder_new();
+    if (!state->decoder) {
+        printf("Failed to create FLAC decoder\n");
+        delete state;
+        return NULL;
+    }
+
+    FLAC__StreamDecoderInitStatus init_status = FLAC__stream_decoder_init_file(
+        state->decoder, filename,
+        flac_stream_write_callback,
+        flac_stream_metadata_callback,
+        flac_stream_error_callback,
+        state);
+
+    if (init_status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+        printf("Failed to open FLAC stream %s: %s\n", filename,
+               FLAC__StreamDecoderInitStatusString[init_status]);
+        FLAC__stream_decoder_delete(state->decoder);
+        delete state;
+        return NULL;
+    }
+
+    if (!FLAC__stream_decoder_process_until_end_of_metadata(state->decoder) ||
+        state->sample_rate == 0 || state->channels == 0) {
+        printf("Failed to read FLAC stream info: %s\n", filename);
+        FLAC__stream_decoder_finish(state->decoder);
+        FLAC__stream_decoder_delete(state->decoder);
+        delete state;
+        return NULL;
+    }
+
+    StreamDecoder* dec = new StreamDecoder();
+    dec->format = "FLAC";
+    dec->sample_rate = state->sample_rate;
+    dec->channels = state->channels;
+    dec->total_frames = state->total_samples;
+    dec->state = state;
+    dec->read = flac_stream_read;
+    dec->seek = flac_stream_seek;
+    dec->close = flac_stream_close;
+    return dec;
+}
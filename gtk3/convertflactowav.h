@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <stdint.h>
+#include "audio_stream.h"
 
 // Convert FLAC file to WAV data in memory
 bool convertFlacToWavInMemory(const std::vector<uint8_t>& flac_data, std::vector<uint8_t>& wav_data);
@@ -10,4 +11,7 @@ bool convertFlacToWavInMemory(const std::vector<uint8_t>& flac_data, std::vector
 // Convert FLAC file to WAV file
 bool convertFlacToWav(const char* flac_path, const char* wav_path);
 
+// Open a FLAC file for incremental decoding (see audio_stream.h)
+StreamDecoder* flac_stream_decoder_open(const char* flac_path);
+
 #endif // CONVERTFLACTOWAV_H
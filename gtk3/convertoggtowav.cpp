@@ -283,3 +283,72 @@ bool convert_ogg_to_wav(AudioPlayer *player, const char* filename) {
     printf("OGG conversion to virtual file complete\n");
     return true;
 }
+
+// Streaming decoder: reads straight from the file via vorbisfile
+struct OggStreamState {
+    OggVorbis_File vf;
+    int current_section;
+};
+
+static size_t ogg_stream_read(StreamDecoder* dec, int16_t* out, size_t max_frames) {
+    OggStreamState* state = (OggStreamState*)dec->state;
+    size_t frame_bytes = dec->channels * sizeof(int16_t);
+    size_t wanted = max_frames * frame_bytes;
+    size_t filled = 0;
+
+    // ov_read returns at most one packet, keep going until the block is full
+    while (filled < wanted) {
+        long bytes_read = ov_read(&state->vf, (char*)out + filled, (int)(wanted - filled),
+                                  0, 2, 1, &state->current_section);
+        if (bytes_read == OV_HOLE) continue;
+        if (bytes_read <= 0) break;
+        filled += bytes_read;
+    }
+
+    return filled / frame_bytes;
+}
+
+static bool ogg_stream_seek(StreamDecoder* dec, uint64_t frame) {
+    OggStreamState* state = (OggStreamState*)dec->state;
+    return ov_pcm_seek(&state->vf, (ogg_int64_t)frame) == 0;
+}
+
+static void ogg_stream_close(StreamDecoder* dec) {
+    OggStreamState* state = (OggStreamState*)dec->state;
+    if (state) {
+        ov_clear(&state->vf);
+        delete state;
+    }
+    delete dec;
+}
+
+StreamDecoder* ogg_stream_decoder_open(const char* filename) {
+    OggStreamState* state = new OggStreamState();
+    state->current_section = 0;
+
+    if (ov_fopen(filename, &state->vf) < 0) {
+        printf("Invalid OGG Vorbis stream: %s\n", filename);
+        delete state;
+        return NULL;
+    }
+
+    vorbis_info* vi = ov_info(&state->vf, -1);
+    ogg_int64_t total_samples = ov_pcm_total(&state->vf, -1);
+    if (!vi || total_samples < 0) {
+        printf("OGG stream is not seekable: %s\n", filename);
+        ov_clear(&state->vf);
+        delete state;
+        return NULL;
+    }
+
+    StreamDecoder* dec = new StreamDecoder();
+    dec->format = "OGG";
+    dec->sample_rate = vi->rate;
+    dec->channels = vi->channels;
+    dec->total_frames = (uint64_t)total_samples;
+    dec->state = state;
+    dec->read = ogg_stream_read;
+    dec->seek = ogg_stream_seek;
+    dec->close = ogg_stream_close;
+    return dec;
+}
@@ -1,6 +1,8 @@
 #ifndef CONVERTOGGTOWAV_H
 #define CONVERTOGGTOWAV_H
 
+#include "audio_stream.h"
+
 #ifdef __cplusplus
 extern "C" {
 #include <vector>
@@ -11,6 +13,9 @@ bool convertOggToWav(const char* ogg_filename, const char* wav_filename);
 #ifdef __cplusplus
 }
 bool convertOggToWavInMemory(const std::vector<uint8_t>& ogg_data, std::vector<uint8_t>& wav_data);
+
+// Open an OGG Vorbis file for incremental decoding (see audio_stream.h)
+StreamDecoder* ogg_stream_decoder_open(const char* ogg_filename);
 #endif
 
 #endif // CONVERTOGGTOWAV_H
@@ -319,3 +319,72 @@ bool convert_opus_to_wav(AudioPlayer *player, const char* filename) {
     printf("Opus conversion to virtual file complete\n");
     return true;
 }
+
+// Streaming decoder: reads straight from the file via opusfile. Output is
+// mono or stereo; multichannel streams are downmixed by op_read_stereo.
+struct OpusStreamState {
+    OggOpusFile* of;
+};
+
+static size_t opus_stream_read(StreamDecoder* dec, int16_t* out, size_t max_frames) {
+    OpusStreamState* state = (OpusStreamState*)dec->state;
+    size_t filled = 0;
+
+    while (filled < max_frames) {
+        int buf_size = (int)((max_frames - filled) * dec->channels);
+        opus_int16* dst = out + filled * dec->channels;
+        int frames_read = dec->channels == 2
+            ? op_read_stereo(state->of, dst, buf_size)
+            : op_read(state->of, dst, buf_size, NULL);
+        if (frames_read == OP_HOLE) continue;
+        if (frames_read <= 0) break;
+        filled += frames_read;
+    }
+
+    return filled;
+}
+
+static bool opus_stream_seek(StreamDecoder* dec, uint64_t frame) {
+    OpusStreamState* state = (OpusStreamState*)dec->state;
+    return op_pcm_seek(state->of, (ogg_int64_t)frame) == 0;
+}
+
+static void opus_stream_close(StreamDecoder* dec) {
+    OpusStreamState* state = (OpusStreamState*)dec->state;
+    if (state) {
+        op_free(state->of);
+        delete state;
+    }
+    delete dec;
+}
+
+StreamDecoder* opus_stream_decoder_open(const char* filename) {
+    int error = 0;
+    OggOpusFile* of = op_open_file(filename, &error);
+    if (!of) {
+        printf("Invalid Opus stream: %s (error: %d)\n", filename, error);
+        return NULL;
+    }
+
+    const OpusHead* head = op_head(of, -1);
+    ogg_int64_t total_samples = op_pcm_total(of, -1);
+    if (!head || total_samples < 0) {
+        printf("Opus stream is not seekable: %s\n", filename);
+        op_free(of);
+        return NULL;
+    }
+
+    OpusStreamState* state = new OpusStreamState();
+    state->of = of;
+
+    StreamDecoder* dec = new StreamDecoder();
+    dec->format = "Opus";
+    dec->sample_rate = 48000;  // Opus always decodes at 48kHz
+    dec->channels = head->channel_count == 1 ? 1 : 2;
+    dec->total_frames = (uint64_t)total_samples;
+    dec->state = state;
+    dec->read = opus_stream_read;
+    dec->seek = opus_stream_seek;
+    dec->close = opus_stream_close;
+    return dec;
+}
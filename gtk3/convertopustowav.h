@@ -33,6 +33,13 @@ bool convertOpusToWav(const char* opus_filename, const char* wav_filename);
  */
 bool convert_opus_to_wav(AudioPlayer *player, const char* filename);
 
+/**
+ * Open an Opus file for incremental decoding (see audio_stream.h)
+ * @param filename Path to input Opus file
+ * @return Decoder producing 48kHz mono/stereo frames, or NULL on failure
+ */
+StreamDecoder* opus_stream_decoder_open(const char* filename);
+
 #ifdef __cplusplus
 }
 #endif
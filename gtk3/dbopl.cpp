@@ -38,8 +38,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
+#include <mutex>
 #include "dbopl.h"
 
+//Vector kernels for the 2 operator block synthesis, picked at runtime.
+//Build with DBOPL_NO_SIMD to keep only the scalar routines. Setting
+//DBOPL_SIMD=sse4.1 or DBOPL_SIMD=scalar in the environment caps the pick,
+//so each kernel the CPU supports can be checked against the scalar ones.
+#if !defined( DBOPL_NO_SIMD ) && ( DBOPL_WAVE == WAVE_TABLEMUL ) && defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define DBOPL_SIMD 1
+#include <immintrin.h>
+#endif
+
 
 #ifndef PI
 #define PI 3.14159265358979323846
@@ -150,7 +160,8 @@ static Bit16u SinTable[ 512 ];
 
 //6 is just 0 shifted and masked
 
-static Bit16s WaveTable[ 8 * 512 ];
+//Padded as the vector gathers read 32 bits at a time
+static Bit16s WaveTable[ 8 * 512 + 2 ];
 //Distance into WaveTable the wave starts
 static const Bit16u WaveBaseTable[8] = {
 	0x000, 0x200, 0x200, 0x800,
@@ -171,7 +182,7 @@ static const Bit16u WaveStartTable[8] = {
 #endif
 
 #if ( DBOPL_WAVE == WAVE_TABLEMUL )
-static Bit16u MulTable[ 384 ];
+static Bit16u MulTable[ 384 + 2 ];
 #endif
 
 static Bit8u KslTable[ 8 * 16 ];
@@ -599,6 +610,313 @@ Bits INLINE Operator::GetSample( Bits modulation ) {
 	}
 }
 
+#if ( DBOPL_WAVE == WAVE_TABLEMUL )
+/*
+	Block synthesis of 2 operator channels
+	Envelope and phase of an operator don't depend on the wave, so a block first runs
+	them for both operators, with the steady envelope states inlined instead of a handler
+	call per sample. The modulator stays serial for its feedback, after which the carrier
+	samples are independent and a kernel does them, several at once where the cpu has
+	vector instructions. Every step is the integer math of GetSample, so the output is
+	the same to the bit as the sample by sample loop.
+*/
+
+//Samples per pass; ForwardLFO seldom hands out more at common rates
+#define BLOCK_SAMPLES 64
+
+struct CarrierBlock {
+	Bitu samples;
+	const Bit32s* vol;
+	const Bit32u* index;
+	const Bit32s* mod;			//Modulator output, added to the phase for FM or the sample for AM
+	bool am;
+	bool stereo;
+	const Bit16s* waveBase;
+	Bit32u waveMask;
+	Bit32s maskLeft;
+	Bit32s maskRight;
+	Bit32s* output;
+};
+
+typedef void ( *CarrierKernel )( const CarrierBlock& block );
+//out[ i ] = offset + ( ( start + ( i + 1 ) * step ) >> shift ), with 32 bit wrapping
+typedef void ( *RampKernel )( Bit32s* out, Bitu samples, Bit32u start, Bit32u step, Bit32u shift, Bit32s offset );
+
+static INLINE Bit32s CarrierSample( const CarrierBlock& b, Bitu i ) {
+	Bit32s vol = b.vol[ i ];
+	Bit32s sample = 0;
+	if ( !ENV_SILENT( vol ) ) {
+		Bit32u index = b.index[ i ] + ( b.am ? 0 : b.mod[ i ] );
+		sample = ( b.waveBase[ index & b.waveMask ] * MulTable[ vol >> ENV_EXTRA ] ) >> MUL_SH;
+	}
+	if ( b.am )
+		sample += b.mod[ i ];
+	return sample;
+}
+
+static INLINE void CarrierTail( const CarrierBlock& b, Bitu i ) {
+	for ( ; i < b.samples; i++ ) {
+		Bit32s sample = CarrierSample( b, i );
+		if ( b.stereo ) {
+			b.output[ i * 2 + 0 ] += sample & b.maskLeft;
+			b.output[ i * 2 + 1 ] += sample & b.maskRight;
+		} else {
+			b.output[ i ] += sample;
+		}
+	}
+}
+
+static void CarrierScalar( const CarrierBlock& b ) {
+	CarrierTail( b, 0 );
+}
+
+static void RampScalar( Bit32s* out, Bitu samples, Bit32u start, Bit32u step, Bit32u shift, Bit32s offset ) {
+	for ( Bitu i = 0; i < samples; i++ ) {
+		start += step;
+		out[ i ] = offset + (Bit32s)( start >> shift );
+	}
+}
+
+#ifdef DBOPL_SIMD
+__attribute__(( target( "sse4.1" ) ))
+static void CarrierSSE41( const CarrierBlock& b ) {
+	const __m128i limit = _mm_set1_epi32( ENV_LIMIT - 1 );
+	const __m128i mask = _mm_set1_epi32( b.waveMask );
+	const __m128i left = _mm_set1_epi32( b.maskLeft );
+	const __m128i right = _mm_set1_epi32( b.maskRight );
+	Bitu i = 0;
+	for ( ; i + 4 <= b.samples; i += 4 ) {
+		__m128i vol = _mm_loadu_si128( (const __m128i*)( b.vol + i ) );
+		__m128i mod = _mm_loadu_si128( (const __m128i*)( b.mod + i ) );
+		__m128i index = _mm_loadu_si128( (const __m128i*)( b.index + i ) );
+		if ( !b.am )
+			index = _mm_add_epi32( index, mod );
+		index = _mm_and_si128( index, mask );
+		__m128i silent = _mm_cmpgt_epi32( vol, limit );
+		vol = _mm_min_epu32( vol, limit );
+		//No gathers before AVX2, fetch the entries one by one
+		__m128i wave = _mm_setr_epi32(
+			b.waveBase[ _mm_extract_epi32( index, 0 ) ], b.waveBase[ _mm_extract_epi32( index, 1 ) ],
+			b.waveBase[ _mm_extract_epi32( index, 2 ) ], b.waveBase[ _mm_extract_epi32( index, 3 ) ] );
+		__m128i mul = _mm_setr_epi32(
+			MulTable[ _mm_extract_epi32( vol, 0 ) ], MulTable[ _mm_extract_epi32( vol, 1 ) ],
+			MulTable[ _mm_extract_epi32( vol, 2 ) ], MulTable[ _mm_extract_epi32( vol, 3 ) ] );
+		__m128i sample = _mm_srai_epi32( _mm_mullo_epi32( wave, mul ), MUL_SH );
+		sample = _mm_andnot_si128( silent, sample );
+		if ( b.am )
+			sample = _mm_add_epi32( sample, mod );
+		if ( b.stereo ) {
+			__m128i l = _mm_and_si128( sample, left );
+			__m128i r = _mm_and_si128( sample, right );
+			__m128i* out = (__m128i*)( b.output + i * 2 );
+			_mm_storeu_si128( out + 0, _mm_add_epi32( _mm_loadu_si128( out + 0 ), _mm_unpacklo_epi32( l, r ) ) );
+			_mm_storeu_si128( out + 1, _mm_add_epi32( _mm_loadu_si128( out + 1 ), _mm_unpackhi_epi32( l, r ) ) );
+		} else {
+			__m128i* out = (__m128i*)( b.output + i );
+			_mm_storeu_si128( out, _mm_add_epi32( _mm_loadu_si128( out ), sample ) );
+		}
+	}
+	CarrierTail( b, i );
+}
+
+__attribute__(( target( "sse4.1" ) ))
+static void RampSSE41( Bit32s* out, Bitu samples, Bit32u start, Bit32u step, Bit32u shift, Bit32s offset ) {
+	__m128i value = _mm_add_epi32( _mm_set1_epi32( start ), _mm_mullo_epi32( _mm_set1_epi32( step ), _mm_setr_epi32( 1, 2, 3, 4 ) ) );
+	const __m128i stride = _mm_set1_epi32( step * 4 );
+	const __m128i base = _mm_set1_epi32( offset );
+	const __m128i count = _mm_cvtsi32_si128( shift );
+	Bitu i = 0;
+	for ( ; i + 4 <= samples; i += 4 ) {
+		_mm_storeu_si128( (__m128i*)( out + i ), _mm_add_epi32( base, _mm_srl_epi32( value, count ) ) );
+		value = _mm_add_epi32( value, stride );
+	}
+	RampScalar( out + i, samples - i, start + (Bit32u)i * step, step, shift, offset );
+}
+
+__attribute__(( target( "avx2" ) ))
+static void CarrierAVX2( const CarrierBlock& b ) {
+	const __m256i limit = _mm256_set1_epi32( ENV_LIMIT - 1 );
+	const __m256i mask = _mm256_set1_epi32( b.waveMask );
+	const __m256i low = _mm256_set1_epi32( 0xffff );
+	const __m256i left = _mm256_set1_epi32( b.maskLeft );
+	const __m256i right = _mm256_set1_epi32( b.maskRight );
+	Bitu i = 0;
+	for ( ; i + 8 <= b.samples; i += 8 ) {
+		__m256i vol = _mm256_loadu_si256( (const __m256i*)( b.vol + i ) );
+		__m256i mod = _mm256_loadu_si256( (const __m256i*)( b.mod + i ) );
+		__m256i index = _mm256_loadu_si256( (const __m256i*)( b.index + i ) );
+		if ( !b.am )
+			index = _mm256_add_epi32( index, mod );
+		index = _mm256_and_si256( index, mask );
+		__m256i silent = _mm256_cmpgt_epi32( vol, limit );
+		vol = _mm256_min_epu32( vol, limit );
+		//Gather 32 bits around each 16 bit entry and keep the low half
+		__m256i wave = _mm256_i32gather_epi32( (const int*)b.waveBase, index, 2 );
+		wave = _mm256_srai_epi32( _mm256_slli_epi32( wave, 16 ), 16 );
+		__m256i mul = _mm256_i32gather_epi32( (const int*)MulTable, vol, 2 );
+		mul = _mm256_and_si256( mul, low );
+		__m256i sample = _mm256_srai_epi32( _mm256_mullo_epi32( wave, mul ), MUL_SH );
+		sample = _mm256_andnot_si256( silent, sample );
+		if ( b.am )
+			sample = _mm256_add_epi32( sample, mod );
+		if ( b.stereo ) {
+			__m256i l = _mm256_and_si256( sample, left );
+			__m256i r = _mm256_and_si256( sample, right );
+			//Interleaving works within 128 bit lanes, put the halves back in order after
+			__m256i lo = _mm256_unpacklo_epi32( l, r );
+			__m256i hi = _mm256_unpackhi_epi32( l, r );
+			__m256i* out = (__m256i*)( b.output + i * 2 );
+			_mm256_storeu_si256( out + 0, _mm256_add_epi32( _mm256_loadu_si256( out + 0 ), _mm256_permute2x128_si256( lo, hi, 0x20 ) ) );
+			_mm256_storeu_si256( out + 1, _mm256_add_epi32( _mm256_loadu_si256( out + 1 ), _mm256_permute2x128_si256( lo, hi, 0x31 ) ) );
+		} else {
+			__m256i* out = (__m256i*)( b.output + i );
+			_mm256_storeu_si256( out, _mm256_add_epi32( _mm256_loadu_si256( out ), sample ) );
+		}
+	}
+	CarrierTail( b, i );
+}
+
+__attribute__(( target( "avx2" ) ))
+static void RampAVX2( Bit32s* out, Bitu samples, Bit32u start, Bit32u step, Bit32u shift, Bit32s offset ) {
+	__m256i value = _mm256_add_epi32( _mm256_set1_epi32( start ), _mm256_mullo_epi32( _mm256_set1_epi32( step ), _mm256_setr_epi32( 1, 2, 3, 4, 5, 6, 7, 8 ) ) );
+	const __m256i stride = _mm256_set1_epi32( step * 8 );
+	const __m256i base = _mm256_set1_epi32( offset );
+	const __m128i count = _mm_cvtsi32_si128( shift );
+	Bitu i = 0;
+	for ( ; i + 8 <= samples; i += 8 ) {
+		_mm256_storeu_si256( (__m256i*)( out + i ), _mm256_add_epi32( base, _mm256_srl_epi32( value, count ) ) );
+		value = _mm256_add_epi32( value, stride );
+	}
+	RampScalar( out + i, samples - i, start + (Bit32u)i * step, step, shift, offset );
+}
+#endif
+
+static CarrierKernel carrierKernel = CarrierScalar;
+static RampKernel rampKernel = RampScalar;
+static const char* simdBackend = "scalar";
+
+static void SelectCarrierKernel( void ) {
+#ifdef DBOPL_SIMD
+	const char* cap = getenv( "DBOPL_SIMD" );
+	bool allowAVX2 = !cap || !*cap || strcmp( cap, "avx2" ) == 0;
+	bool allowSSE41 = allowAVX2 || strcmp( cap, "sse4.1" ) == 0;
+	__builtin_cpu_init();
+	if ( allowAVX2 && __builtin_cpu_supports( "avx2" ) ) {
+		carrierKernel = CarrierAVX2;
+		rampKernel = RampAVX2;
+		simdBackend = "avx2";
+	} else if ( allowSSE41 && __builtin_cpu_supports( "sse4.1" ) ) {
+		carrierKernel = CarrierSSE41;
+		rampKernel = RampSSE41;
+		simdBackend = "sse4.1";
+	}
+#endif
+}
+
+//Envelope and phase of an operator for a block, advanced as GetSample would.
+//Returns true when every sample of the block is silent.
+static bool ForwardOperator( Operator* op, Bitu samples, Bit32s* vol, Bit32u* index ) {
+	Bit32s level = op->currentLevel;
+	Bit32u add = 0;
+	Bit32s limit = ENV_MAX;
+	bool held = false;
+	switch ( op->state ) {
+	case Operator::OFF:
+		level += ENV_MAX;
+		held = true;
+		break;
+	case Operator::SUSTAIN:
+		if ( op->reg20 & Operator::MASK_SUSTAIN ) {
+			level += op->volume;
+			held = true;
+			break;
+		}
+		add = op->releaseAdd;
+		break;
+	case Operator::RELEASE:
+		add = op->releaseAdd;
+		break;
+	case Operator::DECAY:
+		add = op->decayAdd;
+		limit = op->sustainLevel;
+		break;
+	default:
+		limit = -1;
+		break;
+	}
+	bool silent;
+	if ( held ) {
+		//Held level, the handler wouldn't change anything
+		for ( Bitu i = 0; i < samples; i++ )
+			vol[ i ] = level;
+		silent = ENV_SILENT( level );
+	} else if ( limit >= 0 && op->volume + (Bit32s)( ( op->rateIndex + (uint64_t)add * samples ) >> RATE_SH ) < limit
+		&& op->rateIndex + (uint64_t)add * samples <= 0xffffffffu ) {
+		//A steady climb that stays short of the next state. Stepping RateForward sample by
+		//sample carries the same total, so each volume follows from the sample count.
+		Bit32u end = op->rateIndex + add * (Bit32u)samples;
+		rampKernel( vol, samples, op->rateIndex, add, RATE_SH, level + op->volume );
+		op->volume += end >> RATE_SH;
+		op->rateIndex = end & RATE_MASK;
+		silent = ENV_SILENT( vol[ 0 ] );
+	} else {
+		silent = true;
+		for ( Bitu i = 0; i < samples; i++ ) {
+			vol[ i ] = (Bit32s)op->ForwardVolume();
+			silent &= ENV_SILENT( vol[ i ] );
+		}
+	}
+	//The phase wraps at 32 bits either way
+	rampKernel( (Bit32s*)index, samples, op->waveIndex, op->waveCurrent, WAVE_SH, 0 );
+	op->waveIndex += op->waveCurrent * (Bit32u)samples;
+	return silent;
+}
+
+template<SynthMode mode>
+void Channel::BlockTwoOp( Bit32u samples, Bit32s* output ) {
+	Bit32s vol0[ BLOCK_SAMPLES ], vol1[ BLOCK_SAMPLES ], out0[ BLOCK_SAMPLES ];
+	Bit32u index0[ BLOCK_SAMPLES ], index1[ BLOCK_SAMPLES ];
+	CarrierBlock block;
+	block.vol = vol1;
+	block.index = index1;
+	block.mod = out0;
+	block.am = ( mode == sm2AM || mode == sm3AM );
+	block.stereo = ( mode == sm3AM || mode == sm3FM );
+	block.waveBase = op[1].waveBase;
+	block.waveMask = op[1].waveMask;
+	block.maskLeft = maskLeft;
+	block.maskRight = maskRight;
+	while ( samples > 0 ) {
+		Bit32u todo = samples < BLOCK_SAMPLES ? samples : BLOCK_SAMPLES;
+		bool modSilent = ForwardOperator( &op[0], todo, vol0, index0 );
+		bool carSilent = ForwardOperator( &op[1], todo, vol1, index1 );
+		if ( modSilent ) {
+			//Zeros feed through the feedback pair
+			out0[0] = old[1];
+			for ( Bitu i = 1; i < todo; i++ )
+				out0[ i ] = 0;
+			old[0] = todo > 1 ? 0 : old[1];
+			old[1] = 0;
+		} else {
+			for ( Bitu i = 0; i < todo; i++ ) {
+				Bit32s mod = (Bit32u)((old[0] + old[1])) >> feedback;
+				old[0] = old[1];
+				old[1] = ENV_SILENT( vol0[ i ] ) ? 0 : op[0].GetWave( index0[ i ] + mod, vol0[ i ] );
+				out0[ i ] = old[0];
+			}
+		}
+		//A silent FM carrier adds nothing whatever its modulator did
+		if ( !carSilent || block.am ) {
+			block.samples = todo;
+			block.output = output;
+			carrierKernel( block );
+		}
+		samples -= todo;
+		output += block.stereo ? todo * 2 : todo;
+	}
+}
+#endif
+
 Operator::Operator() {
 	chanData = 0;
 	freqMul = 0;
@@ -894,6 +1212,12 @@ Channel* Channel::BlockTemplate( Chip* chip, Bit32u samples, Bit32s* output ) {
 		Op( 4 )->Prepare( chip );
 		Op( 5 )->Prepare( chip );
 	}
+#if ( DBOPL_WAVE == WAVE_TABLEMUL )
+	if ( mode < sm4Start ) {
+		BlockTwoOp<mode>( samples, output );
+		return ( this + 1 );
+	}
+#endif
 	for ( Bitu i = 0; i < samples; i++ ) {
 		//Early out for percussion handlers
 		if ( mode == sm2Percussion ) {
@@ -1332,11 +1656,8 @@ void Chip::Setup( Bit32u rate ) {
     }
 }
 
-static bool doneTables = false;
-void InitTables( void ) {
-    if ( doneTables )
-        return;
-    doneTables = true;
+//Filled once, then shared read-only by every chip
+static void BuildTables( void ) {
 #if ( DBOPL_WAVE == WAVE_HANDLER ) || ( DBOPL_WAVE == WAVE_TABLELOG )
     //Exponential volume table, same as the real adlib
     for ( int i = 0; i < 256; i++ ) {
@@ -1455,6 +1776,23 @@ void InitTables( void ) {
         Bitu opNum = ( i % 8 ) / 3;
         OpOffsetTable[i] = ChanOffsetTable[chNum]+(Bit16u)(opNum*sizeof(DBOPL::Operator));
     }
+#if ( DBOPL_WAVE == WAVE_TABLEMUL )
+    SelectCarrierKernel();
+#endif
+}
+
+static std::once_flag tablesOnce;
+void InitTables( void ) {
+	std::call_once( tablesOnce, BuildTables );
+}
+
+const char* SimdBackend() {
+	InitTables();
+#if ( DBOPL_WAVE == WAVE_TABLEMUL )
+	return simdBackend;
+#else
+	return "scalar";
+#endif
 }
 
 Bit32u Handler::WriteAddr( Bit32u port, Bit8u val ) {
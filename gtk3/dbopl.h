@@ -17,6 +17,9 @@
  */
 
 
+#ifndef DBOPL_H
+#define DBOPL_H
+
 /*
 	define Bits, Bitu, Bit32s, Bit32u, Bit16s, Bit16u, Bit8s, Bit8u here
 */
@@ -204,6 +207,9 @@ struct Channel {
 	//Generate blocks of data in specific modes
 	template<SynthMode mode>
 	Channel* BlockTemplate( Chip* chip, Bit32u samples, Bit32s* output );
+	//Same result for the 2 operator modes, through the vectorized carrier kernel
+	template<SynthMode mode>
+	void BlockTwoOp( Bit32u samples, Bit32s* output );
 	Channel();
 };
 
@@ -271,5 +277,11 @@ struct Handler {
 	void Init( Bitu rate );
 };
 
+//Instruction set the 2 operator channels are synthesized with, picked once
+//at startup from what the cpu supports; "scalar" without one
+const char* SimdBackend();
+
 
 };		//Namespace
+
+#endif // DBOPL_H
@@ -2,163 +2,331 @@
 #include <string.h>
 #include <math.h>
 #include <climits>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <pthread.h>
 #include "dbopl_wrapper.h"
 #include "dbopl.h"
 
 #include "midiplayer.h"
 
-// The DBOPL emulator handler
-static DBOPL::Handler opl_handler;
+// Instance behind the OPL_* calls
+static OPLSynth default_synth;
 
-// Stereo audio buffer for OPL output
-static int32_t opl_buffer[1024 * 2];
+// Stereo chunk the chip renders into before scaling
+#define OPL_GENERATE_CHUNK 1024
 
-// OPL channel allocation and state tracking
-OPLChannel opl_channels[MAX_OPL_CHANNELS];
+// Shorter spans, as between closely spaced events, are generated on the
+// calling thread; handing them to the workers would cost more than it saves
+#define OPL_PARALLEL_MIN_SAMPLES 256
 
-// Track MIDI channel state
-static int midi_channel_program[16] = {0};
-static int midi_channel_volume[16] = {127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127};
-static int midi_channel_pan[16] = {64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64};
+static std::atomic<int> chip_count_setting(OPL_DEFAULT_CHIPS);
 
-// Initialize the OPL emulator
-void OPL_Init(int sample_rate) {
-    // Initialize the OPL emulator
-    opl_handler.Init(sample_rate);
-    
-    // Reset all channels
-    memset(opl_channels, 0, sizeof(opl_channels));
-    
-    // Set OPL3 mode
-    opl_handler.WriteReg(0x105, 0x01);
-    
-    // Initialize the instruments (from the original MIDI player)
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        opl_channels[i].active = false;
-        opl_channels[i].start_time = 0;
-    }
+// Chip::Setup() tunes its envelope rates by simulation, which takes
+// milliseconds. A freshly set up chip is kept per process and copied on
+// every init, so rewinding or seeking a renderer is just a copy.
+static std::mutex pristine_lock;
+static DBOPL::Handler *pristine_chip = NULL;
+static int pristine_rate = 0;
+
+// Operator register offsets of the nine voices in a register bank
+static const uint8_t modulator_offset[9] = { 0x00, 0x01, 0x02, 0x08, 0x09, 0x0A, 0x10, 0x11, 0x12 };
+#define CARRIER_OFFSET 3
+
+void opl_set_chip_count(int chips) {
+    if (chips < 1) chips = 1;
+    if (chips > OPL_MAX_CHIPS) chips = OPL_MAX_CHIPS;
+    chip_count_setting.store(chips);
 }
 
-// Reset the OPL emulator
-void OPL_Reset(void) {
-    // Turn off all notes
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active) {
-            // Key off
-            uint32_t reg_offset = (i % 9);
-            uint32_t bank = (i / 9);
-            uint32_t reg_b0 = 0xB0 + reg_offset + (bank * 0x100);
-            uint8_t current = opl_handler.WriteAddr(reg_b0, 0) & 0xDF; // Get current value and clear key-on bit
-            opl_handler.WriteReg(reg_b0, current);
-            opl_channels[i].active = false;
+int opl_get_chip_count(void) {
+    return chip_count_setting.load();
+}
+
+// ---------------------------------------------------------------------------
+// Chip workers. One small pool serves every synth: a synth hands out all
+// its chips but the first, generates that one itself and waits for the
+// rest. Each chip always renders the same spans whichever thread runs it,
+// and the outputs are summed in chip order, so the result doesn't depend
+// on the threading.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    DBOPL::Handler *chip;
+    int32_t *output;
+    int samples;
+    int *remaining;
+} ChipJob;
+
+#define CHIP_QUEUE_SIZE 64
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static ChipJob pool_jobs[CHIP_QUEUE_SIZE];
+static int pool_job_count = 0;
+static int pool_threads = 0;
+
+static void* chip_worker(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (pool_job_count == 0) {
+            pthread_cond_wait(&pool_wake, &pool_lock);
+        }
+        ChipJob job = pool_jobs[--pool_job_count];
+        pthread_mutex_unlock(&pool_lock);
+        
+        job.chip->Generate(job.output, job.samples);
+        
+        pthread_mutex_lock(&pool_lock);
+        if (--*job.remaining == 0) {
+            pthread_cond_broadcast(&pool_done);
         }
     }
+    return NULL;
 }
 
-// Write to OPL register
-void OPL_WriteReg(uint32_t reg, uint8_t value) {
-    opl_handler.WriteReg(reg, value);
+// Workers live for the rest of the process; none on a single core
+static void start_chip_workers(void) {
+    int cores = (int)std::thread::hardware_concurrency();
+    int wanted = cores - 1 < OPL_MAX_CHIPS - 1 ? cores - 1 : OPL_MAX_CHIPS - 1;
+    
+    for (int i = 0; i < wanted; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, chip_worker, NULL) != 0) break;
+        pthread_detach(thread);
+        pool_threads++;
+    }
+    if (pool_threads > 0) {
+        printf("OPL: %d chip worker threads\n", pool_threads);
+    }
 }
 
-// Generate audio samples
-void OPL_Generate(int16_t *buffer, int num_samples) {
-    // Clear the buffer
-    memset(opl_buffer, 0, num_samples * 2 * sizeof(int32_t));
+static void generate_chips(OPLSynth *synth, int samples) {
+    static std::once_flag started;
+    if (synth->chip_count > 1 && samples >= OPL_PARALLEL_MIN_SAMPLES) {
+        std::call_once(started, start_chip_workers);
+    }
     
-    // Generate OPL audio
-    opl_handler.Generate(opl_buffer, num_samples);
+    int remaining = 0;
+    int next_chip = 1;    // First chip the caller generates after chip 0
+    if (pool_threads > 0 && synth->chip_count > 1 && samples >= OPL_PARALLEL_MIN_SAMPLES) {
+        pthread_mutex_lock(&pool_lock);
+        for (; next_chip < synth->chip_count && pool_job_count < CHIP_QUEUE_SIZE; next_chip++) {
+            ChipJob *job = &pool_jobs[pool_job_count++];
+            job->chip = synth->chips[next_chip];
+            job->output = synth->mix + next_chip * OPL_GENERATE_CHUNK * 2;
+            job->samples = samples;
+            job->remaining = &remaining;
+            remaining++;
+        }
+        pthread_cond_broadcast(&pool_wake);
+        pthread_mutex_unlock(&pool_lock);
+    }
     
-    // Get external global volume (already declared as int in midiplayer.c)
-    extern int globalVolume;
+    synth->chips[0]->Generate(synth->mix, samples);
+    for (; next_chip < synth->chip_count; next_chip++) {
+        synth->chips[next_chip]->Generate(synth->mix + next_chip * OPL_GENERATE_CHUNK * 2, samples);
+    }
     
-    // Convert to 16-bit and apply volume scaling
-    for (int i = 0; i < num_samples * 2; i++) {
-        // Apply global volume scaling (100 = normal volume)
-        int32_t sample = (int32_t)(opl_buffer[i] * (globalVolume / 100.0));
-        
-        // Clip to 16-bit range
-        if (sample > 32767) sample = 32767;
-        else if (sample < -32768) sample = -32768;
-        
-        buffer[i] = (int16_t)sample;
+    if (remaining > 0) {
+        pthread_mutex_lock(&pool_lock);
+        while (remaining > 0) {
+            pthread_cond_wait(&pool_done, &pool_lock);
+        }
+        pthread_mutex_unlock(&pool_lock);
     }
 }
 
-// Clean up OPL resources
-void OPL_Shutdown(void) {
-    // Nothing specific to clean up with DBOPL
+// ---------------------------------------------------------------------------
+// Synth
+// ---------------------------------------------------------------------------
+
+// Write a per-voice register; reg is the base address (0x20, 0xA0, ...)
+// plus CARRIER_OFFSET for carrier operator registers
+static void write_voice_reg(OPLSynth *synth, int voice, uint32_t reg, uint8_t value) {
+    int local = voice % OPL_VOICES_PER_CHIP;
+    uint32_t bank = (local / 9) * 0x100;
+    uint32_t offset;
+    
+    if (reg >= 0xA0 && reg < 0xD0) {
+        offset = local % 9;                        // Channel registers
+    } else {
+        offset = modulator_offset[local % 9];     // Operator registers
+    }
+    synth->chips[voice / OPL_VOICES_PER_CHIP]->WriteReg(reg + offset + bank, value);
 }
 
-// Find a free OPL channel for a new note
-static int allocate_opl_channel(int midi_channel, int note) {
-    // First try to find an inactive channel
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (!opl_channels[i].active) {
-            return i;
+bool opl_synth_init(OPLSynth *synth, int sample_rate) {
+    OPL_LoadInstruments();
+    
+    int chips = opl_get_chip_count();
+    if (chips != synth->chip_count) {
+        opl_synth_free(synth);
+        synth->mix = (int32_t*)malloc(chips * OPL_GENERATE_CHUNK * 2 * sizeof(int32_t));
+        if (!synth->mix) return false;
+        for (int c = 0; c < chips; c++) {
+            synth->chips[c] = new DBOPL::Handler();
         }
+        synth->chip_count = chips;
+        synth->voice_count = chips * OPL_VOICES_PER_CHIP;
     }
     
-    // If no free channels, try to find the channel with the same note
-    // to handle repeated notes (this prevents choppy playback)
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].midi_channel == midi_channel && 
-            opl_channels[i].midi_note == note) {
-            return i;
+    // Initialize the OPL emulators
+    {
+        std::lock_guard<std::mutex> guard(pristine_lock);
+        if (!pristine_chip || pristine_rate != sample_rate) {
+            delete pristine_chip;
+            pristine_chip = new DBOPL::Handler();
+            pristine_chip->Init(sample_rate);
+            pristine_rate = sample_rate;
+            printf("OPL: %d Hz chip, %s synthesis\n", sample_rate, DBOPL::SimdBackend());
+        }
+        for (int c = 0; c < synth->chip_count; c++) {
+            *synth->chips[c] = *pristine_chip;
         }
     }
     
-    // If still no channel, prioritize by velocity and age
-    uint32_t current_time = SDL_GetTicks();
-    int lowest_priority = INT_MAX;
-    int lowest_priority_channel = 0;
+    // Reset all channels
+    memset(synth->channels, 0, sizeof(synth->channels));
+    synth->sample_clock = 0;
+    for (int i = 0; i < 16; i++) {
+        synth->program[i] = 0;
+        synth->volume[i] = 127;
+        synth->pan[i] = 64;
+    }
     
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        // Don't replace percussion channels if possible
-        if (opl_channels[i].midi_channel == 9) {
-            continue;
+    // Set OPL3 mode
+    opl_synth_write_reg(synth, 0x105, 0x01);
+    return true;
+}
+
+void opl_synth_free(OPLSynth *synth) {
+    for (int c = 0; c < synth->chip_count; c++) {
+        delete synth->chips[c];
+        synth->chips[c] = NULL;
+    }
+    free(synth->mix);
+    synth->mix = NULL;
+    synth->chip_count = 0;
+    synth->voice_count = 0;
+}
+
+// Turn off all notes
+void opl_synth_reset(OPLSynth *synth) {
+    for (int i = 0; i < synth->voice_count; i++) {
+        if (synth->channels[i].active) {
+            // Key off, keeping the frequency so the release sounds at pitch
+            synth->channels[i].reg_b0 &= ~0x20;
+            write_voice_reg(synth, i, 0xB0, synth->channels[i].reg_b0);
+            synth->channels[i].active = false;
+            synth->channels[i].release_time = synth->sample_clock;
         }
+    }
+}
+
+void opl_synth_write_reg(OPLSynth *synth, uint32_t reg, uint8_t value) {
+    for (int c = 0; c < synth->chip_count; c++) {
+        synth->chips[c]->WriteReg(reg, value);
+    }
+}
+
+void opl_synth_generate(OPLSynth *synth, int16_t *buffer, int num_samples, int volume) {
+    double scale = volume / 100.0;
+    
+    while (num_samples > 0) {
+        int chunk = num_samples < OPL_GENERATE_CHUNK ? num_samples : OPL_GENERATE_CHUNK;
         
-        // Calculate priority based on velocity and age
-        int priority = opl_channels[i].velocity * 10 + 
-                      (current_time - opl_channels[i].start_time) / 1000;
+        // Generate OPL audio, every chip into its own slice of mix
+        generate_chips(synth, chunk);
         
-        if (priority < lowest_priority) {
-            lowest_priority = priority;
-            lowest_priority_channel = i;
+        // Sum the chips, convert to 16-bit and apply volume scaling
+        for (int i = 0; i < chunk * 2; i++) {
+            int32_t mixed = synth->mix[i];
+            for (int c = 1; c < synth->chip_count; c++) {
+                mixed += synth->mix[c * OPL_GENERATE_CHUNK * 2 + i];
+            }
+            int32_t sample = (int32_t)(mixed * scale);
+            
+            // Clip to 16-bit range
+            if (sample > 32767) sample = 32767;
+            else if (sample < -32768) sample = -32768;
+            
+            buffer[i] = (int16_t)sample;
+        }
+        
+        buffer += chunk * 2;
+        num_samples -= chunk;
+        synth->sample_clock += chunk;
+    }
+}
+
+// Pick the OPL voice for a new note. Ages come from the synth's sample
+// clock, so the choice depends only on the song, never on how fast it is
+// being rendered. In order of preference:
+//   - a voice that is keyed off, the one released longest ago, since its
+//     release tail has decayed the most
+//   - the voice already playing this note on this channel
+//   - a melodic voice, the oldest and then the quietest; percussion is only
+//     stolen when every voice is playing percussion
+static int allocate_opl_channel(OPLSynth *synth, int midi_channel, int note) {
+    int best = -1;
+    for (int i = 0; i < synth->voice_count; i++) {
+        if (!synth->channels[i].active &&
+            (best < 0 || synth->channels[i].release_time < synth->channels[best].release_time)) {
+            best = i;
+        }
+    }
+    if (best >= 0) return best;
+    
+    for (int i = 0; i < synth->voice_count; i++) {
+        if (synth->channels[i].midi_channel == midi_channel &&
+            synth->channels[i].midi_note == note) {
+            return i;
         }
     }
     
-    return lowest_priority_channel;
+    for (int pass = 0; pass < 2 && best < 0; pass++) {
+        int best_loudness = 0;
+        for (int i = 0; i < synth->voice_count; i++) {
+            const OPLChannel *voice = &synth->channels[i];
+            if (pass == 0 && voice->midi_channel == 9) continue;
+            
+            int loudness = voice->velocity * synth->volume[voice->midi_channel];
+            if (best < 0 || voice->start_time < synth->channels[best].start_time ||
+                (voice->start_time == synth->channels[best].start_time && loudness < best_loudness)) {
+                best = i;
+                best_loudness = loudness;
+            }
+        }
+    }
+    return best;
 }
 
 // Load an FM instrument into an OPL channel
-static void load_instrument(int opl_channel, int instrument) {
-    uint32_t reg_offset = (opl_channel % 9);
-    uint32_t bank = (opl_channel / 9);
-    
+static void load_instrument(OPLSynth *synth, int opl_channel, int instrument) {
     // Modulator
-    OPL_WriteReg(0x20 + reg_offset + (bank * 0x100), adl[instrument].modChar1);
-    OPL_WriteReg(0x40 + reg_offset + (bank * 0x100), adl[instrument].modChar2);
-    OPL_WriteReg(0x60 + reg_offset + (bank * 0x100), adl[instrument].modChar3);
-    OPL_WriteReg(0x80 + reg_offset + (bank * 0x100), adl[instrument].modChar4);
-    OPL_WriteReg(0xE0 + reg_offset + (bank * 0x100), adl[instrument].modChar5);
+    write_voice_reg(synth, opl_channel, 0x20, adl[instrument].modChar1);
+    write_voice_reg(synth, opl_channel, 0x40, adl[instrument].modChar2);
+    write_voice_reg(synth, opl_channel, 0x60, adl[instrument].modChar3);
+    write_voice_reg(synth, opl_channel, 0x80, adl[instrument].modChar4);
+    write_voice_reg(synth, opl_channel, 0xE0, adl[instrument].modChar5);
     
     // Carrier
-    OPL_WriteReg(0x23 + reg_offset + (bank * 0x100), adl[instrument].carChar1);
-    OPL_WriteReg(0x43 + reg_offset + (bank * 0x100), adl[instrument].carChar2);
-    OPL_WriteReg(0x63 + reg_offset + (bank * 0x100), adl[instrument].carChar3);
-    OPL_WriteReg(0x83 + reg_offset + (bank * 0x100), adl[instrument].carChar4);
-    OPL_WriteReg(0xE3 + reg_offset + (bank * 0x100), adl[instrument].carChar5);
+    write_voice_reg(synth, opl_channel, 0x20 + CARRIER_OFFSET, adl[instrument].carChar1);
+    write_voice_reg(synth, opl_channel, 0x40 + CARRIER_OFFSET, adl[instrument].carChar2);
+    write_voice_reg(synth, opl_channel, 0x60 + CARRIER_OFFSET, adl[instrument].carChar3);
+    write_voice_reg(synth, opl_channel, 0x80 + CARRIER_OFFSET, adl[instrument].carChar4);
+    write_voice_reg(synth, opl_channel, 0xE0 + CARRIER_OFFSET, adl[instrument].carChar5);
     
     // Feedback/Connection
-    OPL_WriteReg(0xC0 + reg_offset + (bank * 0x100), adl[instrument].fbConn);
+    write_voice_reg(synth, opl_channel, 0xC0, adl[instrument].fbConn);
 }
 
 // Set the frequency for a note
-static void set_note_frequency(int opl_channel, int note, bool keyon) {
-    uint32_t reg_offset = (opl_channel % 9);
-    uint32_t bank = (opl_channel / 9);
-    
+static void set_note_frequency(OPLSynth *synth, int opl_channel, int note, bool keyon) {
     // Calculate frequency number and block
     double freq = 440.0 * pow(2.0, (note - 69) / 12.0);
     int block = (note / 12) - 1;
@@ -171,21 +339,20 @@ static void set_note_frequency(int opl_channel, int note, bool keyon) {
     if (fnum > 1023) fnum = 1023;
     
     // Frequency low byte
-    OPL_WriteReg(0xA0 + reg_offset + (bank * 0x100), fnum & 0xFF);
+    write_voice_reg(synth, opl_channel, 0xA0, fnum & 0xFF);
     
     // Frequency high bits and keyon
     uint8_t regval = ((block & 7) << 2) | ((fnum >> 8) & 3);
     if (keyon) {
         regval |= 0x20; // Set key-on bit
     }
-    OPL_WriteReg(0xB0 + reg_offset + (bank * 0x100), regval);
+    write_voice_reg(synth, opl_channel, 0xB0, regval);
+    synth->channels[opl_channel].reg_b0 = regval;
 }
 
 // Set volume for an OPL channel
-void set_channel_volume(int opl_channel, int velocity, int volume) {
-    uint32_t reg_offset = (opl_channel % 9);
-    uint32_t bank = (opl_channel / 9);
-    int instrument = opl_channels[opl_channel].instrument;
+void opl_synth_set_channel_volume(OPLSynth *synth, int opl_channel, int velocity, int volume) {
+    int instrument = synth->channels[opl_channel].instrument;
     
     // Check for invalid instrument index to prevent crashes
     if (instrument < 0 || instrument >= 181) {
@@ -220,15 +387,13 @@ void set_channel_volume(int opl_channel, int velocity, int volume) {
     uint8_t car_reg_val = (adl[instrument].carChar2 & 0xC0) | scaled_car_level;
     
     // Update the OPL registers
-    OPL_WriteReg(0x40 + reg_offset + (bank * 0x100), mod_reg_val);
-    OPL_WriteReg(0x43 + reg_offset + (bank * 0x100), car_reg_val);
+    write_voice_reg(synth, opl_channel, 0x40, mod_reg_val);
+    write_voice_reg(synth, opl_channel, 0x40 + CARRIER_OFFSET, car_reg_val);
 }
 
 // Set panning for an OPL channel
-static void set_channel_pan(int opl_channel, int pan) {
-    uint32_t reg_offset = (opl_channel % 9);
-    uint32_t bank = (opl_channel / 9);
-    int instrument = opl_channels[opl_channel].instrument;
+static void set_channel_pan(OPLSynth *synth, int opl_channel, int pan) {
+    int instrument = synth->channels[opl_channel].instrument;
     
     // Get the base feedback/connection value
     uint8_t fb_conn = adl[instrument].fbConn;
@@ -247,12 +412,10 @@ static void set_channel_pan(int opl_channel, int pan) {
     // Preserve feedback bits and add panning
     uint8_t new_fb_conn = (fb_conn & 0x0F) | panning;
     
-    OPL_WriteReg(0xC0 + reg_offset + (bank * 0x100), new_fb_conn);
+    write_voice_reg(synth, opl_channel, 0xC0, new_fb_conn);
 }
 
-// Helper functions for MIDI player
-
-void OPL_NoteOn(int channel, int note, int velocity) {
+void opl_synth_note_on(OPLSynth *synth, int channel, int note, int velocity) {
     // Determine which instrument to use
     int instrument;
     
@@ -265,7 +428,7 @@ void OPL_NoteOn(int channel, int note, int velocity) {
             instrument = 128; // Default to acoustic bass drum if out of range
         }
     } else {
-        instrument = midi_channel_program[channel];
+        instrument = synth->program[channel];
     }
     
     // Make sure the instrument number is valid
@@ -273,112 +436,166 @@ void OPL_NoteOn(int channel, int note, int velocity) {
     if (instrument >= 181) instrument = 0;
     
     // Allocate an OPL channel
-    int opl_channel = allocate_opl_channel(channel, note);
+    int opl_channel = allocate_opl_channel(synth, channel, note);
     
     // If a note is already playing on this OPL channel, turn it off
-    if (opl_channels[opl_channel].active) {
-        set_note_frequency(opl_channel, opl_channels[opl_channel].midi_note, false);
+    if (synth->channels[opl_channel].active) {
+        set_note_frequency(synth, opl_channel, synth->channels[opl_channel].midi_note, false);
     }
     
     // Set up the new note
-    opl_channels[opl_channel].active = true;
-    opl_channels[opl_channel].midi_channel = channel;
-    opl_channels[opl_channel].midi_note = note;
-    opl_channels[opl_channel].instrument = instrument;
-    opl_channels[opl_channel].velocity = velocity;
-    opl_channels[opl_channel].start_time = SDL_GetTicks();
+    synth->channels[opl_channel].active = true;
+    synth->channels[opl_channel].midi_channel = channel;
+    synth->channels[opl_channel].midi_note = note;
+    synth->channels[opl_channel].instrument = instrument;
+    synth->channels[opl_channel].velocity = velocity;
+    synth->channels[opl_channel].start_time = synth->sample_clock;
     
     // Configure the OPL channel
-    load_instrument(opl_channel, instrument);
-    set_channel_volume(opl_channel, velocity, midi_channel_volume[channel]);
-    set_channel_pan(opl_channel, midi_channel_pan[channel]);
+    load_instrument(synth, opl_channel, instrument);
+    opl_synth_set_channel_volume(synth, opl_channel, velocity, synth->volume[channel]);
+    set_channel_pan(synth, opl_channel, synth->pan[channel]);
     
     // Set the frequency and key it on
-    set_note_frequency(opl_channel, note, true);
+    set_note_frequency(synth, opl_channel, note, true);
 }
 
-void OPL_NoteOff(int channel, int note) {
+void opl_synth_note_off(OPLSynth *synth, int channel, int note) {
     // Find the OPL channel playing this note
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active && 
-            opl_channels[i].midi_channel == channel && 
-            opl_channels[i].midi_note == note) {
+    for (int i = 0; i < synth->voice_count; i++) {
+        if (synth->channels[i].active && 
+            synth->channels[i].midi_channel == channel && 
+            synth->channels[i].midi_note == note) {
             
             // Turn off the note
-            set_note_frequency(i, note, false);
-            opl_channels[i].active = false;
+            set_note_frequency(synth, i, note, false);
+            synth->channels[i].active = false;
+            synth->channels[i].release_time = synth->sample_clock;
             break;
         }
     }
 }
 
-void OPL_ProgramChange(int channel, int program) {
+void opl_synth_program_change(OPLSynth *synth, int channel, int program) {
     // Store the program number for this MIDI channel
-    midi_channel_program[channel] = program;
+    synth->program[channel] = program;
     
     // Update any currently playing notes on this channel
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active && opl_channels[i].midi_channel == channel) {
+    for (int i = 0; i < synth->voice_count; i++) {
+        if (synth->channels[i].active && synth->channels[i].midi_channel == channel) {
             // If it's not a percussion channel, update the instrument
             if (channel != 9) {
-                opl_channels[i].instrument = program;
-                load_instrument(i, program);
+                synth->channels[i].instrument = program;
+                load_instrument(synth, i, program);
                 
                 // Reapply the volume and pan settings
-                set_channel_volume(i, opl_channels[i].velocity, midi_channel_volume[channel]);
-                set_channel_pan(i, midi_channel_pan[channel]);
+                opl_synth_set_channel_volume(synth, i, synth->channels[i].velocity, synth->volume[channel]);
+                set_channel_pan(synth, i, synth->pan[channel]);
             }
         }
     }
 }
 
-void OPL_SetPan(int channel, int pan) {
+void opl_synth_set_pan(OPLSynth *synth, int channel, int pan) {
     // Store the pan setting for this MIDI channel
-    midi_channel_pan[channel] = pan;
+    synth->pan[channel] = pan;
     
     // Update any currently playing notes on this channel
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active && opl_channels[i].midi_channel == channel) {
-            set_channel_pan(i, pan);
+    for (int i = 0; i < synth->voice_count; i++) {
+        if (synth->channels[i].active && synth->channels[i].midi_channel == channel) {
+            set_channel_pan(synth, i, pan);
         }
     }
 }
 
-void OPL_SetVolume(int channel, int volume) {
+void opl_synth_set_volume(OPLSynth *synth, int channel, int volume) {
     // Store the volume setting for this MIDI channel
-    midi_channel_volume[channel] = volume;
+    synth->volume[channel] = volume;
     
     // Update any currently playing notes on this channel
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active && opl_channels[i].midi_channel == channel) {
+    for (int i = 0; i < synth->voice_count; i++) {
+        if (synth->channels[i].active && synth->channels[i].midi_channel == channel) {
             // Apply the new volume
-            set_channel_volume(i, opl_channels[i].velocity, volume);
+            opl_synth_set_channel_volume(synth, i, synth->channels[i].velocity, volume);
         }
     }
 }
 
-void OPL_SetPitchBend(int channel, int bend) {
+void opl_synth_set_pitch_bend(OPLSynth *synth, int channel, int bend) {
     // Pitch bend is more complex with OPL - we'd need to recalculate frequencies
     // This is a simplified implementation
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active && opl_channels[i].midi_channel == channel) {
+    for (int i = 0; i < synth->voice_count; i++) {
+        if (synth->channels[i].active && synth->channels[i].midi_channel == channel) {
             // Calculate a note offset based on the bend
             // Bend range: -8192 to 8191, typically ±2 semitones
             double bend_amount = (bend - 8192) / 8192.0;
             double semitones = bend_amount * 2.0; // ±2 semitone range
             
             // Calculate the adjusted frequency
-            double note = opl_channels[i].midi_note + semitones;
+            double note = synth->channels[i].midi_note + semitones;
             
             // Update the frequency but keep note on
-            set_note_frequency(i, (int)round(note), true);
+            set_note_frequency(synth, i, (int)round(note), true);
         }
     }
 }
 
+// The OPL_* API over the default synth
+
+void OPL_Init(int sample_rate) {
+    opl_synth_init(&default_synth, sample_rate);
+}
+
+void OPL_Reset(void) {
+    opl_synth_reset(&default_synth);
+}
+
+void OPL_WriteReg(uint32_t reg, uint8_t value) {
+    opl_synth_write_reg(&default_synth, reg, value);
+}
+
+void OPL_Generate(int16_t *buffer, int num_samples) {
+    // Get external global volume (already declared as int in midiplayer.c)
+    extern int globalVolume;
+    opl_synth_generate(&default_synth, buffer, num_samples, globalVolume);
+}
+
+void OPL_Shutdown(void) {
+    opl_synth_free(&default_synth);
+}
+
+void OPL_NoteOn(int channel, int note, int velocity) {
+    opl_synth_note_on(&default_synth, channel, note, velocity);
+}
+
+void OPL_NoteOff(int channel, int note) {
+    opl_synth_note_off(&default_synth, channel, note);
+}
+
+void OPL_ProgramChange(int channel, int program) {
+    opl_synth_program_change(&default_synth, channel, program);
+}
+
+void OPL_SetPan(int channel, int pan) {
+    opl_synth_set_pan(&default_synth, channel, pan);
+}
+
+void OPL_SetVolume(int channel, int volume) {
+    opl_synth_set_volume(&default_synth, channel, volume);
+}
+
+void OPL_SetPitchBend(int channel, int bend) {
+    opl_synth_set_pitch_bend(&default_synth, channel, bend);
+}
+
+void set_channel_volume(int opl_channel, int velocity, int volume) {
+    opl_synth_set_channel_volume(&default_synth, opl_channel, velocity, volume);
+}
+
 // Load the instrument data
 void OPL_LoadInstruments(void) {
-    // This function is implemented in instruments.c
-    // Just call it to load the instrument data
-    initFMInstruments();
+    // This function is implemented in instruments.c. adl[] is shared by
+    // every synth, so fill it once even when several start together.
+    static std::once_flag loaded;
+    std::call_once(loaded, initFMInstruments);
 }
@@ -4,7 +4,14 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define MAX_OPL_CHANNELS 36
+// Each emulated OPL3 chip has 18 two-operator voices; a synth spreads its
+// voices over several chips for more polyphony
+#define OPL_VOICES_PER_CHIP  18
+#define OPL_MAX_CHIPS        8
+#define OPL_DEFAULT_CHIPS    2
+#define MAX_OPL_CHANNELS     (OPL_MAX_CHIPS * OPL_VOICES_PER_CHIP)
+
+namespace DBOPL { struct Handler; }
 
 // OPL channel structure for tracking state
 typedef struct {
@@ -14,9 +21,53 @@ typedef struct {
     int instrument;
     int velocity;
     int pan;
-    uint32_t start_time;  // For note age tracking
+    uint64_t start_time;    // Synth sample clock at key-on
+    uint64_t release_time;  // Synth sample clock at key-off
+    uint8_t reg_b0;         // Last block/F-number/key-on value written
 } OPLChannel;
 
+// A bank of emulated OPL3 chips plus the MIDI channel to OPL voice mapping
+// that drives it. Voice v lives on chip v / OPL_VOICES_PER_CHIP. Every
+// opl_synth_* call works on the synth it is given, so separate synths can
+// render on separate threads at the same time.
+typedef struct {
+    DBOPL::Handler *chips[OPL_MAX_CHIPS];
+    int chip_count;
+    int voice_count;         // chip_count * OPL_VOICES_PER_CHIP
+    int32_t *mix;            // Per-chip output before summing
+    OPLChannel channels[MAX_OPL_CHANNELS];
+    uint64_t sample_clock;   // Samples generated since init, ages the voices
+
+    // Track MIDI channel state
+    int program[16];
+    int volume[16];
+    int pan[16];
+} OPLSynth;
+
+// Chips per synth, 1 to OPL_MAX_CHIPS, taken up by every later init
+void opl_set_chip_count(int chips);
+int opl_get_chip_count(void);
+
+// synth must be zeroed before the first init; init again to restart it
+bool opl_synth_init(OPLSynth *synth, int sample_rate);
+void opl_synth_free(OPLSynth *synth);
+void opl_synth_reset(OPLSynth *synth);
+// Writes reg on every chip of the synth
+void opl_synth_write_reg(OPLSynth *synth, uint32_t reg, uint8_t value);
+
+// volume is in percent, 100 = unscaled
+void opl_synth_generate(OPLSynth *synth, int16_t *buffer, int num_samples, int volume);
+
+void opl_synth_note_on(OPLSynth *synth, int channel, int note, int velocity);
+void opl_synth_note_off(OPLSynth *synth, int channel, int note);
+void opl_synth_program_change(OPLSynth *synth, int channel, int program);
+void opl_synth_set_pan(OPLSynth *synth, int channel, int pan);
+void opl_synth_set_volume(OPLSynth *synth, int channel, int volume);
+void opl_synth_set_pitch_bend(OPLSynth *synth, int channel, int bend);
+void opl_synth_set_channel_volume(OPLSynth *synth, int opl_channel, int velocity, int volume);
+
+// The calls below drive a single default synth, scaled by globalVolume
+
 // Initialize the OPL emulator
 void OPL_Init(int sample_rate);
 
@@ -41,10 +92,8 @@ void OPL_SetVolume(int channel, int volume);
 void OPL_SetPitchBend(int channel, int bend);
 void set_channel_volume(int opl_channel, int velocity, int volume);
 
-// Expose OPL channels array for advanced MIDI control
-extern OPLChannel opl_channels[MAX_OPL_CHANNELS];
-
-// Load instrument data from your existing instruments.c
+// Load instrument data from your existing instruments.c; only the first
+// call does any work, so every synth can call it
 extern void OPL_LoadInstruments(void);
 
 #endif // DBOPL_WRAPPER_H
@@ -0,0 +1,310 @@
+#include "disk_cache.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#define DISK_CACHE_MAGIC "ZNPCM01"   // 8 bytes with the terminator
+
+// On-disk entry layout: this header, the source path, padding to 8 bytes,
+// then the interleaved samples in native byte order
+typedef struct {
+    char magic[8];
+    char decoder_version[24];
+    uint32_t header_size;      // Offset of the samples in the file
+    uint32_t path_length;
+    int64_t source_mtime;
+    int64_t source_size;
+    uint64_t samples;
+    int32_t sample_rate;
+    int32_t channels;
+    int32_t bits_per_sample;
+    int32_t reserved;
+    double song_duration;
+} DiskCacheHeader;
+
+typedef struct {
+    char *path;
+    time_t last_used;
+    size_t size;
+} DiskCacheFile;
+
+// FNV-1a, only used to name the entry files; the header holds the full key
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static char* entry_path(DiskCache *cache, const char *source_path, const GStatBuf *st) {
+    int64_t mtime = (int64_t)st->st_mtime;
+    int64_t size = (int64_t)st->st_size;
+
+    uint64_t hash = 14695981039346656037ULL;
+    hash = hash_bytes(hash, source_path, strlen(source_path) + 1);
+    hash = hash_bytes(hash, &mtime, sizeof(mtime));
+    hash = hash_bytes(hash, &size, sizeof(size));
+    hash = hash_bytes(hash, DISK_CACHE_DECODER_VERSION, sizeof(DISK_CACHE_DECODER_VERSION));
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.pcm", (unsigned long long)hash);
+    return g_build_filename(cache->directory, name, NULL);
+}
+
+static bool is_entry_name(const char *name) {
+    return g_str_has_suffix(name, ".pcm");
+}
+
+// Sum the entries on disk and optionally collect them for GC
+static size_t scan_entries(DiskCache *cache, std::vector<DiskCacheFile> *files) {
+    GDir *dir = g_dir_open(cache->directory, 0, NULL);
+    if (!dir) return 0;
+
+    size_t total = 0;
+    const char *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (!is_entry_name(name)) continue;
+
+        char *path = g_build_filename(cache->directory, name, NULL);
+        GStatBuf st;
+        if (g_stat(path, &st) != 0) {
+            g_free(path);
+            continue;
+        }
+
+        total += (size_t)st.st_size;
+        if (files) {
+            DiskCacheFile file = { path, st.st_mtime, (size_t)st.st_size };
+            files->push_back(file);
+        } else {
+            g_free(path);
+        }
+    }
+    g_dir_close(dir);
+    return total;
+}
+
+bool disk_cache_init(DiskCache *cache, size_t max_mb) {
+    memset(cache, 0, sizeof(*cache));
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->directory = g_build_filename(g_get_user_cache_dir(), "zenamp", "pcm", NULL);
+    cache->max_bytes = max_mb * 1024 * 1024;
+
+    if (g_mkdir_with_parents(cache->directory, 0755) != 0) {
+        printf("Disk cache: cannot create %s, disabled\n", cache->directory);
+        return false;
+    }
+
+    cache->enabled = true;
+    cache->total_bytes = scan_entries(cache, NULL);
+    printf("Disk cache: %s, %.2f/%zu MB\n", cache->directory,
+           cache->total_bytes / (1024.0 * 1024.0), max_mb);
+    return true;
+}
+
+void disk_cache_free(DiskCache *cache) {
+    if (cache->directory) {
+        printf("Disk cache: %llu hits, %llu misses, %llu stores, %llu evictions\n",
+               (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+               (unsigned long long)cache->stores, (unsigned long long)cache->evictions);
+    }
+    pthread_mutex_lock(&cache->lock);
+    g_free(cache->directory);
+    cache->directory = NULL;
+    cache->enabled = false;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void disk_cache_set_enabled(DiskCache *cache, bool enabled) {
+    pthread_mutex_lock(&cache->lock);
+    cache->enabled = enabled && cache->directory != NULL;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static void collect_locked(DiskCache *cache, size_t target_bytes);
+
+void disk_cache_set_limit(DiskCache *cache, size_t max_mb) {
+    pthread_mutex_lock(&cache->lock);
+    cache->max_bytes = max_mb * 1024 * 1024;
+    if (cache->enabled && cache->total_bytes > cache->max_bytes) {
+        collect_locked(cache, (size_t)(cache->max_bytes * DISK_CACHE_GC_TARGET));
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void disk_cache_collect(DiskCache *cache, size_t target_bytes) {
+    pthread_mutex_lock(&cache->lock);
+    collect_locked(cache, target_bytes);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static void collect_locked(DiskCache *cache, size_t target_bytes) {
+    if (!cache->directory) return;
+
+    std::vector<DiskCacheFile> files;
+    cache->total_bytes = scan_entries(cache, &files);
+
+    // Oldest use first; lookups touch the file's mtime on every hit
+    std::sort(files.begin(), files.end(), [](const DiskCacheFile &a, const DiskCacheFile &b) {
+        return a.last_used < b.last_used;
+    });
+
+    for (size_t i = 0; i < files.size(); i++) {
+        if (cache->total_bytes > target_bytes && g_remove(files[i].path) == 0) {
+            cache->total_bytes -= files[i].size;
+            cache->evictions++;
+        }
+        g_free(files[i].path);
+    }
+}
+
+static bool read_header(FILE *f, DiskCacheHeader *header, const char *source_path, const GStatBuf *st) {
+    if (fread(header, sizeof(*header), 1, f) != 1) return false;
+    if (memcmp(header->magic, DISK_CACHE_MAGIC, sizeof(header->magic)) != 0) return false;
+    if (strncmp(header->decoder_version, DISK_CACHE_DECODER_VERSION, sizeof(header->decoder_version)) != 0) return false;
+    if (header->source_mtime != (int64_t)st->st_mtime || header->source_size != (int64_t)st->st_size) return false;
+    if (header->bits_per_sample != 16 || header->channels <= 0 || header->sample_rate <= 0) return false;
+    if (header->header_size % 8 != 0 || header->header_size < sizeof(*header) + header->path_length) return false;
+
+    size_t path_length = strlen(source_path);
+    if (header->path_length != path_length) return false;
+
+    // The file name is only a hash, so the stored path settles collisions
+    char *stored = (char*)malloc(path_length + 1);
+    if (!stored) return false;
+    bool match = fread(stored, 1, path_length, f) == path_length &&
+                 memcmp(stored, source_path, path_length) == 0;
+    free(stored);
+    return match;
+}
+
+static PCMBlock* lookup_locked(DiskCache *cache, const char *source_path, DiskCacheInfo *info) {
+    if (!cache->enabled) return NULL;
+
+    GStatBuf st;
+    if (g_stat(source_path, &st) != 0) return NULL;
+
+    char *path = entry_path(cache, source_path, &st);
+    FILE *f = g_fopen(path, "rb");
+    if (!f) {
+        cache->misses++;
+        g_free(path);
+        return NULL;
+    }
+
+    DiskCacheHeader header;
+    bool valid = read_header(f, &header, source_path, &st);
+    fclose(f);
+
+    PCMBlock *block = valid ? pcm_block_map_file(path, header.header_size, (size_t)header.samples) : NULL;
+    if (!block) {
+        // Stale from an old decoder, truncated or a hash collision
+        printf("Disk cache: dropping unusable entry %s\n", path);
+        g_remove(path);
+        cache->misses++;
+        g_free(path);
+        return NULL;
+    }
+
+    // Mark it recently used for GC
+    g_utime(path, NULL);
+    g_free(path);
+
+    info->sample_rate = header.sample_rate;
+    info->channels = header.channels;
+    info->bits_per_sample = header.bits_per_sample;
+    info->song_duration = header.song_duration;
+    cache->hits++;
+    return block;
+}
+
+PCMBlock* disk_cache_lookup(DiskCache *cache, const char *source_path, DiskCacheInfo *info) {
+    pthread_mutex_lock(&cache->lock);
+    PCMBlock *block = lookup_locked(cache, source_path, info);
+    pthread_mutex_unlock(&cache->lock);
+    return block;
+}
+
+static bool store_locked(DiskCache *cache, const char *source_path, const PCMBlock *block,
+                         const DiskCacheInfo *info) {
+    if (!cache->enabled || !block || info->bits_per_sample != 16) return false;
+
+    size_t bytes = block->length * sizeof(int16_t);
+    size_t path_length = strlen(source_path);
+    size_t header_size = (sizeof(DiskCacheHeader) + path_length + 7) & ~(size_t)7;
+    if (header_size + bytes > cache->max_bytes) return false;
+
+    GStatBuf st;
+    if (g_stat(source_path, &st) != 0) return false;
+
+    DiskCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DISK_CACHE_MAGIC, sizeof(header.magic));
+    strncpy(header.decoder_version, DISK_CACHE_DECODER_VERSION, sizeof(header.decoder_version) - 1);
+    header.header_size = (uint32_t)header_size;
+    header.path_length = (uint32_t)path_length;
+    header.source_mtime = (int64_t)st.st_mtime;
+    header.source_size = (int64_t)st.st_size;
+    header.samples = block->length;
+    header.sample_rate = info->sample_rate;
+    header.channels = info->channels;
+    header.bits_per_sample = info->bits_per_sample;
+    header.song_duration = info->song_duration;
+
+    // Write under a temporary name and rename, so a crash never leaves a
+    // truncated entry behind under the real name
+    char *path = entry_path(cache, source_path, &st);
+    char *temp_path = g_strconcat(path, ".tmp", NULL);
+
+    FILE *f = g_fopen(temp_path, "wb");
+    bool ok = f != NULL;
+    if (ok) {
+        static const char padding[8] = {0};
+        ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(source_path, 1, path_length, f) == path_length &&
+             fwrite(padding, 1, header_size - sizeof(header) - path_length, f) ==
+                 header_size - sizeof(header) - path_length &&
+             fwrite(block->data, sizeof(int16_t), block->length, f) == block->length;
+        ok = fclose(f) == 0 && ok;
+    }
+
+    if (ok) {
+        // rename() won't replace an existing file on Windows. An entry for
+        // the same key leaves the total with it.
+        GStatBuf old_st;
+        if (g_stat(path, &old_st) == 0 && g_remove(path) == 0) {
+            size_t old_bytes = (size_t)old_st.st_size;
+            cache->total_bytes -= old_bytes < cache->total_bytes ? old_bytes : cache->total_bytes;
+        }
+        ok = g_rename(temp_path, path) == 0;
+    }
+    if (!ok) {
+        printf("Disk cache: failed to write %s\n", path);
+        g_remove(temp_path);
+    } else {
+        cache->total_bytes += header_size + bytes;
+        cache->stores++;
+    }
+
+    g_free(temp_path);
+    g_free(path);
+
+    if (ok && cache->total_bytes > cache->max_bytes) {
+        collect_locked(cache, (size_t)(cache->max_bytes * DISK_CACHE_GC_TARGET));
+    }
+    return ok;
+}
+
+bool disk_cache_store(DiskCache *cache, const char *source_path, const PCMBlock *block,
+                      const DiskCacheInfo *info) {
+    pthread_mutex_lock(&cache->lock);
+    bool ok = store_locked(cache, source_path, block, info);
+    pthread_mutex_unlock(&cache->lock);
+    return ok;
+}
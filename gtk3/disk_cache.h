@@ -0,0 +1,59 @@
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "pcm_block.h"
+
+// Persistent cache of decoded PCM for formats that are converted in one go
+// (MIDI, MP3, AIFF, ...), so a restart doesn't have to render them again.
+// Each entry is one file under the user cache dir holding a small header
+// and the raw samples, which are mapped straight into a PCMBlock on a hit.
+//
+// Entries are keyed by source path, modification time and size (the same
+// fields is_file_modified() checks) plus DISK_CACHE_DECODER_VERSION. Bump
+// the version whenever a decoder or the MIDI renderer changes its output.
+// The least recently used entries are removed once the cache grows past
+// its size limit. Lookups and stores may come from the prefetch worker as
+// well as the GUI thread, so they are serialised on one lock.
+
+#define DISK_CACHE_DECODER_VERSION "zenamp-pcm-5"
+#define DISK_CACHE_DEFAULT_MB      1024
+#define DISK_CACHE_GC_TARGET       0.9    // GC trims down to this fraction of the limit
+
+typedef struct {
+    int sample_rate;
+    int channels;
+    int bits_per_sample;
+    double song_duration;
+} DiskCacheInfo;
+
+typedef struct {
+    pthread_mutex_t lock;
+    bool enabled;
+    char *directory;
+    size_t max_bytes;
+    size_t total_bytes;    // Of all entries, from the last scan plus stores since
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+} DiskCache;
+
+bool disk_cache_init(DiskCache *cache, size_t max_mb);
+void disk_cache_free(DiskCache *cache);
+void disk_cache_set_enabled(DiskCache *cache, bool enabled);
+void disk_cache_set_limit(DiskCache *cache, size_t max_mb);
+
+// Mapped samples for source_path with one reference, or NULL
+PCMBlock* disk_cache_lookup(DiskCache *cache, const char *source_path, DiskCacheInfo *info);
+bool disk_cache_store(DiskCache *cache, const char *source_path, const PCMBlock *block,
+                      const DiskCacheInfo *info);
+
+// Remove least recently used entries until the cache is under target_bytes
+void disk_cache_collect(DiskCache *cache, size_t target_bytes);
+
+#endif // DISK_CACHE_H
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
@@ -6,30 +7,64 @@
 #include "equalizer.h"
 #include "audio_player.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define EQ_X86 1
+#endif
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
 extern AudioPlayer *player;
 
+// Bass: 100 Hz, Mid: 1000 Hz, Treble: 8000 Hz
+static const double eq_band_frequency[EQ_BANDS] = { 100.0, 1000.0, 8000.0 };
+#define EQ_Q_FACTOR 0.7
+
+// Peaking EQ biquad, normalised: out = { b0, b1, b2, a1, a2 }
+static void peaking_coefficients(double out[5], double frequency, double gain_db, double q, int sample_rate) {
+    double w = 2.0 * M_PI * frequency / sample_rate;
+    double cos_w = cos(w);
+    double sin_w = sin(w);
+    double A = pow(10.0, gain_db / 40.0);  // Square root of linear gain
+    double alpha = sin_w / (2.0 * q);
+    
+    double b0 = 1.0 + alpha * A;
+    double b1 = -2.0 * cos_w;
+    double b2 = 1.0 - alpha * A;
+    double a0 = 1.0 + alpha / A;
+    double a1 = -2.0 * cos_w;
+    double a2 = 1.0 - alpha / A;
+    
+    out[0] = b0 / a0;
+    out[1] = b1 / a0;
+    out[2] = b2 / a0;
+    out[3] = a1 / a0;
+    out[4] = a2 / a0;
+}
+
 Equalizer* equalizer_new(int sample_rate) {
-    Equalizer *eq = (Equalizer*)malloc(sizeof(Equalizer));
+    Equalizer *eq = (Equalizer*)calloc(1, sizeof(Equalizer));
     if (!eq) return NULL;
     
-    memset(eq, 0, sizeof(Equalizer));
     eq->sample_rate = sample_rate;
     eq->enabled = true;
+    eq->applied_enabled = true;
     
     // Initialize with neutral settings (0 dB gain)
     eq->bass_gain_db = 0.0;
     eq->mid_gain_db = 0.0;
     eq->treble_gain_db = 0.0;
     
-    // Set up frequency bands
-    // Bass: 100 Hz, Mid: 1000 Hz, Treble: 8000 Hz
-    calculate_biquad_coefficients(&eq->bands[0], 100.0, 0.0, 0.7, sample_rate);
-    calculate_biquad_coefficients(&eq->bands[1], 1000.0, 0.0, 0.7, sample_rate);
-    calculate_biquad_coefficients(&eq->bands[2], 8000.0, 0.0, 0.7, sample_rate);
+    for (int i = 0; i < EQ_BANDS; i++) {
+        EQBand *band = &eq->bands[i];
+        band->frequency = eq_band_frequency[i];
+        band->q_factor = EQ_Q_FACTOR;
+        calculate_biquad_coefficients(&band->current, band->frequency, 0.0, band->q_factor, sample_rate);
+        band->target = band->current;
+        eq->target_gain_db[i].store(0.0);
+    }
     
     return eq;
 }
@@ -46,6 +81,12 @@ void equalizer_set_enabled(Equalizer *eq, bool enabled) {
     }
 }
 
+// GUI side: record the gain and let the audio thread ramp to it
+static void equalizer_set_band(Equalizer *eq, int band, double gain_db) {
+    eq->target_gain_db[band].store(gain_db, std::memory_order_relaxed);
+    eq->settings_version.fetch_add(1, std::memory_order_release);
+}
+
 void equalizer_set_bass(Equalizer *eq, double gain_db) {
     if (!eq) return;
     
@@ -54,7 +95,7 @@ void equalizer_set_bass(Equalizer *eq, double gain_db) {
     if (gain_db > 12.0) gain_db = 12.0;
     
     eq->bass_gain_db = gain_db;
-    calculate_biquad_coefficients(&eq->bands[0], 100.0, gain_db, 0.7, eq->sample_rate);
+    equalizer_set_band(eq, 0, gain_db);
 }
 
 void equalizer_set_mid(Equalizer *eq, double gain_db) {
@@ -65,7 +106,7 @@ void equalizer_set_mid(Equalizer *eq, double gain_db) {
     if (gain_db > 12.0) gain_db = 12.0;
     
     eq->mid_gain_db = gain_db;
-    calculate_biquad_coefficients(&eq->bands[1], 1000.0, gain_db, 0.7, eq->sample_rate);
+    equalizer_set_band(eq, 1, gain_db);
 }
 
 void equalizer_set_treble(Equalizer *eq, double gain_db) {
@@ -76,94 +117,347 @@ void equalizer_set_treble(Equalizer *eq, double gain_db) {
     if (gain_db > 12.0) gain_db = 12.0;
     
     eq->treble_gain_db = gain_db;
-    calculate_biquad_coefficients(&eq->bands[2], 8000.0, gain_db, 0.7, eq->sample_rate);
+    equalizer_set_band(eq, 2, gain_db);
 }
 
 void equalizer_reset(Equalizer *eq) {
     if (!eq) return;
     
-    // Reset all filter states
+    // Filter state belongs to the audio thread, which clears it next block
+    eq->reset_requested.store(true, std::memory_order_release);
+}
+
+static void equalizer_clear_state(Equalizer *eq) {
     for (int i = 0; i < EQ_BANDS; i++) {
-        memset(eq->bands[i].x, 0, sizeof(eq->bands[i].x));
-        memset(eq->bands[i].y, 0, sizeof(eq->bands[i].y));
+        memset(eq->bands[i].z1, 0, sizeof(eq->bands[i].z1));
+        memset(eq->bands[i].z2, 0, sizeof(eq->bands[i].z2));
     }
 }
 
-int16_t equalizer_process_sample(Equalizer *eq, int16_t input) {
-    if (!eq || !eq->enabled) return input;
+// Audio thread: pick up new settings and start a coefficient ramp. A
+// disabled equalizer ramps to flat before it is bypassed so toggling it
+// does not click either.
+static void equalizer_apply_settings(Equalizer *eq) {
+    if (eq->reset_requested.exchange(false, std::memory_order_acquire)) {
+        equalizer_clear_state(eq);
+    }
     
-    double sample = (double)input / 32768.0;  // Convert to float
-    double output = sample;
+    bool enabled = eq->enabled.load(std::memory_order_relaxed);
+    unsigned version = eq->settings_version.load(std::memory_order_acquire);
+    if (version == eq->applied_version && enabled == eq->applied_enabled) return;
+    
+    eq->applied_version = version;
+    eq->applied_enabled = enabled;
+    
+    if (enabled && eq->bypassed) {
+        // History is stale after a bypass
+        equalizer_clear_state(eq);
+        eq->bypassed = false;
+    }
+    
+    const float inv_ramp = 1.0f / EQ_RAMP_FRAMES;
+    for (int i = 0; i < EQ_BANDS; i++) {
+        EQBand *band = &eq->bands[i];
+        double gain_db = enabled ? eq->target_gain_db[i].load(std::memory_order_relaxed) : 0.0;
+        calculate_biquad_coefficients(&band->target, band->frequency, gain_db, band->q_factor, eq->sample_rate);
+        
+        band->step.b0 = (band->target.b0 - band->current.b0) * inv_ramp;
+        band->step.b1 = (band->target.b1 - band->current.b1) * inv_ramp;
+        band->step.b2 = (band->target.b2 - band->current.b2) * inv_ramp;
+        band->step.a1 = (band->target.a1 - band->current.a1) * inv_ramp;
+        band->step.a2 = (band->target.a2 - band->current.a2) * inv_ramp;
+    }
+    eq->ramp_frames_left = EQ_RAMP_FRAMES;
+}
+
+// Run the three-band cascade over `frames` interleaved frames with one lane
+// per channel. With `ramping` set the coefficients advance by one step per
+// frame; the caller updates band->current afterwards.
+#ifdef EQ_X86
+static inline __m128 eq_load_frame(const int16_t *frame, int channels) {
+    __m128i v;
+    if (channels == 2) {
+        int32_t pair;
+        memcpy(&pair, frame, sizeof(pair));
+        v = _mm_cvtsi32_si128(pair);
+        v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    } else {
+        int32_t lanes[EQ_MAX_CHANNELS] = { 0, 0, 0, 0 };
+        for (int c = 0; c < channels; c++) lanes[c] = frame[c];
+        v = _mm_loadu_si128((const __m128i*)lanes);
+    }
+    return _mm_cvtepi32_ps(v);
+}
+
+static inline void eq_store_frame(int16_t *frame, int channels, __m128 y) {
+    // packs saturates to the int16 range, so no separate clipping is needed
+    __m128i v = _mm_packs_epi32(_mm_cvtps_epi32(y), _mm_setzero_si128());
+    if (channels == 2) {
+        int32_t pair = _mm_cvtsi128_si32(v);
+        memcpy(frame, &pair, sizeof(pair));
+    } else {
+        int16_t lanes[8];
+        _mm_storeu_si128((__m128i*)lanes, v);
+        for (int c = 0; c < channels; c++) frame[c] = lanes[c];
+    }
+}
+
+static void equalizer_run(Equalizer *eq, int16_t *buffer, size_t frames, int channels, bool ramping) {
+    __m128 b0[EQ_BANDS], b1[EQ_BANDS], b2[EQ_BANDS], a1[EQ_BANDS], a2[EQ_BANDS];
+    __m128 db0[EQ_BANDS], db1[EQ_BANDS], db2[EQ_BANDS], da1[EQ_BANDS], da2[EQ_BANDS];
+    __m128 z1[EQ_BANDS], z2[EQ_BANDS];
     
-    // Apply each band filter
     for (int i = 0; i < EQ_BANDS; i++) {
-        output = biquad_filter(&eq->bands[i], output);
+        const EQBand *band = &eq->bands[i];
+        b0[i] = _mm_set1_ps(band->current.b0);
+        b1[i] = _mm_set1_ps(band->current.b1);
+        b2[i] = _mm_set1_ps(band->current.b2);
+        a1[i] = _mm_set1_ps(band->current.a1);
+        a2[i] = _mm_set1_ps(band->current.a2);
+        db0[i] = _mm_set1_ps(band->step.b0);
+        db1[i] = _mm_set1_ps(band->step.b1);
+        db2[i] = _mm_set1_ps(band->step.b2);
+        da1[i] = _mm_set1_ps(band->step.a1);
+        da2[i] = _mm_set1_ps(band->step.a2);
+        z1[i] = _mm_loadu_ps(band->z1);
+        z2[i] = _mm_loadu_ps(band->z2);
     }
     
-    // Convert back to int16_t with clipping
-    output *= 32768.0;
-    if (output > 32767.0) output = 32767.0;
-    if (output < -32768.0) output = -32768.0;
+    for (size_t f = 0; f < frames; f++) {
+        int16_t *frame = buffer + f * channels;
+        __m128 x = eq_load_frame(frame, channels);
+        
+        for (int i = 0; i < EQ_BANDS; i++) {
+            __m128 y = _mm_add_ps(_mm_mul_ps(b0[i], x), z1[i]);
+            z1[i] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1[i], x), _mm_mul_ps(a1[i], y)), z2[i]);
+            z2[i] = _mm_sub_ps(_mm_mul_ps(b2[i], x), _mm_mul_ps(a2[i], y));
+            x = y;
+            
+            if (ramping) {
+                b0[i] = _mm_add_ps(b0[i], db0[i]);
+                b1[i] = _mm_add_ps(b1[i], db1[i]);
+                b2[i] = _mm_add_ps(b2[i], db2[i]);
+                a1[i] = _mm_add_ps(a1[i], da1[i]);
+                a2[i] = _mm_add_ps(a2[i], da2[i]);
+            }
+        }
+        
+        eq_store_frame(frame, channels, x);
+    }
     
-    return (int16_t)output;
+    for (int i = 0; i < EQ_BANDS; i++) {
+        _mm_storeu_ps(eq->bands[i].z1, z1[i]);
+        _mm_storeu_ps(eq->bands[i].z2, z2[i]);
+    }
 }
-
-void equalizer_process_buffer(Equalizer *eq, int16_t *buffer, size_t length) {
-    if (!eq || !eq->enabled || !buffer) return;
+#else
+static void equalizer_run(Equalizer *eq, int16_t *buffer, size_t frames, int channels, bool ramping) {
+    EQCoeffs coeffs[EQ_BANDS];
+    for (int i = 0; i < EQ_BANDS; i++) coeffs[i] = eq->bands[i].current;
     
-    for (size_t i = 0; i < length; i++) {
-        buffer[i] = equalizer_process_sample(eq, buffer[i]);
+    for (size_t f = 0; f < frames; f++) {
+        int16_t *frame = buffer + f * channels;
+        float x[EQ_MAX_CHANNELS];
+        for (int c = 0; c < channels; c++) x[c] = frame[c];
+        
+        for (int i = 0; i < EQ_BANDS; i++) {
+            EQBand *band = &eq->bands[i];
+            EQCoeffs *k = &coeffs[i];
+            for (int c = 0; c < channels; c++) {
+                float y = k->b0 * x[c] + band->z1[c];
+                band->z1[c] = k->b1 * x[c] - k->a1 * y + band->z2[c];
+                band->z2[c] = k->b2 * x[c] - k->a2 * y;
+                x[c] = y;
+            }
+            if (ramping) {
+                k->b0 += band->step.b0;
+                k->b1 += band->step.b1;
+                k->b2 += band->step.b2;
+                k->a1 += band->step.a1;
+                k->a2 += band->step.a2;
+            }
+        }
+        
+        for (int c = 0; c < channels; c++) {
+            float y = x[c] + (x[c] >= 0.0f ? 0.5f : -0.5f);
+            if (y > 32767.0f) y = 32767.0f;
+            if (y < -32768.0f) y = -32768.0f;
+            frame[c] = (int16_t)y;
+        }
     }
 }
+#endif
 
-void calculate_biquad_coefficients(EQBand *band, double frequency, double gain_db, double q, int sample_rate) {
-    if (!band) return;
+// Filters a block of interleaved frames in place. Called from the audio
+// callback; never blocks or allocates.
+void equalizer_process_buffer(Equalizer *eq, int16_t *buffer, size_t frames, int channels) {
+    if (!eq || !buffer || frames == 0) return;
+    if (channels < 1 || channels > EQ_MAX_CHANNELS) return;
     
-    double w = 2.0 * M_PI * frequency / sample_rate;
-    double cos_w = cos(w);
-    double sin_w = sin(w);
-    double A = pow(10.0, gain_db / 40.0);  // Square root of linear gain
-    double alpha = sin_w / (2.0 * q);
+    equalizer_apply_settings(eq);
+    if (eq->bypassed) return;
     
-    // Peaking EQ coefficients
-    double b0 = 1.0 + alpha * A;
-    double b1 = -2.0 * cos_w;
-    double b2 = 1.0 - alpha * A;
-    double a0 = 1.0 + alpha / A;
-    double a1 = -2.0 * cos_w;
-    double a2 = 1.0 - alpha / A;
+#ifdef EQ_X86
+    // Decaying filter tails would otherwise run into slow denormals
+    unsigned int saved_csr = _mm_getcsr();
+    _mm_setcsr(saved_csr | 0x8040);  // FTZ | DAZ
+#endif
+    
+    if (eq->ramp_frames_left > 0) {
+        size_t ramp = frames < (size_t)eq->ramp_frames_left ? frames : (size_t)eq->ramp_frames_left;
+        equalizer_run(eq, buffer, ramp, channels, true);
+        
+        eq->ramp_frames_left -= (int)ramp;
+        for (int i = 0; i < EQ_BANDS; i++) {
+            EQBand *band = &eq->bands[i];
+            if (eq->ramp_frames_left == 0) {
+                band->current = band->target;
+            } else {
+                band->current.b0 += band->step.b0 * ramp;
+                band->current.b1 += band->step.b1 * ramp;
+                band->current.b2 += band->step.b2 * ramp;
+                band->current.a1 += band->step.a1 * ramp;
+                band->current.a2 += band->step.a2 * ramp;
+            }
+        }
+        
+        buffer += ramp * channels;
+        frames -= ramp;
+    }
     
-    // Normalize coefficients
-    band->b[0] = b0 / a0;
-    band->b[1] = b1 / a0;
-    band->b[2] = b2 / a0;
-    band->a[0] = 1.0;
-    band->a[1] = a1 / a0;
-    band->a[2] = a2 / a0;
-    
-    band->frequency = frequency;
-    band->q_factor = q;
-    band->gain = db_to_linear(gain_db);
+    if (frames > 0) {
+        equalizer_run(eq, buffer, frames, channels, false);
+    }
+    
+#ifdef EQ_X86
+    _mm_setcsr(saved_csr);
+#endif
+    
+    if (!eq->applied_enabled && eq->ramp_frames_left == 0) {
+        eq->bypassed = true;
+    }
+}
+
+void calculate_biquad_coefficients(EQCoeffs *coeffs, double frequency, double gain_db, double q, int sample_rate) {
+    if (!coeffs) return;
+    
+    double c[5];
+    peaking_coefficients(c, frequency, gain_db, q, sample_rate);
+    coeffs->b0 = (float)c[0];
+    coeffs->b1 = (float)c[1];
+    coeffs->b2 = (float)c[2];
+    coeffs->a1 = (float)c[3];
+    coeffs->a2 = (float)c[4];
 }
 
 double db_to_linear(double db) {
     return pow(10.0, db / 20.0);
 }
 
-double biquad_filter(EQBand *band, double input) {
-    if (!band) return input;
+// ---------------------------------------------------------------------------
+// Benchmark (zenamp --benchmark-eq): the old per-sample double-precision
+// path against the block processor, on 20 seconds of stereo audio
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    double c[5];
+    double x[2];
+    double y[2];
+} LegacyBand;
+
+static int16_t legacy_process_sample(LegacyBand *bands, int16_t input) {
+    double output = (double)input / 32768.0;
+    for (int i = 0; i < EQ_BANDS; i++) {
+        LegacyBand *band = &bands[i];
+        double in = output;
+        output = band->c[0] * in + band->c[1] * band->x[0] + band->c[2] * band->x[1]
+               - band->c[3] * band->y[0] - band->c[4] * band->y[1];
+        band->x[1] = band->x[0];
+        band->x[0] = in;
+        band->y[1] = band->y[0];
+        band->y[0] = output;
+    }
+    output *= 32768.0;
+    if (output > 32767.0) output = 32767.0;
+    if (output < -32768.0) output = -32768.0;
+    return (int16_t)output;
+}
+
+int equalizer_benchmark(void) {
+    const int sample_rate = 44100;
+    const int channels = 2;
+    const size_t block_frames = 1024;   // Same as the SDL device buffer
+    const size_t frames = (size_t)sample_rate * 20;
+    const size_t samples = frames * channels;
+    const double gains[EQ_BANDS] = { 6.0, -3.0, 4.0 };
+    const int runs = 5;
+    
+    int16_t *input = (int16_t*)malloc(samples * sizeof(int16_t));
+    int16_t *work = (int16_t*)malloc(samples * sizeof(int16_t));
+    if (!input || !work) {
+        printf("Equalizer benchmark: out of memory\n");
+        free(input);
+        free(work);
+        return 1;
+    }
+    
+    unsigned int seed = 12345;
+    for (size_t f = 0; f < frames; f++) {
+        for (int c = 0; c < channels; c++) {
+            seed = seed * 1103515245u + 12345u;
+            double tone = sin(2.0 * M_PI * (220.0 * (c + 1)) * f / sample_rate) * 12000.0;
+            double noise = (double)((seed >> 16) & 0x7FFF) / 32768.0 * 4000.0 - 2000.0;
+            input[f * channels + c] = (int16_t)(tone + noise);
+        }
+    }
+    
+    double best_legacy = 1e30, best_block = 1e30;
+    long checksum = 0;
     
-    // Biquad filter implementation (Direct Form II)
-    double output = band->b[0] * input + band->b[1] * band->x[0] + band->b[2] * band->x[1]
-                   - band->a[1] * band->y[0] - band->a[2] * band->y[1];
+    for (int run = 0; run < runs; run++) {
+        LegacyBand legacy[EQ_BANDS];
+        memset(legacy, 0, sizeof(legacy));
+        for (int i = 0; i < EQ_BANDS; i++) {
+            peaking_coefficients(legacy[i].c, eq_band_frequency[i], gains[i], EQ_Q_FACTOR, sample_rate);
+        }
+        
+        memcpy(work, input, samples * sizeof(int16_t));
+        gint64 start = g_get_monotonic_time();
+        for (size_t i = 0; i < samples; i++) {
+            work[i] = legacy_process_sample(legacy, work[i]);
+        }
+        double elapsed = (g_get_monotonic_time() - start) / 1e6;
+        if (elapsed < best_legacy) best_legacy = elapsed;
+        checksum += work[samples / 2];
+        
+        Equalizer *eq = equalizer_new(sample_rate);
+        if (!eq) break;
+        equalizer_set_bass(eq, gains[0]);
+        equalizer_set_mid(eq, gains[1]);
+        equalizer_set_treble(eq, gains[2]);
+        
+        memcpy(work, input, samples * sizeof(int16_t));
+        start = g_get_monotonic_time();
+        for (size_t f = 0; f < frames; f += block_frames) {
+            size_t n = frames - f < block_frames ? frames - f : block_frames;
+            equalizer_process_buffer(eq, work + f * channels, n, channels);
+        }
+        elapsed = (g_get_monotonic_time() - start) / 1e6;
+        if (elapsed < best_block) best_block = elapsed;
+        checksum += work[samples / 2];
+        equalizer_free(eq);
+    }
     
-    // Shift delay line
-    band->x[1] = band->x[0];
-    band->x[0] = input;
-    band->y[1] = band->y[0];
-    band->y[0] = output;
+    printf("Equalizer benchmark: %zu frames, %d channels, %zu-frame blocks, best of %d\n",
+           frames, channels, block_frames, runs);
+    printf("  per-sample, double, shared state: %8.1f Msamples/s\n", samples / best_legacy / 1e6);
+    printf("  block, float SIMD, per channel:   %8.1f Msamples/s (%.1fx)\n",
+           samples / best_block / 1e6, best_legacy / best_block);
+    printf("  (checksum %ld)\n", checksum);
     
-    return output;
+    free(input);
+    free(work);
+    return 0;
 }
 
 void on_eq_enabled_toggled(GtkToggleButton *button, gpointer user_data) {
@@ -7,32 +7,54 @@
 #include <gtk/gtk.h>
 #include <string.h>
 
+#include <atomic>
+
 #define EQ_BANDS 3  // Bass, Mid, Treble
+#define EQ_MAX_CHANNELS 4     // One SIMD lane per channel
+#define EQ_RAMP_FRAMES 256    // Coefficients glide to new settings over this many frames
+
+// Normalised biquad coefficients (a0 == 1)
+typedef struct {
+    float b0, b1, b2;
+    float a1, a2;
+} EQCoeffs;
 
 typedef struct {
-    // Filter coefficients for each band
-    double a[3];  // denominator coefficients
-    double b[3];  // numerator coefficients
+    // Coefficients, only touched by the audio thread
+    EQCoeffs current;
+    EQCoeffs target;
+    EQCoeffs step;   // Per-frame increment while ramping
     
-    // Filter state (delay line)
-    double x[3];  // input history
-    double y[3];  // output history
+    // Transposed direct form II state, separate for every channel
+    float z1[EQ_MAX_CHANNELS];
+    float z2[EQ_MAX_CHANNELS];
     
     // Band parameters
-    double gain;     // Linear gain (0.0 to 2.0, 1.0 = no change)
     double frequency; // Center frequency
     double q_factor; // Quality factor
 } EQBand;
 
 typedef struct {
     EQBand bands[EQ_BANDS];
-    bool enabled;
+    std::atomic<bool> enabled;
     int sample_rate;
     
-    // Gain values in dB (-12 to +12)
+    // Gain values in dB (-12 to +12), GUI side
     double bass_gain_db;
     double mid_gain_db;
     double treble_gain_db;
+    
+    // Settings published by the GUI; the audio thread picks them up at the
+    // start of the next block and ramps towards them
+    std::atomic<double> target_gain_db[EQ_BANDS];
+    std::atomic<unsigned> settings_version;
+    std::atomic<bool> reset_requested;
+    
+    // Audio thread only
+    unsigned applied_version;
+    bool applied_enabled;
+    int ramp_frames_left;
+    bool bypassed;   // Disabled and fully ramped down to flat
 } Equalizer;
 
 // Function declarations
@@ -43,12 +65,11 @@ void equalizer_set_bass(Equalizer *eq, double gain_db);
 void equalizer_set_mid(Equalizer *eq, double gain_db);
 void equalizer_set_treble(Equalizer *eq, double gain_db);
 void equalizer_reset(Equalizer *eq);
-int16_t equalizer_process_sample(Equalizer *eq, int16_t input);
-void equalizer_process_buffer(Equalizer *eq, int16_t *buffer, size_t length);
+void equalizer_process_buffer(Equalizer *eq, int16_t *buffer, size_t frames, int channels);
+int equalizer_benchmark(void);
 
 // Internal functions
-void calculate_biquad_coefficients(EQBand *band, double frequency, double gain_db, double q, int sample_rate);
+void calculate_biquad_coefficients(EQCoeffs *coeffs, double frequency, double gain_db, double q, int sample_rate);
 double db_to_linear(double db);
-double biquad_filter(EQBand *band, double input);
 
 #endif
@@ -35,36 +35,27 @@ void update_fourier_transform(Visualizer *vis, double dt) {
     // Update display mode and zoom automatically
     update_fourier_mode(vis, dt);
     
-    // Simple DFT calculation (we could optimize with FFT later)
-    // This gives us the mathematical foundation that's visually interesting
+    // Bins come from the visualizer's shared FFT, sampled on a log scale so
+    // the bass is not squeezed into the first few points
     
     double center_x = vis->width / 2.0;
     double center_y = vis->height / 2.0;
     double base_radius = fmin(vis->width, vis->height) * 0.3 * vis->fourier_zoom;
     
-    // Calculate DFT for visualization
     for (int k = 0; k < FOURIER_POINTS; k++) {
         FourierBin *bin = &vis->fourier_bins[k];
         
-        // Reset for this frame
-        bin->real = 0.0;
-        bin->imag = 0.0;
-        
-        // Calculate DFT bin k
-        for (int n = 0; n < VIS_SAMPLES; n++) {
-            if (n >= VIS_SAMPLES) break;
-            
-            double angle = -2.0 * M_PI * k * n / VIS_SAMPLES;
-            double sample = vis->audio_samples[n];
-            
-            bin->real += sample * cos(angle);
-            bin->imag += sample * sin(angle);
+        if (vis->spectrum.valid) {
+            // Spectrum is normalised to 1.0 for a full-scale sine; halve it to
+            // keep the amplitude the old per-frame DFT produced
+            int fft_bin = spectrum_log_bin(&vis->spectrum, k, FOURIER_POINTS);
+            bin->real = vis->spectrum.bin_re[fft_bin] * 0.5 * vis->sensitivity;
+            bin->imag = vis->spectrum.bin_im[fft_bin] * 0.5 * vis->sensitivity;
+        } else {
+            bin->real = 0.0;
+            bin->imag = 0.0;
         }
         
-        // Normalize
-        bin->real /= VIS_SAMPLES;
-        bin->imag /= VIS_SAMPLES;
-        
         // Calculate magnitude and phase
         bin->magnitude = sqrt(bin->real * bin->real + bin->imag * bin->imag);
         bin->phase = atan2(bin->imag, bin->real);
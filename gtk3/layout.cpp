@@ -371,8 +371,13 @@ static void create_player_controls(AudioPlayer *player) {
 
     gtk_box_pack_start(GTK_BOX(player->layout.volume_box), volume_label, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(player->layout.volume_box), player->volume_scale, TRUE, TRUE, 0);
+    player->preserve_pitch_check = gtk_check_button_new_with_label("Keep pitch");
+    gtk_widget_set_tooltip_text(player->preserve_pitch_check, "Change tempo without changing pitch");
+    gtk_widget_set_can_focus(player->preserve_pitch_check, TRUE);
+
     gtk_box_pack_start(GTK_BOX(player->layout.volume_box), speed_label, FALSE, FALSE, 5);
     gtk_box_pack_start(GTK_BOX(player->layout.volume_box), player->speed_scale, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(player->layout.volume_box), player->preserve_pitch_check, FALSE, FALSE, 5);
 }
 
 static void create_queue_controls_compact(AudioPlayer *player) {
@@ -599,6 +604,7 @@ static void connect_widget_signals(AudioPlayer *player) {
     g_signal_connect(player->prev_button, "clicked", G_CALLBACK(on_previous_clicked), player);
     g_signal_connect(player->volume_scale, "value-changed", G_CALLBACK(on_volume_changed), player);
     g_signal_connect(player->speed_scale, "value-changed", G_CALLBACK(on_speed_changed), player);
+    g_signal_connect(player->preserve_pitch_check, "toggled", G_CALLBACK(on_preserve_pitch_toggled), player);
     g_signal_connect(player->add_to_queue_button, "clicked", G_CALLBACK(on_add_to_queue_clicked), player);
     g_signal_connect(player->clear_queue_button, "clicked", G_CALLBACK(on_clear_queue_clicked), player);
     g_signal_connect(player->repeat_queue_button, "toggled", G_CALLBACK(on_repeat_queue_toggled), player);
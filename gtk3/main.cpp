@@ -37,8 +37,6 @@ extern double playTime;
 extern bool isPlaying;
 extern bool paused;
 extern int globalVolume;
-extern void processEvents(void);
-extern double playwait;
 
 AudioPlayer *player = NULL;
 
@@ -60,28 +58,33 @@ static void signal_handler(int sig) {
             // Cleanup all resources in the same order as on_window_delete_event
             clear_queue(&player->queue);
             cleanup_queue_filter(player);
+            prefetch_shutdown(&player->prefetch);
+            metadata_scanner_shutdown(&player->metadata_scanner);
             cleanup_conversion_cache(&player->conversion_cache);
             cleanup_audio_cache(&player->audio_cache); 
+            disk_cache_free(&player->disk_cache);
+            metadata_index_free(&player->metadata_index);
             cleanup_virtual_filesystem();
             
+            printf("Closing SDL audio device\n");
+            if (player->audio_device) SDL_CloseAudioDevice(player->audio_device);
+            player->audio_device = 0;
+
+            // With the device closed the source is freed right away
             printf("Cleaning up Audio\n");
-            if (player->audio_buffer.data) free(player->audio_buffer.data);
+            release_audio_source(player);
+            resampler_free(&player->rt.resampler);
+            time_stretch_free(&player->rt.stretch);
 
             if (player->cdg_display) {
                 cdg_display_free(player->cdg_display);
             }    
 
-            printf("Closing SDL audio device\n");
-            if (player->audio_device) SDL_CloseAudioDevice(player->audio_device);
-
             printf("Cleaning Equalizer\n");
             if (player->equalizer) {
                 equalizer_free(player->equalizer);
             }
             
-            printf("Destroying audio mutex\n");
-            pthread_mutex_destroy(&player->audio_mutex);
-
             printf("Freeing player\n");
             g_free(player);
             player = NULL;
@@ -378,65 +381,221 @@ void on_remove_from_queue_clicked(GtkButton *button, gpointer user_data) {
     }
 }
 
+// Drop audio buffered in the conversion chain, e.g. after a seek
+static void reset_playback_chain(AudioRTState *rt) {
+    resampler_reset(&rt->resampler);
+    time_stretch_reset(&rt->stretch);
+    rt->frame_fill = 0;
+}
+
+// Apply the commands queued by the GUI thread. Runs at the start of every
+// audio block, or on the GUI thread while the device is paused or closed.
+static void process_audio_commands(AudioPlayer *player) {
+    AudioRTState *rt = &player->rt;
+    AudioCommand cmd;
+    
+    while (audio_command_pop(&player->audio_commands, &cmd)) {
+        switch (cmd.type) {
+            case AUDIO_CMD_SET_SOURCE:
+                if (rt->block || rt->stream) {
+                    // Hand the old source back to the GUI thread to release. If
+                    // that queue is somehow full, leaking beats blocking here.
+                    AudioCommand retired = {};
+                    retired.type = AUDIO_CMD_SET_SOURCE;
+                    retired.block = rt->block;
+                    retired.stream = rt->stream;
+                    audio_command_push(&player->retired_sources, &retired);
+                }
+                rt->block = cmd.block;
+                rt->data = cmd.block ? cmd.block->data : NULL;
+                rt->stream = cmd.stream;
+                rt->length = cmd.length;
+                rt->channels = cmd.ivalue > 0 ? cmd.ivalue : AUDIO_CHANNELS;
+                rt->sample_rate = cmd.sample_rate > 0 ? cmd.sample_rate : SAMPLE_RATE;
+                rt->position = 0;
+                rt->playing = false;
+                reset_playback_chain(rt);
+                break;
+            case AUDIO_CMD_PLAY:
+                rt->playing = true;
+                break;
+            case AUDIO_CMD_PAUSE:
+                rt->playing = false;
+                break;
+            case AUDIO_CMD_STOP:
+                rt->playing = false;
+                rt->position = 0;
+                reset_playback_chain(rt);
+                if (rt->stream) audio_stream_request_seek(rt->stream, 0);
+                break;
+            case AUDIO_CMD_SEEK:
+                rt->position = cmd.position < rt->length ? cmd.position : rt->length;
+                rt->position -= rt->position % rt->channels;
+                reset_playback_chain(rt);
+                if (rt->stream) audio_stream_request_seek(rt->stream, rt->position / rt->channels);
+                break;
+            case AUDIO_CMD_VOLUME:
+                rt->volume = cmd.ivalue;
+                break;
+            case AUDIO_CMD_SPEED:
+                // Picked up by the resampler ratio on the next block
+                rt->speed = cmd.dvalue;
+                break;
+            case AUDIO_CMD_RESAMPLE_FILTER: {
+                // Buffered input is kept, so this doesn't skip. The old table
+                // goes back to the GUI thread to free.
+                AudioCommand retired = {};
+                retired.type = AUDIO_CMD_RESAMPLE_FILTER;
+                retired.filter = resampler_swap_filter(&rt->resampler, cmd.filter);
+                audio_command_push(&player->retired_sources, &retired);
+                break;
+            }
+            case AUDIO_CMD_PRESERVE_PITCH:
+                rt->preserve_pitch = cmd.ivalue != 0;
+                break;
+        }
+    }
+    
+    player->audio_buffer.position.store(rt->position, std::memory_order_relaxed);
+}
+
+// Upstream of the resampler: pulls whole source frames and maps the
+// source's channels onto the device's. Position stays in source samples.
+static size_t read_source_frames(void *ctx, int16_t *dst, size_t max_frames) {
+    AudioPlayer *player = (AudioPlayer*)ctx;
+    AudioRTState *rt = &player->rt;
+    AudioStream *source = rt->stream;
+    const int channels = rt->channels;
+    const int out_channels = rt->resampler.channels;
+    size_t frames = 0;
+    
+    while (frames < max_frames) {
+        // A stream can run dry part way through a frame, so the frame is
+        // assembled across calls
+        while (rt->frame_fill < channels && rt->position < rt->length) {
+            int16_t sample;
+            if (source) {
+                if (!audio_stream_fill(source)) return frames;
+                sample = audio_stream_current(source);
+                audio_stream_advance(source);
+            } else {
+                sample = rt->data[rt->position];
+            }
+            if (rt->frame_fill < AUDIO_MAX_SOURCE_CHANNELS) rt->frame[rt->frame_fill] = sample;
+            rt->frame_fill++;
+            rt->position++;
+        }
+        if (rt->frame_fill < channels) break;
+        rt->frame_fill = 0;
+        
+        // Mono is duplicated, extra channels beyond the device's are dropped
+        int16_t *out = dst + frames * out_channels;
+        for (int c = 0; c < out_channels; c++) {
+            out[c] = rt->frame[c < channels ? c : 0];
+        }
+        frames++;
+    }
+    return frames;
+}
+
 void audio_callback(void* userdata, Uint8* stream, int len) {
     AudioPlayer* player = (AudioPlayer*)userdata;
+    AudioRTState *rt = &player->rt;
     memset(stream, 0, len);
     
-    if (pthread_mutex_trylock(&player->audio_mutex) != 0) return;
+    process_audio_commands(player);
     
-    if (!player->is_playing || player->is_paused || !player->audio_buffer.data) {
-        pthread_mutex_unlock(&player->audio_mutex);
+    if (!rt->playing || (!rt->data && !rt->stream)) {
         return;
     }
     
     int16_t* output = (int16_t*)stream;
-    int samples_requested = len / sizeof(int16_t);
-    size_t samples_remaining = player->audio_buffer.length - player->audio_buffer.position;
+    const int channels = rt->resampler.channels;
+    size_t frames_requested = len / (sizeof(int16_t) * channels);
+    AudioStream *source = rt->stream;
     
-    // Apply speed control
-    double speed = player->playback_speed;
+    double speed = rt->speed;
     if (speed <= 0.0) speed = 1.0; // Safety check
     
-    int samples_to_process = 0;
-    
-    for (int i = 0; i < samples_requested && player->audio_buffer.position < player->audio_buffer.length; i++) {
-        // Get current sample with volume and EQ processing
-        int32_t sample = player->audio_buffer.data[player->audio_buffer.position];
-        sample = (sample * globalVolume) / 100;
+    // The resampler converts the source rate to the device rate. Speed is
+    // either folded into its ratio, or, when the pitch is kept, handled by
+    // the time stretch stage in front of it.
+    double rate_ratio = (double)rt->sample_rate / player->audio_spec.freq;
+    bool stretch = rt->preserve_pitch && speed != 1.0;
+    if (stretch != rt->stretching) {
+        time_stretch_reset(&rt->stretch);
+        rt->stretching = stretch;
+    }
+    
+    size_t frames_done;
+    if (stretch) {
+        time_stretch_set_speed(&rt->stretch, speed);
+        resampler_set_ratio(&rt->resampler, rate_ratio);
+        frames_done = resampler_process(&rt->resampler, output, frames_requested, time_stretch_read, &rt->stretch);
+    } else {
+        resampler_set_ratio(&rt->resampler, rate_ratio * speed);
+        frames_done = resampler_process(&rt->resampler, output, frames_requested, read_source_frames, player);
+    }
+    
+    // When the source runs out (a stream may end slightly before its reported
+    // length) the time stretch stage and the resampler still hold the last
+    // few frames of it. The track is over once those are played too, the
+    // stretched tail first since it feeds the resampler.
+    bool source_done = rt->position >= rt->length || (source && audio_stream_finished(source));
+    bool ended = false;
+    if (source_done && stretch && frames_done < frames_requested) {
+        time_stretch_drain(&rt->stretch);
+        frames_done += resampler_process(&rt->resampler, output + frames_done * channels,
+                                         frames_requested - frames_done, time_stretch_read, &rt->stretch);
+    }
+    if (source_done && frames_done < frames_requested) {
+        size_t wanted = frames_requested - frames_done;
+        size_t tail = resampler_drain(&rt->resampler, output + frames_done * channels, wanted);
+        frames_done += tail;
+        ended = tail < wanted;
+    }
+    
+    int samples_to_process = (int)(frames_done * channels);
+    for (int i = 0; i < samples_to_process; i++) {
+        int32_t sample = (output[i] * rt->volume) / 100;
         if (sample > 32767) sample = 32767;
         else if (sample < -32768) sample = -32768;
-        
-        // Apply equalizer
-        int16_t eq_sample = equalizer_process_sample(player->equalizer, (int16_t)sample);
-        output[i] = eq_sample;
-        
-        samples_to_process++;
-        
-        // Advance position based on speed
-        player->speed_accumulator += speed;
-        
-        // Move to next sample when accumulator >= 1.0
-        while (player->speed_accumulator >= 1.0 && player->audio_buffer.position < player->audio_buffer.length) {
-            player->audio_buffer.position++;
-            player->speed_accumulator -= 1.0;
-        }
+        output[i] = (int16_t)sample;
+    }
+    
+    // Equalizer runs over the whole block, one SIMD lane per channel
+    if (player->equalizer && samples_to_process > 0) {
+        equalizer_process_buffer(player->equalizer, output, frames_done, channels);
     }
     
-    // Feed processed audio to visualizer
+    // Hand the processed block to the visualizer, analysis runs on the GUI timer
     if (player->visualizer && samples_to_process > 0) {
-        size_t sample_count = samples_to_process / player->channels;
-        visualizer_update_audio_data(player->visualizer, output, sample_count, player->channels);
+        visualizer_publish_audio(player->visualizer, output, frames_done, channels, player->audio_spec.freq);
     }
     
-    // Check if playback finished
-    if (player->audio_buffer.position >= player->audio_buffer.length) {
-        player->is_playing = false;
+    if (!source_done && frames_done < frames_requested &&
+        source && !audio_stream_seek_pending(source)) {
+        player->underrun_count.fetch_add(1, std::memory_order_relaxed);
     }
     
-    pthread_mutex_unlock(&player->audio_mutex);
+    player->audio_buffer.position.store(rt->position, std::memory_order_relaxed);
+    
+    if (ended) {
+        rt->playing = false;
+        player->playback_ended.store(true);
+    }
 }
 
-bool init_audio(AudioPlayer *player, int sample_rate, int channels) {
+// Open the output device. It runs at a fixed rate and channel count for the
+// whole session; sources at other rates go through the callback's resampler,
+// so loading a file never has to reopen it. Only reopens when the device is
+// gone, e.g. after the MIDI converter shut SDL down.
+bool init_audio(AudioPlayer *player) {
+    if (player->audio_device && SDL_WasInit(SDL_INIT_AUDIO) &&
+        SDL_GetAudioDeviceStatus(player->audio_device) != SDL_AUDIO_STOPPED) {
+        return true;
+    }
+    
 #ifdef _WIN32
     // Try different audio drivers in order of preference
     const char* drivers[] = {"directsound", "winmm", "wasapi", NULL};
@@ -461,9 +620,9 @@ bool init_audio(AudioPlayer *player, int sample_rate, int channels) {
 
     SDL_AudioSpec want;
     SDL_zero(want);
-    want.freq = sample_rate;  // Use actual file sample rate
+    want.freq = SAMPLE_RATE;
     want.format = AUDIO_S16SYS;
-    want.channels = channels;  // Use actual file channels
+    want.channels = AUDIO_CHANNELS;
     want.samples = 1024;
     want.callback = audio_callback;
     want.userdata = player;
@@ -473,19 +632,23 @@ bool init_audio(AudioPlayer *player, int sample_rate, int channels) {
         SDL_CloseAudioDevice(player->audio_device);
     }
     
-    player->audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &player->audio_spec, SDL_AUDIO_ALLOW_FORMAT_CHANGE);
+    // No allowed changes: SDL converts to whatever the hardware wants, so the
+    // callback always sees S16 stereo at SAMPLE_RATE
+    player->audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &player->audio_spec, 0);
     if (player->audio_device == 0) {
         printf("Audio device open failed: %s\n", SDL_GetError());
         return false;
     }
+    // SDL opens devices paused
+    player->audio_device_paused = true;
     
     printf("Audio: %d Hz, %d channels\n", player->audio_spec.freq, player->audio_spec.channels);
     
     // Reinitialize equalizer with new sample rate if it exists
-    if (player->equalizer && player->equalizer->sample_rate != sample_rate) {
-        printf("Reinitializing equalizer for new sample rate: %d Hz\n", sample_rate);
+    if (player->equalizer && player->equalizer->sample_rate != player->audio_spec.freq) {
+        printf("Reinitializing equalizer for new sample rate: %d Hz\n", player->audio_spec.freq);
         equalizer_free(player->equalizer);
-        player->equalizer = equalizer_new(sample_rate);
+        player->equalizer = equalizer_new(player->audio_spec.freq);
     }
     
     return true;
@@ -500,21 +663,12 @@ bool load_wav_file(AudioPlayer *player, const char* wav_path) {
         player->bits_per_sample = cached->bits_per_sample;
         player->song_duration = cached->song_duration;
         
-        if (!init_audio(player, player->sample_rate, player->channels)) {
+        if (!init_audio(player)) {
             return false;
         }
         
-        // COPY data from cache (don't give away the cached pointer)
-        int16_t *data_copy = malloc(cached->length * sizeof(int16_t));
-        if (!data_copy) return false;
-        memcpy(data_copy, cached->data, cached->length * sizeof(int16_t));
-        
-        pthread_mutex_lock(&player->audio_mutex);
-        if (player->audio_buffer.data) free(player->audio_buffer.data);
-        player->audio_buffer.data = data_copy;
-        player->audio_buffer.length = cached->length;
-        player->audio_buffer.position = 0;
-        pthread_mutex_unlock(&player->audio_mutex);
+        // Share the cached block, no copy
+        set_audio_source(player, pcm_block_ref(cached->block), NULL, cached->length);
         
         printf("Loaded from cache: %zu samples\n", cached->length);
         return true;
@@ -550,7 +704,7 @@ bool load_wav_file(AudioPlayer *player, const char* wav_path) {
     printf("WAV: %d Hz, %d channels, %d bits\n", player->sample_rate, player->channels, player->bits_per_sample);
     
     // Reinitialize audio with the correct sample rate and channels
-    if (!init_audio(player, player->sample_rate, player->channels)) {
+    if (!init_audio(player)) {
         printf("Failed to reinitialize audio for WAV format\n");
         fclose(wav_file);
         return false;
@@ -564,55 +718,198 @@ bool load_wav_file(AudioPlayer *player, const char* wav_path) {
     player->song_duration = data_size / (double)(player->sample_rate * player->channels * (player->bits_per_sample / 8));
     printf("WAV duration: %.2f seconds\n", player->song_duration);
     
-    // Allocate and read audio data
-    int16_t* wav_data = (int16_t*)malloc(data_size);
-    if (!wav_data) {
+    // Read audio data straight into a shareable block
+    size_t samples = data_size > 0 ? (size_t)data_size / sizeof(int16_t) : 0;
+    PCMBlock *block = pcm_block_create(samples);
+    if (!block) {
         printf("Memory allocation failed\n");
         fclose(wav_file);
         return false;
     }
     
     fseek(wav_file, 44, SEEK_SET);
-    if (fread(wav_data, 1, data_size, wav_file) != (size_t)data_size) {
+    if (fread(block->data, sizeof(int16_t), samples, wav_file) != samples) {
         printf("WAV data read failed\n");
-        free(wav_data);
+        pcm_block_unref(block);
         fclose(wav_file);
         return false;
     }
     
     fclose(wav_file);
+    pcm_block_seal(block);
     
-    // Make a copy for cache
-    int16_t *cache_copy = malloc(data_size);
-    if (cache_copy) {
-        memcpy(cache_copy, wav_data, data_size);
-        add_to_cache(&player->audio_cache, wav_path, cache_copy, 
-                     data_size / sizeof(int16_t), player->sample_rate,
-                     player->channels, player->bits_per_sample, 
-                     player->song_duration);
-    }
+    // The cache takes its own reference to the same block
+    add_to_cache(&player->audio_cache, wav_path, block,
+                 player->sample_rate, player->channels,
+                 player->bits_per_sample, player->song_duration);
     
     // Store in audio buffer
-    pthread_mutex_lock(&player->audio_mutex);
-    if (player->audio_buffer.data) free(player->audio_buffer.data);
-    player->audio_buffer.data = wav_data;
-    player->audio_buffer.length = data_size / sizeof(int16_t);
-    player->audio_buffer.position = 0;
-    pthread_mutex_unlock(&player->audio_mutex);
+    set_audio_source(player, block, NULL, block->length);
     
     printf("Loaded %zu samples\n", player->audio_buffer.length);
     return true;
 }
 
+bool has_audio_source(AudioPlayer *player) {
+    return player->audio_buffer.data != NULL || player->stream != NULL;
+}
+
+static void pause_audio_device(AudioPlayer *player, bool pause) {
+    SDL_PauseAudioDevice(player->audio_device, pause ? 1 : 0);
+    player->audio_device_paused = pause;
+}
+
+void post_audio_command(AudioPlayer *player, AudioCommandType type, size_t position, int ivalue, double dvalue) {
+    AudioCommand cmd = {};
+    cmd.type = type;
+    cmd.position = position;
+    cmd.ivalue = ivalue;
+    cmd.dvalue = dvalue;
+    
+    if (!audio_command_push(&player->audio_commands, &cmd)) {
+        printf("Audio command queue full, dropping command %d\n", type);
+        return;
+    }
+    
+    // While the device is paused or closed SDL won't run the callback, so apply
+    // the command here instead of letting the queue fill up
+    if (player->audio_device == 0 || player->audio_device_paused) {
+        process_audio_commands(player);
+    }
+}
+
+// Hand a new PCM block or stream to the audio callback. The caller's
+// reference to the block and ownership of the stream pass to the player; the
+// previous source comes back through retired_sources.
+void set_audio_source(AudioPlayer *player, PCMBlock *block, AudioStream *stream, size_t length) {
+    player->audio_buffer.block = block;
+    player->audio_buffer.data = block ? block->data : NULL;
+    player->audio_buffer.length = length;
+    player->audio_buffer.position.store(0);
+    player->stream = stream;
+    player->playback_ended.store(false);
+    
+    AudioCommand cmd = {};
+    cmd.type = AUDIO_CMD_SET_SOURCE;
+    cmd.length = length;
+    cmd.ivalue = player->channels;
+    cmd.sample_rate = player->sample_rate;
+    cmd.block = block;
+    cmd.stream = stream;
+    
+    if (!audio_command_push(&player->audio_commands, &cmd)) {
+        printf("Audio command queue full, cannot switch source\n");
+        pcm_block_unref(block);
+        if (stream) audio_stream_close(stream);
+        player->audio_buffer.block = NULL;
+        player->audio_buffer.data = NULL;
+        player->audio_buffer.length = 0;
+        player->stream = NULL;
+        return;
+    }
+    
+    if (player->audio_device == 0 || player->audio_device_paused) {
+        process_audio_commands(player);
+    }
+    collect_retired_audio(player);
+    update_resample_filter(player);
+}
+
+// Release sources the audio callback has finished with. A block still held
+// by the cache stays alive until the cache drops it too.
+void collect_retired_audio(AudioPlayer *player) {
+    AudioCommand cmd;
+    while (audio_command_pop(&player->retired_sources, &cmd)) {
+        pcm_block_unref(cmd.block);
+        if (cmd.stream) audio_stream_close(cmd.stream);
+        resample_filter_free(cmd.filter);
+    }
+}
+
+// The callback only swaps resampler filters in. Whenever the quality, the
+// source rate or the speed needs a different one, it is built here and
+// posted ahead of the next block.
+void update_resample_filter(AudioPlayer *player) {
+    int source_rate = player->sample_rate > 0 ? player->sample_rate : SAMPLE_RATE;
+    int device_rate = player->audio_spec.freq > 0 ? player->audio_spec.freq : SAMPLE_RATE;
+    double speed = player->playback_speed > 0.0 ? player->playback_speed : 1.0;
+    
+    // Same ratio the callback will use, see audio_callback()
+    double ratio = (double)source_rate / device_rate;
+    if (!(player->preserve_pitch && speed != 1.0)) ratio *= speed;
+    double cutoff = resampler_cutoff_for(ratio);
+    
+    if (player->resample_quality == player->posted_filter_quality &&
+        cutoff == player->posted_filter_cutoff) {
+        return;
+    }
+    
+    ResampleFilter *filter = resample_filter_new(player->resample_quality, cutoff);
+    if (!filter) return;
+    
+    AudioCommand cmd = {};
+    cmd.type = AUDIO_CMD_RESAMPLE_FILTER;
+    cmd.filter = filter;
+    if (!audio_command_push(&player->audio_commands, &cmd)) {
+        printf("Audio command queue full, keeping the current resampler filter\n");
+        resample_filter_free(filter);
+        return;
+    }
+    player->posted_filter_quality = player->resample_quality;
+    player->posted_filter_cutoff = cutoff;
+    
+    if (player->audio_device == 0 || player->audio_device_paused) {
+        process_audio_commands(player);
+    }
+    collect_retired_audio(player);
+}
+
+// Detach the current source. Once the device is closed this also frees it.
+void release_audio_source(AudioPlayer *player) {
+    set_audio_source(player, NULL, NULL, 0);
+}
+
+unsigned long get_audio_underrun_count(AudioPlayer *player) {
+    return player->underrun_count.load(std::memory_order_relaxed);
+}
+
+bool load_stream_file(AudioPlayer *player, const char* filename) {
+    AudioStream *stream = audio_stream_open(filename);
+    if (!stream) {
+        return false;
+    }
+    
+    player->sample_rate = stream->sample_rate;
+    player->channels = stream->channels;
+    player->bits_per_sample = 16;
+    player->song_duration = (double)stream->total_frames / stream->sample_rate;
+    
+    if (!init_audio(player)) {
+        audio_stream_close(stream);
+        return false;
+    }
+    
+    if (!audio_stream_start(stream) ||
+        !audio_stream_wait_prebuffer(stream, STREAM_PREBUFFER_MS, 2000)) {
+        printf("Failed to prebuffer stream: %s\n", filename);
+        audio_stream_close(stream);
+        return false;
+    }
+    
+    // The position/length bookkeeping stays in audio_buffer, only data is absent
+    set_audio_source(player, NULL, stream, (size_t)(stream->total_frames * stream->channels));
+    
+    printf("Streaming %.2f seconds from %s\n", player->song_duration, filename);
+    return true;
+}
+
 void on_speed_changed(GtkRange *range, gpointer user_data) {
     AudioPlayer *player = (AudioPlayer*)user_data;
     double speed = gtk_range_get_value(range);
     
-    pthread_mutex_lock(&player->audio_mutex);
     player->playback_speed = speed;
-    // Reset accumulator when speed changes to avoid glitches
-    player->speed_accumulator = 0.0;
-    pthread_mutex_unlock(&player->audio_mutex);
+    post_audio_command(player, AUDIO_CMD_SPEED, 0, 0, speed);
+    update_resample_filter(player);
     
     // Update the tooltip to show current speed
     char tooltip[64];
@@ -622,18 +919,90 @@ void on_speed_changed(GtkRange *range, gpointer user_data) {
     printf("Speed changed to: %.2fx\n", speed);
 }
 
+void on_preserve_pitch_toggled(GtkToggleButton *button, gpointer user_data) {
+    AudioPlayer *player = (AudioPlayer*)user_data;
+    player->preserve_pitch = gtk_toggle_button_get_active(button);
+    post_audio_command(player, AUDIO_CMD_PRESERVE_PITCH, 0, player->preserve_pitch ? 1 : 0);
+    update_resample_filter(player);
+    printf("Preserve pitch: %s\n", player->preserve_pitch ? "on" : "off");
+}
+
+
+// Formats decoded or rendered to PCM in one go. Their PCM is worth keeping
+// between loads and across restarts; plain WAV is already cheap to read.
+static bool is_converted_format(const char *ext_lower) {
+    static const char *formats[] = {
+        ".mid", ".midi", ".mp3", ".ogg", ".flac", ".aif", ".aiff", ".opus", ".m4a", ".wma"
+    };
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        if (strcmp(ext_lower, formats[i]) == 0) return true;
+    }
+    return false;
+}
+
+// Serve a converted file from the memory cache, then the disk cache
+static bool load_cached_pcm(AudioPlayer *player, const char *filename) {
+    PCMBlock *block = NULL;
+    CachedAudioBuffer *cached = find_in_cache(&player->audio_cache, filename);
+    
+    if (cached) {
+        player->sample_rate = cached->sample_rate;
+        player->channels = cached->channels;
+        player->bits_per_sample = cached->bits_per_sample;
+        player->song_duration = cached->song_duration;
+        block = pcm_block_ref(cached->block);
+    } else {
+        DiskCacheInfo info;
+        block = disk_cache_lookup(&player->disk_cache, filename, &info);
+        if (!block) return false;
+        
+        player->sample_rate = info.sample_rate;
+        player->channels = info.channels;
+        player->bits_per_sample = info.bits_per_sample;
+        player->song_duration = info.song_duration;
+        add_to_cache(&player->audio_cache, filename, block, info.sample_rate,
+                     info.channels, info.bits_per_sample, info.song_duration);
+    }
+    
+    if (!init_audio(player)) {
+        pcm_block_unref(block);
+        return false;
+    }
+    
+    set_audio_source(player, block, NULL, block->length);
+    printf("Loaded %s from PCM cache: %zu samples\n", filename, block->length);
+    return true;
+}
+
+// Keep the PCM a conversion just produced, in memory and on disk
+static void remember_converted_pcm(AudioPlayer *player, const char *filename) {
+    PCMBlock *block = player->audio_buffer.block;
+    if (!block || player->stream || player->bits_per_sample != 16) return;
+    
+    add_to_cache(&player->audio_cache, filename, block, player->sample_rate,
+                 player->channels, player->bits_per_sample, player->song_duration);
+    
+    DiskCacheInfo info;
+    info.sample_rate = player->sample_rate;
+    info.channels = player->channels;
+    info.bits_per_sample = player->bits_per_sample;
+    info.song_duration = player->song_duration;
+    disk_cache_store(&player->disk_cache, filename, block, &info);
+}
 
 bool load_file(AudioPlayer *player, const char *filename) {
     printf("load_file called for: %s\n", filename);
     
+    // A track the worker just finished is a cache hit below
+    collect_prefetched_audio(player);
+    
     // Stop current playback and clean up timer
     if (player->is_playing || player->update_timer_id > 0) {
         printf("Stopping current playback...\n");
-        pthread_mutex_lock(&player->audio_mutex);
         player->is_playing = false;
         player->is_paused = false;
-        SDL_PauseAudioDevice(player->audio_device, 1);
-        pthread_mutex_unlock(&player->audio_mutex);
+        pause_audio_device(player, true);
+        post_audio_command(player, AUDIO_CMD_PAUSE);
         
         if (player->update_timer_id > 0) {
             g_source_remove(player->update_timer_id);
@@ -672,13 +1041,19 @@ bool load_file(AudioPlayer *player, const char *filename) {
     
     bool success = false;
     bool is_zip_file = false;
+    bool converted = is_converted_format(ext_lower);
+    bool from_pcm_cache = converted && load_cached_pcm(player, filename);
     
-    if (strcmp(ext_lower, ".wav") == 0) {
+    if (from_pcm_cache) {
+        success = true;
+    } else if (strcmp(ext_lower, ".wav") == 0) {
         printf("Loading WAV file: %s\n", filename);
         success = load_wav_file(player, filename);
     } else if (strcmp(ext_lower, ".mid") == 0 || strcmp(ext_lower, ".midi") == 0) {
         printf("Loading MIDI file: %s\n", filename);
-        if (convert_midi_to_wav(player, filename)) {
+        if (load_stream_file(player, filename)) {
+            success = true;
+        } else if (convert_midi_to_wav(player, filename)) {
             printf("Now loading converted virtual WAV file: %s\n", player->temp_wav_file);
             success = load_virtual_wav_file(player, player->temp_wav_file);
         }
@@ -690,13 +1065,17 @@ bool load_file(AudioPlayer *player, const char *filename) {
         }
     } else if (strcmp(ext_lower, ".ogg") == 0) {
         printf("Loading OGG file: %s\n", filename);
-        if (convert_ogg_to_wav(player, filename)) {
+        if (load_stream_file(player, filename)) {
+            success = true;
+        } else if (convert_ogg_to_wav(player, filename)) {
             printf("Now loading converted virtual WAV file: %s\n", player->temp_wav_file);
             success = load_virtual_wav_file(player, player->temp_wav_file);
         }
     } else if (strcmp(ext_lower, ".flac") == 0) {
         printf("Loading FLAC file: %s\n", filename);
-        if (convert_flac_to_wav(player, filename)) {
+        if (load_stream_file(player, filename)) {
+            success = true;
+        } else if (convert_flac_to_wav(player, filename)) {
             printf("Now loading converted virtual WAV file: %s\n", player->temp_wav_file);
             success = load_virtual_wav_file(player, player->temp_wav_file);
         }
@@ -708,7 +1087,9 @@ bool load_file(AudioPlayer *player, const char *filename) {
         }
     } else if (strcmp(ext_lower, ".opus") == 0) {
         printf("Loading Opus file: %s\n", filename);
-        if (convert_opus_to_wav(player, filename)) {
+        if (load_stream_file(player, filename)) {
+            success = true;
+        } else if (convert_opus_to_wav(player, filename)) {
             printf("Now loading converted virtual WAV file: %s\n", player->temp_wav_file);
             success = load_virtual_wav_file(player, player->temp_wav_file);
         }
@@ -829,6 +1210,10 @@ bool load_file(AudioPlayer *player, const char *filename) {
         }
     }
     
+    if (success && converted && !from_pcm_cache) {
+        remember_converted_pcm(player, filename);
+    }
+    
     if (success && !is_zip_file) {
         strncpy(player->current_file, filename, 1023);
         player->current_file[1023] = '\0';
@@ -932,6 +1317,76 @@ bool load_file(AudioPlayer *player, const char *filename) {
     return success;
 }
 
+// Same test next_song_filtered() applies to each candidate, but only with
+// tags the metadata index already holds: this runs on the GUI thread, which
+// must not wait for TagLib. A file the scanner hasn't reached yet can only
+// match on its name, which at worst costs a prefetch.
+static bool queue_file_matches_filter(AudioPlayer *player, const char *path, const char *filter) {
+    char *basename = g_path_get_basename(path);
+    bool matches = matches_filter(basename, filter);
+    g_free(basename);
+    
+    TrackMetadata meta;
+    if (!matches && metadata_index_peek(&player->metadata_index, path, &meta)) {
+        matches = matches_filter(meta.title, filter) ||
+                  matches_filter(meta.artist, filter) ||
+                  matches_filter(meta.album, filter) ||
+                  matches_filter(meta.genre, filter);
+    }
+    return matches;
+}
+
+// Hand the next PREFETCH_AHEAD entries next_song_filtered() would play to
+// the prefetch worker. Past the end of the queue only with repeat on, and
+// only as much as the audio cache can hold next to the current track.
+void schedule_prefetch(AudioPlayer *player) {
+    PlayQueue *queue = &player->queue;
+    const char *filter = player->queue_filter_text;
+    bool has_filter = (filter && filter[0] != '\0');
+    
+    const char *paths[PREFETCH_AHEAD];
+    int path_count = 0;
+    int upcoming = 0;
+    
+    for (int step = 1; step < queue->count && upcoming < PREFETCH_AHEAD; step++) {
+        int index = queue->current_index + step;
+        if (index >= queue->count) {
+            if (!queue->repeat_queue) break;
+            index -= queue->count;
+        }
+        
+        const char *path = queue->files[index];
+        if (has_filter && !queue_file_matches_filter(player, path, filter)) continue;
+        upcoming++;
+        
+        if (prefetch_can_decode(path) && !audio_cache_contains(&player->audio_cache, path)) {
+            paths[path_count++] = path;
+        }
+    }
+    
+    size_t in_use = player->audio_buffer.block ? player->audio_buffer.block->mapped_size : 0;
+    size_t budget = player->audio_cache.max_memory > in_use ? player->audio_cache.max_memory - in_use : 0;
+    
+    if (path_count > 0 && budget > 0) {
+        prefetch_schedule(&player->prefetch, paths, path_count, budget);
+    } else {
+        prefetch_cancel(&player->prefetch);
+    }
+}
+
+// Move finished prefetches into the audio cache. add_to_cache() never evicts
+// a block the player holds, so the current track stays put.
+void collect_prefetched_audio(AudioPlayer *player) {
+    PrefetchResult result;
+    while (prefetch_take_result(&player->prefetch, &result)) {
+        add_to_cache(&player->audio_cache, result.path, result.block,
+                     result.info.sample_rate, result.info.channels,
+                     result.info.bits_per_sample, result.info.song_duration);
+        pcm_block_unref(result.block);
+        free(result.path);
+    }
+}
+
 bool load_file_from_queue(AudioPlayer *player) {
     const char *filename = get_current_queue_file(&player->queue);
     if (!filename) return false;
@@ -955,11 +1410,12 @@ bool load_file_from_queue(AudioPlayer *player) {
         return false;
     }
     
+    schedule_prefetch(player);
     return true;
 }
 
 void seek_to_position(AudioPlayer *player, double position_seconds) {
-    if (!player->is_loaded || !player->audio_buffer.data || player->song_duration <= 0) {
+    if (!player->is_loaded || !has_audio_source(player) || player->song_duration <= 0) {
         return;
     }
     
@@ -967,8 +1423,6 @@ void seek_to_position(AudioPlayer *player, double position_seconds) {
     if (position_seconds < 0) position_seconds = 0;
     if (position_seconds > player->song_duration) position_seconds = player->song_duration;
     
-    pthread_mutex_lock(&player->audio_mutex);
-    
     // Calculate the sample position based on the time position
     double samples_per_second = (double)(player->sample_rate * player->channels);
     size_t new_position = (size_t)(position_seconds * samples_per_second);
@@ -978,70 +1432,75 @@ void seek_to_position(AudioPlayer *player, double position_seconds) {
         new_position = player->audio_buffer.length - 1;
     }
     
-    player->audio_buffer.position = new_position;
-    playTime = position_seconds;
+    // Keep the position on a frame boundary so channels stay in order
+    new_position -= new_position % player->channels;
     
-    pthread_mutex_unlock(&player->audio_mutex);
+    player->playback_ended.store(false);
+    player->audio_buffer.position.store(new_position);
+    post_audio_command(player, AUDIO_CMD_SEEK, new_position);
+    playTime = position_seconds;
 }
 
 void start_playback(AudioPlayer *player) {
-    if (!player->is_loaded || !player->audio_buffer.data) {
+    if (!player->is_loaded || !has_audio_source(player)) {
         printf("Cannot start playback - no audio data loaded\n");
         return;
     }
     
     printf("Starting WAV playback\n");
     
-    pthread_mutex_lock(&player->audio_mutex);
     // If we're at the end, restart from beginning
-    if (player->audio_buffer.position >= player->audio_buffer.length) {
-        player->audio_buffer.position = 0;
+    if (player->playback_ended.load() ||
+        player->audio_buffer.position.load() >= player->audio_buffer.length) {
+        player->playback_ended.store(false);
+        player->audio_buffer.position.store(0);
+        post_audio_command(player, AUDIO_CMD_SEEK, 0);
         playTime = 0;
     }
     player->is_playing = true;
     player->is_paused = false;
-    pthread_mutex_unlock(&player->audio_mutex);
+    post_audio_command(player, AUDIO_CMD_PLAY);
     
     // Prevent system sleep during playback
     prevent_system_sleep();
     
-    SDL_PauseAudioDevice(player->audio_device, 0);
+    pause_audio_device(player, false);
     
     if (player->update_timer_id == 0) {
         player->update_timer_id = g_timeout_add(100, (GSourceFunc)([](gpointer data) -> gboolean {
             AudioPlayer *p = (AudioPlayer*)data;
             
-            pthread_mutex_lock(&p->audio_mutex);
             bool song_finished = false;
             bool currently_playing = p->is_playing;
+            size_t position = p->audio_buffer.position.load();
             
-            // Check if song has finished
-            if (p->audio_buffer.data && p->audio_buffer.length > 0) {
-                // Song finished if we've reached the end of the buffer
-                if (p->audio_buffer.position >= p->audio_buffer.length) {
-                    if (currently_playing) {
-                        p->is_playing = false;
-                        currently_playing = false;
-                    }
-                    song_finished = true;
-                    printf("Song finished - reached end of buffer (pos: %zu, len: %zu)\n", 
-                           p->audio_buffer.position, p->audio_buffer.length);
-                }
-                // Also check if is_playing was set to false by audio callback
-                else if (!currently_playing && p->audio_buffer.position > 0) {
-                    song_finished = true;
-                    printf("Song finished - detected by audio callback\n");
+            // Free buffers the audio callback has let go of
+            collect_retired_audio(p);
+            collect_prefetched_audio(p);
+            
+            // Check if song has finished (flagged by the audio callback)
+            if (has_audio_source(p) && p->audio_buffer.length > 0 && p->playback_ended.load()) {
+                if (currently_playing) {
+                    p->is_playing = false;
+                    currently_playing = false;
                 }
+                song_finished = true;
+                printf("Song finished - reached end of buffer (pos: %zu, len: %zu)\n", 
+                       position, p->audio_buffer.length);
+            }
+            
+            unsigned long underruns = get_audio_underrun_count(p);
+            if (underruns != p->reported_underruns) {
+                printf("Audio underruns: %lu\n", underruns);
+                p->reported_underruns = underruns;
             }
             
             // Update playback position if playing
-            if (currently_playing && p->audio_buffer.data && p->sample_rate > 0 && p->channels > 0) {
+            if (currently_playing && has_audio_source(p) && p->sample_rate > 0 && p->channels > 0) {
                 double samples_per_second = (double)(p->sample_rate * p->channels);
-                playTime = (double)p->audio_buffer.position / samples_per_second;
+                playTime = (double)position / samples_per_second;
             }
             
-            pthread_mutex_unlock(&p->audio_mutex);
-            
             // Handle song completion
             if (song_finished && p->queue.count > 0) {
                 printf("Song completed. Calling next_song()...\n");
@@ -1127,15 +1586,15 @@ bool remove_from_queue(PlayQueue *queue, int index) {
 void toggle_pause(AudioPlayer *player) {
     if (!player->is_playing) return;
     
-    pthread_mutex_lock(&player->audio_mutex);
     player->is_paused = !player->is_paused;
     
     if (player->is_paused) {
-        SDL_PauseAudioDevice(player->audio_device, 1);
+        post_audio_command(player, AUDIO_CMD_PAUSE);
+        pause_audio_device(player, true);
     } else {
-        SDL_PauseAudioDevice(player->audio_device, 0);
+        post_audio_command(player, AUDIO_CMD_PLAY);
+        pause_audio_device(player, false);
     }
-    pthread_mutex_unlock(&player->audio_mutex);
     
     gtk_button_set_label(GTK_BUTTON(player->pause_button), player->is_paused ? "⏯" : "⏸");
 }
@@ -1250,17 +1709,16 @@ void cleanup_vis_fullscreen() {
 }
 
 void stop_playback(AudioPlayer *player) {
-    pthread_mutex_lock(&player->audio_mutex);
     player->is_playing = false;
     player->is_paused = false;
-    player->audio_buffer.position = 0;
     playTime = 0;
-    pthread_mutex_unlock(&player->audio_mutex);
     
     // Allow system to sleep when playback stops
     allow_system_sleep();
     
-    SDL_PauseAudioDevice(player->audio_device, 1);
+    pause_audio_device(player, true);
+    post_audio_command(player, AUDIO_CMD_STOP);
+    player->audio_buffer.position.store(0);
     
     if (player->update_timer_id > 0) {
         g_source_remove(player->update_timer_id);
@@ -1971,14 +2429,26 @@ void on_add_to_queue_clicked(GtkButton *button, gpointer user_data) {
         GSList *filenames = gtk_file_chooser_get_filenames(GTK_FILE_CHOOSER(dialog));
         
         bool was_empty_queue = (player->queue.count == 0);
-        
+
+        // Same check as filename_exists_in_queue(), without walking the
+        // whole queue again for every file of a large selection
+        GHashTable *queued_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        for (int i = 0; i < player->queue.count; i++) {
+            g_hash_table_add(queued_names, g_path_get_basename(player->queue.files[i]));
+        }
+
         for (GSList *iter = filenames; iter != NULL; iter = g_slist_next(iter)) {
             char *filename = (char*)iter->data;
-            if (!filename_exists_in_queue(&player->queue, filename)) {
+            char *basename = g_path_get_basename(filename);
+            if (!g_hash_table_contains(queued_names, basename)) {
                 add_to_queue(&player->queue, filename);
+                g_hash_table_add(queued_names, basename);
+            } else {
+                g_free(basename);
             }
             g_free(filename);
         }
+        g_hash_table_destroy(queued_names);
         
         g_slist_free(filenames);
         
@@ -2427,9 +2897,9 @@ void on_previous_clicked(GtkButton *button, gpointer user_data) {
 }
 
 void on_volume_changed(GtkRange *range, gpointer user_data) {
-    (void)user_data;
     double value = gtk_range_get_value(range);
     globalVolume = (int)(value * 100);
+    post_audio_command((AudioPlayer*)user_data, AUDIO_CMD_VOLUME, 0, globalVolume);
 }
 
 void on_window_destroy(GtkWidget *widget, gpointer user_data) {
@@ -2453,20 +2923,28 @@ gboolean on_window_delete_event(GtkWidget *widget, GdkEvent *event, gpointer use
     stop_playback(player);
     clear_queue(&player->queue);
     cleanup_queue_filter(player);
+    prefetch_shutdown(&player->prefetch);
+    metadata_scanner_shutdown(&player->metadata_scanner);
     cleanup_conversion_cache(&player->conversion_cache);
     cleanup_audio_cache(&player->audio_cache); 
+    disk_cache_free(&player->disk_cache);
+    metadata_index_free(&player->metadata_index);
     cleanup_virtual_filesystem();
     
+    printf("Closing  SDL 1\n");
+    if (player->audio_device) SDL_CloseAudioDevice(player->audio_device);
+    player->audio_device = 0;
+
+    // With the device closed the source is freed right away
     printf("Cleaing up Audio\n");
-    if (player->audio_buffer.data) free(player->audio_buffer.data);
+    release_audio_source(player);
+    resampler_free(&player->rt.resampler);
+    time_stretch_free(&player->rt.stretch);
 
     if (player->cdg_display) {
         cdg_display_free(player->cdg_display);
     }    
 
-    printf("Closing  SDL 1\n");
-    if (player->audio_device) SDL_CloseAudioDevice(player->audio_device);
-
     printf("Cleaning Equalizer\n");
     if (player->equalizer) {
         equalizer_free(player->equalizer);
@@ -2862,6 +3340,11 @@ bool save_player_settings(AudioPlayer *player) {
     fprintf(f, "# Zenamp Settings\n");
     fprintf(f, "volume=%.2f\n", volume);
     fprintf(f, "speed=%.2f\n", player->playback_speed);
+    fprintf(f, "preserve_pitch=%d\n", player->preserve_pitch ? 1 : 0);
+    fprintf(f, "resample_quality=%d\n", (int)player->resample_quality);
+    fprintf(f, "disk_cache=%d\n", player->disk_cache.enabled ? 1 : 0);
+    fprintf(f, "disk_cache_mb=%zu\n", player->disk_cache.max_bytes / (1024 * 1024));
+    fprintf(f, "opl_chips=%d\n", opl_get_chip_count());
     
     // Equalizer settings
     if (player->equalizer) {
@@ -2898,6 +3381,11 @@ bool load_player_settings(AudioPlayer *player) {
     char line[256];
     double volume = 1.0;
     double speed = 1.0;
+    int preserve_pitch = 0;
+    int resample_quality = RESAMPLE_QUALITY_MEDIUM;
+    int disk_cache = 1;
+    int disk_cache_mb = DISK_CACHE_DEFAULT_MB;
+    int opl_chips = OPL_DEFAULT_CHIPS;
     bool eq_enabled = false;
     float bass_gain = 0.0f;
     float mid_gain = 0.0f;
@@ -2916,6 +3404,21 @@ bool load_player_settings(AudioPlayer *player) {
         else if (sscanf(line, "speed=%lf", &speed) == 1) {
             printf("Loaded speed: %.2f\n", speed);
         }
+        else if (sscanf(line, "preserve_pitch=%d", &preserve_pitch) == 1) {
+            printf("Loaded preserve_pitch: %d\n", preserve_pitch);
+        }
+        else if (sscanf(line, "resample_quality=%d", &resample_quality) == 1) {
+            printf("Loaded resample_quality: %d\n", resample_quality);
+        }
+        else if (sscanf(line, "disk_cache=%d", &disk_cache) == 1) {
+            printf("Loaded disk_cache: %d\n", disk_cache);
+        }
+        else if (sscanf(line, "disk_cache_mb=%d", &disk_cache_mb) == 1) {
+            printf("Loaded disk_cache_mb: %d\n", disk_cache_mb);
+        }
+        else if (sscanf(line, "opl_chips=%d", &opl_chips) == 1) {
+            printf("Loaded opl_chips: %d\n", opl_chips);
+        }
         else if (sscanf(line, "eq_enabled=%d", (int*)&eq_enabled) == 1) {
             printf("Loaded eq_enabled: %d\n", eq_enabled);
         }
@@ -2943,11 +3446,34 @@ bool load_player_settings(AudioPlayer *player) {
     // Volume
     gtk_range_set_value(GTK_RANGE(player->volume_scale), volume);
     globalVolume = (int)(volume * 100);
+    post_audio_command(player, AUDIO_CMD_VOLUME, 0, globalVolume);
     
     // Speed
     player->playback_speed = speed;
+    post_audio_command(player, AUDIO_CMD_SPEED, 0, 0, speed);
     gtk_range_set_value(GTK_RANGE(player->speed_scale), speed);
     
+    // Resampling
+    if (resample_quality < RESAMPLE_QUALITY_FAST || resample_quality > RESAMPLE_QUALITY_BEST) {
+        resample_quality = RESAMPLE_QUALITY_MEDIUM;
+    }
+    player->resample_quality = (ResampleQuality)resample_quality;
+    player->preserve_pitch = preserve_pitch != 0;
+    post_audio_command(player, AUDIO_CMD_PRESERVE_PITCH, 0, preserve_pitch != 0);
+    update_resample_filter(player);
+    if (player->preserve_pitch_check) {
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(player->preserve_pitch_check), player->preserve_pitch);
+    }
+    
+    // Decoded PCM kept on disk
+    disk_cache_set_enabled(&player->disk_cache, disk_cache != 0);
+    if (disk_cache_mb > 0) {
+        disk_cache_set_limit(&player->disk_cache, (size_t)disk_cache_mb);
+    }
+    
+    // MIDI synthesis, used by every synth set up from here on
+    opl_set_chip_count(opl_chips);
+    
     // Equalizer
     if (player->equalizer) {
         player->equalizer->enabled = eq_enabled;
@@ -3321,6 +3847,13 @@ void cleanup_windows_single_instance(AudioPlayer *player) {
 
 
 int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--benchmark-eq") == 0) {
+        return equalizer_benchmark();
+    }
+    if (argc > 1 && strcmp(argv[1], "--benchmark-resampler") == 0) {
+        return resampler_benchmark();
+    }
+    
     gtk_init(&argc, &argv);
     
 #ifndef _WIN32
@@ -3420,22 +3953,43 @@ int main(int argc, char *argv[]) {
     init_virtual_filesystem();
     
     player = (AudioPlayer*)g_malloc0(sizeof(AudioPlayer));
-    pthread_mutex_init(&player->audio_mutex, NULL);
     player->playback_speed = 1.0; 
-    player->speed_accumulator = 0.0;    
+    player->rt.speed = 1.0;
+    player->rt.volume = globalVolume;
+    player->rt.channels = AUDIO_CHANNELS;
+    player->rt.sample_rate = SAMPLE_RATE;
+    player->resample_quality = RESAMPLE_QUALITY_MEDIUM;
+    
+    // Conversion chain for the callback, allocated once up front
+    if (!resampler_init(&player->rt.resampler, AUDIO_CHANNELS, player->resample_quality) ||
+        !time_stretch_init(&player->rt.stretch, AUDIO_CHANNELS, read_source_frames, player)) {
+        printf("Failed to initialize resampler\n");
+        return 1;
+    }
+    player->posted_filter_quality = player->resample_quality;
+    player->posted_filter_cutoff = 1.0;
     
     init_queue(&player->queue);
     init_conversion_cache(&player->conversion_cache);
     init_audio_cache(&player->audio_cache, 500);
+    disk_cache_init(&player->disk_cache, DISK_CACHE_DEFAULT_MB);
+    metadata_index_init(&player->metadata_index);
+    metadata_scanner_init(&player->metadata_scanner, &player->metadata_index,
+                          on_queue_metadata_scanned, player);
+    prefetch_init(&player->prefetch, &player->disk_cache);
    
     if (!init_audio(player)) {
         printf("Audio initialization failed\n");
+        prefetch_shutdown(&player->prefetch);
+        metadata_scanner_shutdown(&player->metadata_scanner);
         cleanup_conversion_cache(&player->conversion_cache);
+        disk_cache_free(&player->disk_cache);
+        metadata_index_free(&player->metadata_index);
         cleanup_virtual_filesystem();
         return 1;
     }
     
-    player->equalizer = equalizer_new(SAMPLE_RATE);
+    player->equalizer = equalizer_new(player->audio_spec.freq);
     if (!player->equalizer) {
         printf("Failed to initialize equalizer\n");
     }
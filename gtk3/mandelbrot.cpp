@@ -5,51 +5,286 @@
 #include <string.h>
 #include <pthread.h>
 
-// Global mutex for thread-safe access
-static pthread_mutex_t mandelbrot_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-// Thread worker data
-typedef struct {
-    MandelbrotState *mb;
-    int width;
-    int height;
-    int start_y;
-    int end_y;
-    double center_x;
-    double center_y;
-    double zoom;
-    int max_iterations;
-} MandelbrotWorkerData;
-
-// Worker thread function
-void* mandelbrot_worker_thread(void *arg) {
-    MandelbrotWorkerData *data = (MandelbrotWorkerData *)arg;
-    MandelbrotState *mb = data->mb;
-    
-    // Calculate iterations for assigned rows
-    for (int y = data->start_y; y < data->end_y; y++) {
-        for (int x = 0; x < data->width; x++) {
-            double norm_x = (double)x / data->width;
-            double norm_y = (double)y / data->height;
-            
-            int adjusted_iterations = data->max_iterations;
-            if (data->width >= 1920) {
-                adjusted_iterations = (int)(data->max_iterations * 0.7);
-            } else if (data->width >= 1024) {
-                adjusted_iterations = (int)(data->max_iterations * 0.9);
-            }
-            
-            int iterations = mandelbrot_calculate_iterations(
-                norm_x, norm_y, data->center_x, data->center_y, data->zoom, adjusted_iterations, data->width, data->height
-            );
-            
-            mb->iteration_data[y * data->width + x] = iterations;
+#include <mutex>
+
+// Escape-time kernels are picked at runtime; build with MANDELBROT_NO_SIMD
+// to keep only the scalar one
+#if !defined(MANDELBROT_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MANDELBROT_SIMD 1
+#include <immintrin.h>
+#endif
+
+// Iteration counts for count points of one row, c = c_real[i] + c_imag i
+typedef void (*MandelbrotKernel)(uint16_t *out, const double *c_real, int count,
+                                 double c_imag, int max_iterations);
+
+// Inside the main cardioid or the period-2 bulb, where nothing escapes and
+// iterating would only run to max_iterations
+static inline bool in_main_bulbs(double c_real, double c_imag) {
+    double x = c_real - 0.25;
+    double y2 = c_imag * c_imag;
+    double q = x * x + y2;
+    if (q * (q + x) <= 0.25 * y2) return true;
+    double x2 = c_real + 1.0;
+    return x2 * x2 + y2 <= 0.0625;
+}
+
+static inline int escape_count(double c_real, double c_imag, int max_iterations) {
+    if (in_main_bulbs(c_real, c_imag)) return max_iterations;
+
+    double z_real = 0.0;
+    double z_imag = 0.0;
+    for (int n = 0; n < max_iterations; n++) {
+        double real_sq = z_real * z_real;
+        double imag_sq = z_imag * z_imag;
+        if (real_sq + imag_sq > 4.0) return n;
+        z_imag = 2.0 * z_real * z_imag + c_imag;
+        z_real = real_sq - imag_sq + c_real;
+    }
+    return max_iterations;
+}
+
+static void escape_row_scalar(uint16_t *out, const double *c_real, int count,
+                              double c_imag, int max_iterations) {
+    for (int i = 0; i < count; i++) {
+        out[i] = (uint16_t)escape_count(c_real[i], c_imag, max_iterations);
+    }
+}
+
+// Whether a whole group of points can skip iterating
+static inline bool group_in_main_bulbs(const double *c_real, int count, double c_imag) {
+    for (int i = 0; i < count; i++) {
+        if (!in_main_bulbs(c_real[i], c_imag)) return false;
+    }
+    return true;
+}
+
+#ifdef MANDELBROT_SIMD
+// Two vectors of two points each, iterated together until every lane has
+// escaped. A lane stops counting at its first escape and never restarts,
+// so every lane gets the same count as escape_count() would.
+__attribute__((target("sse2")))
+static void escape_row_sse2(uint16_t *out, const double *c_real, int count,
+                            double c_imag, int max_iterations) {
+    const __m128d four = _mm_set1_pd(4.0);
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d ci = _mm_set1_pd(c_imag);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        if (group_in_main_bulbs(c_real + i, 4, c_imag)) {
+            for (int k = 0; k < 4; k++) out[i + k] = (uint16_t)max_iterations;
+            continue;
+        }
+        __m128d cr0 = _mm_loadu_pd(c_real + i);
+        __m128d cr1 = _mm_loadu_pd(c_real + i + 2);
+        __m128d zr0 = _mm_setzero_pd(), zi0 = _mm_setzero_pd(), n0 = _mm_setzero_pd();
+        __m128d zr1 = _mm_setzero_pd(), zi1 = _mm_setzero_pd(), n1 = _mm_setzero_pd();
+        __m128d active0 = _mm_castsi128_pd(_mm_set1_epi32(-1));
+        __m128d active1 = active0;
+        for (int n = 0; n < max_iterations; n++) {
+            __m128d rs0 = _mm_mul_pd(zr0, zr0), is0 = _mm_mul_pd(zi0, zi0);
+            __m128d rs1 = _mm_mul_pd(zr1, zr1), is1 = _mm_mul_pd(zi1, zi1);
+            active0 = _mm_and_pd(active0, _mm_cmple_pd(_mm_add_pd(rs0, is0), four));
+            active1 = _mm_and_pd(active1, _mm_cmple_pd(_mm_add_pd(rs1, is1), four));
+            if (_mm_movemask_pd(_mm_or_pd(active0, active1)) == 0) break;
+            n0 = _mm_add_pd(n0, _mm_and_pd(active0, one));
+            n1 = _mm_add_pd(n1, _mm_and_pd(active1, one));
+            zi0 = _mm_add_pd(_mm_mul_pd(_mm_add_pd(zr0, zr0), zi0), ci);
+            zi1 = _mm_add_pd(_mm_mul_pd(_mm_add_pd(zr1, zr1), zi1), ci);
+            zr0 = _mm_add_pd(_mm_sub_pd(rs0, is0), cr0);
+            zr1 = _mm_add_pd(_mm_sub_pd(rs1, is1), cr1);
         }
+        double counts[4];
+        _mm_storeu_pd(counts, n0);
+        _mm_storeu_pd(counts + 2, n1);
+        for (int k = 0; k < 4; k++) out[i + k] = (uint16_t)counts[k];
     }
-    
-    free(data);
+    escape_row_scalar(out + i, c_real + i, count - i, c_imag, max_iterations);
+}
+
+// Same with two vectors of four points. Only AVX instructions are needed
+// for doubles, so this runs on AVX machines without AVX2 as well.
+__attribute__((target("avx")))
+static void escape_row_avx(uint16_t *out, const double *c_real, int count,
+                           double c_imag, int max_iterations) {
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d ci = _mm256_set1_pd(c_imag);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        if (group_in_main_bulbs(c_real + i, 8, c_imag)) {
+            for (int k = 0; k < 8; k++) out[i + k] = (uint16_t)max_iterations;
+            continue;
+        }
+        __m256d cr0 = _mm256_loadu_pd(c_real + i);
+        __m256d cr1 = _mm256_loadu_pd(c_real + i + 4);
+        __m256d zr0 = _mm256_setzero_pd(), zi0 = _mm256_setzero_pd(), n0 = _mm256_setzero_pd();
+        __m256d zr1 = _mm256_setzero_pd(), zi1 = _mm256_setzero_pd(), n1 = _mm256_setzero_pd();
+        __m256d active0 = _mm256_castsi256_pd(_mm256_set1_epi32(-1));
+        __m256d active1 = active0;
+        for (int n = 0; n < max_iterations; n++) {
+            __m256d rs0 = _mm256_mul_pd(zr0, zr0), is0 = _mm256_mul_pd(zi0, zi0);
+            __m256d rs1 = _mm256_mul_pd(zr1, zr1), is1 = _mm256_mul_pd(zi1, zi1);
+            active0 = _mm256_and_pd(active0, _mm256_cmp_pd(_mm256_add_pd(rs0, is0), four, _CMP_LE_OQ));
+            active1 = _mm256_and_pd(active1, _mm256_cmp_pd(_mm256_add_pd(rs1, is1), four, _CMP_LE_OQ));
+            if (_mm256_movemask_pd(_mm256_or_pd(active0, active1)) == 0) break;
+            n0 = _mm256_add_pd(n0, _mm256_and_pd(active0, one));
+            n1 = _mm256_add_pd(n1, _mm256_and_pd(active1, one));
+            zi0 = _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(zr0, zr0), zi0), ci);
+            zi1 = _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(zr1, zr1), zi1), ci);
+            zr0 = _mm256_add_pd(_mm256_sub_pd(rs0, is0), cr0);
+            zr1 = _mm256_add_pd(_mm256_sub_pd(rs1, is1), cr1);
+        }
+        double counts[8];
+        _mm256_storeu_pd(counts, n0);
+        _mm256_storeu_pd(counts + 4, n1);
+        for (int k = 0; k < 8; k++) out[i + k] = (uint16_t)counts[k];
+    }
+    escape_row_sse2(out + i, c_real + i, count - i, c_imag, max_iterations);
+}
+#endif
+
+static MandelbrotKernel escape_kernel = escape_row_scalar;
+static const char *escape_kernel_name = "scalar";
+
+static void select_escape_kernel(void) {
+#ifdef MANDELBROT_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx")) {
+        escape_kernel = escape_row_avx;
+        escape_kernel_name = "avx";
+    } else if (__builtin_cpu_supports("sse2")) {
+        escape_kernel = escape_row_sse2;
+        escape_kernel_name = "sse2";
+    }
+#endif
+}
+
+// The points of one tile that belong to pass. They are placed exactly as
+// mandelbrot_calculate_iterations() places them.
+static void compute_tile(const MandelbrotJob *job, int pass, int tile_x, int tile_y) {
+    double aspect_ratio = (double)job->width / (double)job->height;
+    double viewport_height = 2.5 / job->zoom;
+    double viewport_width = viewport_height * aspect_ratio;
+
+    int step = MANDELBROT_COARSE_STEP >> pass;
+    int x0 = tile_x * MANDELBROT_TILE_SIZE;
+    int y0 = tile_y * MANDELBROT_TILE_SIZE;
+    int x1 = MIN(x0 + MANDELBROT_TILE_SIZE, job->width);
+    int y1 = MIN(y0 + MANDELBROT_TILE_SIZE, job->height);
+
+    double c_real[MANDELBROT_TILE_SIZE];
+    uint16_t counts[MANDELBROT_TILE_SIZE];
+    for (int y = y0; y < y1; y += step) {
+        // On rows of the previous pass's grid every other point is done
+        bool done_row = pass > 0 && y % (2 * step) == 0;
+        int first = done_row ? x0 + step : x0;
+        int stride = done_row ? 2 * step : step;
+
+        int count = 0;
+        for (int x = first; x < x1; x += stride) {
+            double norm_x = (double)x / job->width;
+            c_real[count++] = job->center_x + (norm_x - 0.5) * viewport_width;
+        }
+        double norm_y = (double)y / job->height;
+        double c_imag = job->center_y + (norm_y - 0.5) * viewport_height;
+        escape_kernel(counts, c_real, count, c_imag, job->max_iterations);
+
+        uint16_t *out = job->out + (size_t)y * job->width + first;
+        for (int i = 0; i < count; i++) {
+            out[i * stride] = counts[i];
+        }
+    }
+}
+
+static void* mandelbrot_worker_thread(void *arg) {
+    MandelbrotPool *pool = (MandelbrotPool *)arg;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop) {
+        if (pool->next_tile >= pool->tile_count) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+            continue;
+        }
+
+        int tile = pool->next_tile++;
+        int pass = tile / pool->pass_tiles;
+        tile %= pool->pass_tiles;
+        MandelbrotJob job = pool->job;
+        int tiles_x = pool->tiles_x;
+        pthread_mutex_unlock(&pool->lock);
+
+        compute_tile(&job, pass, tile % tiles_x, tile / tiles_x);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->pass_left[pass]--;
+    }
+    pthread_mutex_unlock(&pool->lock);
     return NULL;
 }
+
+static std::once_flag kernel_once;
+
+static gboolean mandelbrot_pool_start(MandelbrotPool *pool) {
+    std::call_once(kernel_once, select_escape_kernel);
+
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+
+    // Leave one core for the GUI and audio threads
+    int wanted = (int)g_get_num_processors() - 1;
+    if (wanted < 1) wanted = 1;
+    if (wanted > MANDELBROT_MAX_THREADS) wanted = MANDELBROT_MAX_THREADS;
+    for (int t = 0; t < wanted; t++) {
+        if (pthread_create(&pool->threads[t], NULL, mandelbrot_worker_thread, pool) != 0) break;
+        pool->thread_count++;
+    }
+
+    printf("Mandelbrot: %d worker threads, %s kernel\n", pool->thread_count, escape_kernel_name);
+    return pool->thread_count > 0;
+}
+
+static void mandelbrot_pool_stop(MandelbrotPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = TRUE;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int t = 0; t < pool->thread_count; t++) {
+        pthread_join(pool->threads[t], NULL);
+    }
+    pool->thread_count = 0;
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+}
+
+static void mandelbrot_pool_submit(MandelbrotPool *pool, const MandelbrotJob *job) {
+    pthread_mutex_lock(&pool->lock);
+    pool->job = *job;
+    pool->tiles_x = (job->width + MANDELBROT_TILE_SIZE - 1) / MANDELBROT_TILE_SIZE;
+    int tiles_y = (job->height + MANDELBROT_TILE_SIZE - 1) / MANDELBROT_TILE_SIZE;
+    pool->pass_tiles = pool->tiles_x * tiles_y;
+    pool->tile_count = pool->pass_tiles * MANDELBROT_PASSES;
+    pool->next_tile = 0;
+    for (int pass = 0; pass < MANDELBROT_PASSES; pass++) {
+        pool->pass_left[pass] = pool->pass_tiles;
+    }
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Passes of the current job finished so far, MANDELBROT_PASSES once it's done
+static int mandelbrot_pool_passes_done(MandelbrotPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    int passes = 0;
+    while (passes < MANDELBROT_PASSES && pool->pass_left[passes] == 0) {
+        passes++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return passes;
+}
+
 // Note: this function now takes width/height to properly scale the viewport
 int mandelbrot_calculate_iterations(double real, double imag, double center_x, double center_y, 
                                    double zoom, int max_iterations, int width, int height) {
@@ -123,44 +358,149 @@ void mandelbrot_get_color(int iterations, int max_iterations, double hue_offset,
     }
 }
 
-// Recalculate the iteration data for the visible region
+// Start computing the visible region in the background. The frame on
+// screen stays until draw_mandelbrot() finds the new one far enough along.
 void mandelbrot_recalculate_region(void *vis_ptr, int width, int height) {
     Visualizer *vis = (Visualizer *)vis_ptr;
     MandelbrotState *mb = &vis->mandelbrot;
     
-    if (!mb || width <= 0 || height <= 0) return;
-    if (width * height > MANDELBROT_DATA_SIZE) return;  // Safety check
-    
-    mb->data_width = width;
-    mb->data_height = height;
-    
-    // Determine number of threads (use 4 threads for good balance)
-    int num_threads = 4;
-    pthread_t threads[num_threads];
-    int rows_per_thread = height / num_threads;
-    
-    // Launch worker threads
-    for (int t = 0; t < num_threads; t++) {
-        MandelbrotWorkerData *data = (MandelbrotWorkerData *)malloc(sizeof(MandelbrotWorkerData));
-        data->mb = mb;
-        data->width = width;
-        data->height = height;
-        data->start_y = t * rows_per_thread;
-        data->end_y = (t == num_threads - 1) ? height : (t + 1) * rows_per_thread;
-        data->center_x = mb->center_x;
-        data->center_y = mb->center_y;
-        data->zoom = mb->zoom;
-        data->max_iterations = mb->max_iterations;
-        
-        pthread_create(&threads[t], NULL, mandelbrot_worker_thread, data);
+    if (!mb || width <= 0 || height <= 0 || mb->computing) return;
+    
+    if (!mb->pool_started) {
+        mb->pool_started = mandelbrot_pool_start(&mb->pool);
+        if (!mb->pool_started) return;
     }
     
-    // Wait for all threads to complete
-    for (int t = 0; t < num_threads; t++) {
-        pthread_join(threads[t], NULL);
+    MandelbrotFrame *frame = &mb->pending;
+    size_t pixels = (size_t)width * height;
+    if (frame->capacity < pixels) {
+        g_free(frame->data);
+        frame->data = (uint16_t *)g_malloc(pixels * sizeof(uint16_t));
+        frame->capacity = pixels;
     }
     
+    // Fewer iterations on large windows, as before
+    int iterations = mb->max_iterations;
+    if (width >= 1920) {
+        iterations = (int)(mb->max_iterations * 0.7);
+    } else if (width >= 1024) {
+        iterations = (int)(mb->max_iterations * 0.9);
+    }
+    
+    frame->width = width;
+    frame->height = height;
+    frame->iterations = MIN(iterations, MANDELBROT_MAX_ITERATIONS);
+    frame->center_x = mb->center_x;
+    frame->center_y = mb->center_y;
+    frame->zoom = mb->zoom;
+    
+    MandelbrotJob job;
+    job.width = width;
+    job.height = height;
+    job.center_x = frame->center_x;
+    job.center_y = frame->center_y;
+    job.zoom = frame->zoom;
+    job.max_iterations = frame->iterations;
+    job.out = frame->data;
+    
+    mandelbrot_pool_submit(&mb->pool, &job);
+    mb->computing = TRUE;
+}
+
+// Passes of the pending frame finished so far. Once all of them are it
+// becomes the shown frame, and 0 is returned.
+static int mandelbrot_collect_frame(MandelbrotState *mb) {
+    if (!mb->computing) return 0;
+    int passes = mandelbrot_pool_passes_done(&mb->pool);
+    if (passes < MANDELBROT_PASSES) return passes;
+    
+    MandelbrotFrame done = mb->pending;
+    mb->pending = mb->shown;
+    mb->shown = done;
+    mb->computing = FALSE;
     mb->needs_redraw = FALSE;
+    return 0;
+}
+
+// Where a frame lands in a width x height window showing the current view:
+// window x = scale_x * frame x + offset_x, and the same for y
+static void mandelbrot_place_frame(const MandelbrotFrame *frame, const MandelbrotState *mb,
+                                   int width, int height, double *scale_x, double *offset_x,
+                                   double *scale_y, double *offset_y) {
+    double frame_height = 2.5 / frame->zoom;
+    double frame_width = frame_height * frame->width / frame->height;
+    double view_height = 2.5 / mb->zoom;
+    double view_width = view_height * width / height;
+    
+    *scale_x = frame_width / frame->width / view_width * width;
+    *scale_y = frame_height / frame->height / view_height * height;
+    *offset_x = ((frame->center_x - mb->center_x) - 0.5 * frame_width) / view_width * width + 0.5 * width;
+    *offset_y = ((frame->center_y - mb->center_y) - 0.5 * frame_height) / view_height * height + 0.5 * height;
+}
+
+// Share of the window a frame covers once placed
+static double mandelbrot_frame_coverage(const MandelbrotFrame *frame, const MandelbrotState *mb,
+                                        int width, int height) {
+    double scale_x, offset_x, scale_y, offset_y;
+    mandelbrot_place_frame(frame, mb, width, height, &scale_x, &offset_x, &scale_y, &offset_y);
+    double covered_x = MIN(offset_x + scale_x * frame->width, (double)width) - MAX(offset_x, 0.0);
+    double covered_y = MIN(offset_y + scale_y * frame->height, (double)height) - MAX(offset_y, 0.0);
+    if (covered_x <= 0 || covered_y <= 0) return 0.0;
+    return covered_x * covered_y / ((double)width * height);
+}
+
+// A color for every count up to the frame's limit, so coloring a pixel is a
+// lookup instead of an HSV conversion
+static void mandelbrot_build_palette(MandelbrotState *mb, int limit) {
+    for (int n = 0; n < limit; n++) {
+        double r, g, b;
+        mandelbrot_get_color(n, mb->max_iterations, mb->hue_offset, &r, &g, &b);
+        
+        // Cairo uses ARGB format (little-endian on most systems)
+        uint8_t r8 = (uint8_t)(r * 255);
+        uint8_t g8 = (uint8_t)(g * 255);
+        uint8_t b8 = (uint8_t)(b * 255);
+        mb->palette[n] = (0xFFu << 24) | (r8 << 16) | (g8 << 8) | b8;
+    }
+    
+    // Points in the set are black
+    mb->palette[limit] = 0xFF000000;
+}
+
+// Color a frame into mb->surface, each computed point filling its
+// step x step block
+static void mandelbrot_color_frame(MandelbrotState *mb, const MandelbrotFrame *frame, int step) {
+    if (mb->surface && (cairo_image_surface_get_width(mb->surface) != frame->width ||
+                        cairo_image_surface_get_height(mb->surface) != frame->height)) {
+        cairo_surface_destroy(mb->surface);
+        mb->surface = NULL;
+    }
+    if (!mb->surface) {
+        mb->surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, frame->width, frame->height);
+    }
+    cairo_surface_flush(mb->surface);
+    
+    unsigned char *image_data = cairo_image_surface_get_data(mb->surface);
+    int stride = cairo_image_surface_get_stride(mb->surface);
+    const uint32_t *palette = mb->palette;
+    int mask = ~(step - 1);
+    
+    for (int y = 0; y < frame->height; y++) {
+        uint32_t *row = (uint32_t *)(image_data + (size_t)y * stride);
+        const uint16_t *counts = frame->data + (size_t)(y & mask) * frame->width;
+        
+        if (step == 1) {
+            for (int x = 0; x < frame->width; x++) {
+                row[x] = palette[counts[x]];
+            }
+        } else {
+            for (int x = 0; x < frame->width; x++) {
+                row[x] = palette[counts[x & mask]];
+            }
+        }
+    }
+    
+    cairo_surface_mark_dirty(mb->surface);
 }
 
 // Initialize the Mandelbrot visualization
@@ -179,8 +519,6 @@ void init_mandelbrot_system(void *vis_ptr) {
     mb->zoom_speed = 8.0;  // Much faster animation to target
     
     mb->max_iterations = 256;
-    mb->data_width = -1;  // Force recalculation on first draw
-    mb->data_height = -1;
     mb->needs_redraw = TRUE;
     
     mb->last_beat_time = 0.0;
@@ -195,6 +533,25 @@ void init_mandelbrot_system(void *vis_ptr) {
     mb->drift_speed = 0.02;  // Subtle panning speed
 }
 
+void cleanup_mandelbrot_system(void *vis_ptr) {
+    Visualizer *vis = (Visualizer *)vis_ptr;
+    MandelbrotState *mb = &vis->mandelbrot;
+    
+    if (mb->pool_started) {
+        mandelbrot_pool_stop(&mb->pool);
+        mb->pool_started = FALSE;
+    }
+    mb->computing = FALSE;
+    g_free(mb->shown.data);
+    g_free(mb->pending.data);
+    memset(&mb->shown, 0, sizeof(mb->shown));
+    memset(&mb->pending, 0, sizeof(mb->pending));
+    if (mb->surface) {
+        cairo_surface_destroy(mb->surface);
+        mb->surface = NULL;
+    }
+}
+
 // Detect beat for zoom trigger
 gboolean mandelbrot_detect_beat(void *vis_ptr) {
     Visualizer *vis = (Visualizer *)vis_ptr;
@@ -300,12 +657,16 @@ void draw_mandelbrot(void *vis_ptr, cairo_t *cr) {
     int width = vis->width;
     int height = vis->height;
     
+    int passes = mandelbrot_collect_frame(mb);
+    
     // Recalculate only if zoom changed significantly or dimensions changed
     // Don't recalculate every frame - that's too expensive
     static double last_zoom = 1.0;
     static double last_center_x = -0.65;
     static double last_center_y = 0.0;
     static int last_iterations = 256;
+    static int last_width = -1;  // Force calculation on first draw
+    static int last_height = -1;
     
     // Check if anything meaningful changed - use larger thresholds for stability
     gboolean zoom_changed = last_zoom > 0 && fabs(log(mb->zoom / last_zoom)) > 0.05;  // 5% zoom change
@@ -313,56 +674,51 @@ void draw_mandelbrot(void *vis_ptr, cairo_t *cr) {
                           fabs(mb->center_y - last_center_y) > 0.005;  // Stable position threshold
     gboolean iter_changed = mb->max_iterations != last_iterations;
     
-    gboolean should_recalc = (zoom_changed || pos_changed || iter_changed || mb->data_width != width || mb->data_height != height);
+    gboolean should_recalc = (zoom_changed || pos_changed || iter_changed || last_width != width || last_height != height);
     
-    if (should_recalc) {
+    // One frame in flight at a time; until it's done the last one is shown
+    if (should_recalc && !mb->computing) {
         mandelbrot_recalculate_region(vis, width, height);
         last_zoom = mb->zoom;
         last_center_x = mb->center_x;
         last_center_y = mb->center_y;
         last_iterations = mb->max_iterations;
+        last_width = width;
+        last_height = height;
     }
     
     // Clear background
     cairo_set_source_rgb(cr, vis->bg_r, vis->bg_g, vis->bg_b);
     cairo_paint(cr);
     
-    // Create image surface for faster rendering
-    cairo_surface_t *image_surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
-    unsigned char *image_data = cairo_image_surface_get_data(image_surface);
-    int stride = cairo_image_surface_get_stride(image_surface);
+    // The finished frame, moved and scaled to where its view lies now, so
+    // the zoom keeps moving between recomputes. While it covers too little
+    // of the window (the first frame, a resize, a jump) the frame being
+    // computed is shown instead, as far as its passes have got.
+    const MandelbrotFrame *frame = mb->shown.data ? &mb->shown : NULL;
+    int step = 1;
+    if (mb->computing && passes > 0 &&
+        (!frame || mandelbrot_frame_coverage(frame, mb, width, height) < 0.95)) {
+        frame = &mb->pending;
+        step = MANDELBROT_COARSE_STEP >> (passes - 1);
+    }
     
-    // Fill with Mandelbrot fractal colors
-    for (int y = 0; y < height; y++) {
-        uint32_t *row = (uint32_t *)(image_data + y * stride);
+    if (frame) {
+        mandelbrot_build_palette(mb, frame->iterations);
+        mandelbrot_color_frame(mb, frame, step);
         
-        for (int x = 0; x < width; x++) {
-            int idx = y * width + x;
-            if (idx < 0 || idx >= MANDELBROT_DATA_SIZE) continue;  // Bounds check
-            
-            int iterations = (int)mb->iteration_data[idx];
-            
-            double r, g, b;
-            mandelbrot_get_color(iterations, mb->max_iterations, mb->hue_offset, &r, &g, &b);
-            
-            // Convert to 8-bit RGB
-            uint8_t r8 = (uint8_t)(r * 255);
-            uint8_t g8 = (uint8_t)(g * 255);
-            uint8_t b8 = (uint8_t)(b * 255);
-            
-            // Cairo uses ARGB format (little-endian on most systems)
-            row[x] = (0xFF << 24) | (r8 << 16) | (g8 << 8) | b8;
-        }
+        double scale_x, offset_x, scale_y, offset_y;
+        mandelbrot_place_frame(frame, mb, width, height, &scale_x, &offset_x, &scale_y, &offset_y);
+        
+        cairo_save(cr);
+        cairo_translate(cr, offset_x, offset_y);
+        cairo_scale(cr, scale_x, scale_y);
+        cairo_set_source_surface(cr, mb->surface, 0, 0);
+        cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);
+        cairo_paint(cr);
+        cairo_restore(cr);
     }
     
-    cairo_surface_mark_dirty(image_surface);
-    
-    // Draw the image surface
-    cairo_set_source_surface(cr, image_surface, 0, 0);
-    cairo_paint(cr);
-    
-    cairo_surface_destroy(image_surface);
-    
     // Draw zoom level indicator at bottom
     char zoom_text[64];
     sprintf(zoom_text, "Zoom: %.1e | Center: (%.4f, %.4f)", mb->zoom, mb->center_x, mb->center_y);
@@ -5,8 +5,63 @@
 #include <math.h>
 #include <glib.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
 
-#define MANDELBROT_DATA_SIZE (1920 * 1440)  // Max resolution for cached iteration data
+#define MANDELBROT_MAX_ITERATIONS 2048   // Iteration counts fit a uint16_t
+#define MANDELBROT_TILE_SIZE      32     // Pixels per side of one unit of pool work
+#define MANDELBROT_MAX_THREADS    32
+#define MANDELBROT_PASSES         4      // Refinement passes per frame
+#define MANDELBROT_COARSE_STEP    8      // Pixel spacing of the first pass, halved by each next one
+
+// One frame for the pool to compute
+typedef struct {
+    int width;
+    int height;
+    double center_x;
+    double center_y;
+    double zoom;
+    int max_iterations;
+    uint16_t *out;               // width x height iteration counts
+} MandelbrotJob;
+
+// Worker threads that live as long as the visualizer. A job is cut into
+// square tiles which idle workers claim one at a time, so a thread that
+// drew cheap outside tiles simply takes more of them while another is
+// still deep inside the set.
+//
+// Every tile is done once per pass. The first pass computes one point in
+// every MANDELBROT_COARSE_STEP x MANDELBROT_COARSE_STEP block, and each
+// later pass only the points halfway between those already done, so no
+// point is written twice and a finished pass can be shown while the next
+// one is still running.
+typedef struct {
+    pthread_t threads[MANDELBROT_MAX_THREADS];
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    gboolean stop;
+
+    // Under lock
+    MandelbrotJob job;
+    int tiles_x;
+    int pass_tiles;              // Tiles in one pass
+    int tile_count;              // In all passes
+    int next_tile;               // First tile nobody has claimed
+    int pass_left[MANDELBROT_PASSES];   // Tiles of each pass not finished
+} MandelbrotPool;
+
+// Iteration counts for one view
+typedef struct {
+    uint16_t *data;              // width x height
+    size_t capacity;             // Pixels allocated
+    int width;
+    int height;
+    int iterations;              // Iteration limit the counts were computed with
+    double center_x;
+    double center_y;
+    double zoom;
+} MandelbrotFrame;
 
 typedef struct {
     // Fractal state
@@ -15,28 +70,34 @@ typedef struct {
     double zoom;
     double target_zoom;
     double zoom_speed;
-    
+
     // Rendering
     int max_iterations;
-    double iteration_data[MANDELBROT_DATA_SIZE];  // Static buffer for iteration counts
-    int data_width;
-    int data_height;
+    MandelbrotFrame shown;       // Latest finished frame
     gboolean needs_redraw;
-    
+    uint32_t palette[MANDELBROT_MAX_ITERATIONS + 1];   // Color of each iteration count
+    cairo_surface_t *surface;    // Colored frame, kept while its size holds
+
+    // Background computation
+    MandelbrotPool pool;
+    gboolean pool_started;
+    gboolean computing;          // The pool is filling pending
+    MandelbrotFrame pending;
+
     // Beat tracking
     double last_beat_time;
     double beat_zoom_intensity;  // How much to zoom on beat
     double current_zoom_boost;   // Current zoom boost from beat
-    
+
     // Color cycling
     double hue_offset;
     double color_cycle_speed;
-    
+
     // Animation
     double drift_x;
     double drift_y;
     double drift_speed;
-    
+
 } MandelbrotState;
 
 #endif
@@ -1,16 +1,10 @@
 #include "visualization.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
 #include <time.h>
 
-typedef struct {
-    int wall_type;
-    double hit_x;
-    double hit_y;
-    double dist;
-} RayHit;
-
 void init_maze3d_system(Visualizer *vis) {
     Maze3D *maze = &vis->maze3d;
     
@@ -374,11 +368,426 @@ void update_maze3d(Visualizer *vis, double dt) {
     }
 }
 
+// Where the ray enters the band lo..hi of one axis while it is inside the
+// cell (t_entry..t_exit), kept in *best if it is the earliest so far
+static void wall_band_entry(double start, double dir, double lo, double hi,
+                            double t_entry, double t_exit, int wall_type,
+                            double *best, int *best_type) {
+    double t_in, t_out;
+    if (dir == 0.0) {
+        if (start < lo || start > hi) return;
+        t_in = t_entry;
+        t_out = t_exit;
+    } else {
+        t_in = (lo - start) / dir;
+        t_out = (hi - start) / dir;
+        if (t_in > t_out) {
+            double swap = t_in;
+            t_in = t_out;
+            t_out = swap;
+        }
+    }
+    
+    double t = MAX(t_in, t_entry);
+    if (t <= MIN(t_out, t_exit) && t < *best) {
+        *best = t;
+        *best_type = wall_type;
+    }
+}
+
+// Cast one ray, stepping from cell to cell along the grid lines it crosses.
+// A wall is the 0.1-wide band inside its cell edge, so the hit lands where
+// the old fixed-step march found it. hit->dist is the distance along the
+// ray, before the fish-eye correction.
+static void cast_ray(const Maze3D *maze, double start_x, double start_y,
+                     double ray_dx, double ray_dy, RayHit *hit) {
+    int map_x = (int)start_x;
+    int map_y = (int)start_y;
+    int step_x = ray_dx < 0 ? -1 : 1;
+    int step_y = ray_dy < 0 ? -1 : 1;
+    
+    // Ray length per cell crossed, and to the next grid line on each axis
+    double delta_x = ray_dx != 0.0 ? fabs(1.0 / ray_dx) : 1e30;
+    double delta_y = ray_dy != 0.0 ? fabs(1.0 / ray_dy) : 1e30;
+    double side_x = ray_dx == 0.0 ? 1e30 :
+                    ray_dx < 0 ? (start_x - map_x) * delta_x : (map_x + 1.0 - start_x) * delta_x;
+    double side_y = ray_dy == 0.0 ? 1e30 :
+                    ray_dy < 0 ? (start_y - map_y) * delta_y : (map_y + 1.0 - start_y) * delta_y;
+    
+    double t_entry = 0.0;
+    double dist = MAZE_VIEW_DISTANCE;
+    int wall_type = 0;
+    
+    while (t_entry < MAZE_VIEW_DISTANCE) {
+        // Leaving the grid counts as a north wall
+        if (map_x < 0 || map_x >= MAZE_WIDTH || map_y < 0 || map_y >= MAZE_HEIGHT) {
+            dist = t_entry;
+            break;
+        }
+        
+        double t_exit = MIN(side_x, side_y);
+        unsigned char cell = maze->cells[map_y][map_x];
+        double best = 1e30;
+        int best_type = 0;
+        
+        // Same precedence as the old march when bands overlap: N, S, W, E
+        if (cell & WALL_NORTH) {
+            wall_band_entry(start_y, ray_dy, map_y, map_y + 0.1, t_entry, t_exit, 0, &best, &best_type);
+        }
+        if (cell & WALL_SOUTH) {
+            wall_band_entry(start_y, ray_dy, map_y + 0.9, map_y + 1.0, t_entry, t_exit, 2, &best, &best_type);
+        }
+        if (cell & WALL_WEST) {
+            wall_band_entry(start_x, ray_dx, map_x, map_x + 0.1, t_entry, t_exit, 3, &best, &best_type);
+        }
+        if (cell & WALL_EAST) {
+            wall_band_entry(start_x, ray_dx, map_x + 0.9, map_x + 1.0, t_entry, t_exit, 1, &best, &best_type);
+        }
+        if (best < 1e30) {
+            dist = best;
+            wall_type = best_type;
+            break;
+        }
+        
+        if (side_x < side_y) {
+            t_entry = side_x;
+            side_x += delta_x;
+            map_x += step_x;
+        } else {
+            t_entry = side_y;
+            side_y += delta_y;
+            map_y += step_y;
+        }
+    }
+    
+    if (dist > MAZE_VIEW_DISTANCE) {
+        dist = MAZE_VIEW_DISTANCE;
+        wall_type = 0;
+    }
+    
+    hit->wall_type = wall_type;
+    hit->hit_x = start_x + ray_dx * dist;
+    hit->hit_y = start_y + ray_dy * dist;
+    hit->dist = dist;
+}
+
+// The frame surface's pixels, as one render band may touch them
+typedef struct {
+    uint32_t *pixels;
+    int stride;            // In pixels
+    int width;
+    int row_begin;         // Rows of the band
+    int row_end;
+} MazeFrame;
+
+static inline uint32_t pack_rgb(double r, double g, double b) {
+    uint32_t r8 = (uint32_t)(CLAMP(r, 0.0, 1.0) * 255);
+    uint32_t g8 = (uint32_t)(CLAMP(g, 0.0, 1.0) * 255);
+    uint32_t b8 = (uint32_t)(CLAMP(b, 0.0, 1.0) * 255);
+    return 0xFF000000u | (r8 << 16) | (g8 << 8) | b8;
+}
+
+static inline uint32_t alpha_255(double alpha) {
+    return (uint32_t)(CLAMP(alpha, 0.0, 1.0) * 255 + 0.5);
+}
+
+// color over dst, alpha from 0 to 255
+static inline uint32_t blend_pixel(uint32_t dst, uint32_t color, uint32_t alpha) {
+    uint32_t keep = 255 - alpha;
+    uint32_t r = (((color >> 16) & 0xFF) * alpha + ((dst >> 16) & 0xFF) * keep + 127) / 255;
+    uint32_t g = (((color >> 8) & 0xFF) * alpha + ((dst >> 8) & 0xFF) * keep + 127) / 255;
+    uint32_t b = ((color & 0xFF) * alpha + (dst & 0xFF) * keep + 127) / 255;
+    return 0xFF000000u | (r << 16) | (g << 8) | b;
+}
+
+// Fill the pixels whose centers lie inside the rectangle, which is what
+// cairo covers with antialiasing off
+static void frame_fill_rect(const MazeFrame *frame, const MazeRect *rect) {
+    int left = MAX((int)ceil(rect->x0 - 0.5), 0);
+    int right = MIN((int)ceil(rect->x1 - 0.5), frame->width);
+    int top = MAX((int)ceil(rect->y0 - 0.5), frame->row_begin);
+    int bottom = MIN((int)ceil(rect->y1 - 0.5), frame->row_end);
+    
+    for (int y = top; y < bottom; y++) {
+        uint32_t *row = frame->pixels + (size_t)y * frame->stride;
+        for (int x = left; x < right; x++) {
+            row[x] = rect->alpha == 255 ? rect->color : blend_pixel(row[x], rect->color, rect->alpha);
+        }
+    }
+}
+
+// One round puff of cloud
+typedef struct {
+    double x, y;
+    double radius;
+    uint32_t alpha;
+} CloudPuff;
+
+// Fill a puff, only on sky no wall stands in front of
+static void frame_fill_cloud_puff(const MazeFrame *frame, const int *wall_top, int sky_rows,
+                                  const CloudPuff *puff) {
+    int top = MAX((int)ceil(puff->y - puff->radius - 0.5), frame->row_begin);
+    int bottom = MIN((int)floor(puff->y + puff->radius - 0.5) + 1, MIN(sky_rows, frame->row_end));
+    
+    for (int y = top; y < bottom; y++) {
+        double dy = y + 0.5 - puff->y;
+        double half = sqrt(MAX(puff->radius * puff->radius - dy * dy, 0.0));
+        int left = MAX((int)ceil(puff->x - half - 0.5), 0);
+        int right = MIN((int)floor(puff->x + half - 0.5), frame->width - 1);
+        uint32_t *row = frame->pixels + (size_t)y * frame->stride;
+        for (int x = left; x <= right; x++) {
+            if (y < wall_top[x]) {
+                row[x] = blend_pixel(row[x], 0xFFFFFFFFu, puff->alpha);
+            }
+        }
+    }
+}
+
+#define MAZE_CLOUD_PUFFS 18
+
+// One frame for render_maze3d_band()
+typedef struct {
+    const Maze3D *maze;
+    MazeFrame frame;
+    int sky_rows;          // Rows above the horizon
+    CloudPuff puffs[MAZE_CLOUD_PUFFS];
+    int puff_count;
+} MazeRenderJob;
+
+// The frame between two rows: sky, floor and walls, the clouds behind the
+// walls and the decorations over them
+static void render_maze3d_band(void *data, int row_begin, int row_end) {
+    const MazeRenderJob *job = (const MazeRenderJob *)data;
+    const Maze3D *maze = job->maze;
+    MazeFrame frame = job->frame;
+    frame.row_begin = row_begin;
+    frame.row_end = row_end;
+    
+    const int *wall_top = maze->wall_top;
+    const int *wall_bottom = maze->wall_bottom;
+    const uint32_t *wall_color = maze->wall_color;
+    for (int y = row_begin; y < row_end; y++) {
+        uint32_t *row = frame.pixels + (size_t)y * frame.stride;
+        uint32_t background = maze->row_colors[y];
+        for (int x = 0; x < frame.width; x++) {
+            row[x] = (y >= wall_top[x] && y < wall_bottom[x]) ? wall_color[x] : background;
+        }
+    }
+    
+    for (int i = 0; i < job->puff_count; i++) {
+        frame_fill_cloud_puff(&frame, wall_top, job->sky_rows, &job->puffs[i]);
+    }
+    
+    for (int i = 0; i < maze->decoration_count; i++) {
+        frame_fill_rect(&frame, &maze->decorations[i]);
+    }
+}
+
+static void add_decoration(Maze3D *maze, double x0, double y0, double x1, double y1,
+                           uint32_t color, double alpha) {
+    uint32_t a = alpha_255(alpha);
+    if (a == 0) return;
+    
+    MazeRect *rect = &maze->decorations[maze->decoration_count++];
+    rect->x0 = x0;
+    rect->y0 = y0;
+    rect->x1 = x1;
+    rect->y1 = y1;
+    rect->color = color;
+    rect->alpha = a;
+}
+
+static void* maze_render_thread(void *arg) {
+    MazeRenderPool *pool = (MazeRenderPool *)arg;
+    
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop) {
+        if (pool->next_band >= pool->band_count) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+            continue;
+        }
+        
+        int band = pool->next_band++;
+        MazeBandFunc func = pool->func;
+        void *data = pool->data;
+        int rows = pool->rows;
+        pthread_mutex_unlock(&pool->lock);
+        
+        int row_begin = band * MAZE_RENDER_BAND_ROWS;
+        func(data, row_begin, MIN(row_begin + MAZE_RENDER_BAND_ROWS, rows));
+        
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->bands_left == 0) {
+            pthread_cond_signal(&pool->finished);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void maze_render_pool_start(MazeRenderPool *pool) {
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    
+    // The drawing thread renders bands as well
+    int wanted = (int)g_get_num_processors() - 1;
+    if (wanted > MAZE_RENDER_MAX_THREADS) wanted = MAZE_RENDER_MAX_THREADS;
+    for (int t = 0; t < wanted; t++) {
+        if (pthread_create(&pool->threads[t], NULL, maze_render_thread, pool) != 0) break;
+        pool->thread_count++;
+    }
+    printf("Maze3D: %d render threads\n", pool->thread_count + 1);
+}
+
+static void maze_render_pool_stop(MazeRenderPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = TRUE;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    
+    for (int t = 0; t < pool->thread_count; t++) {
+        pthread_join(pool->threads[t], NULL);
+    }
+    pool->thread_count = 0;
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->finished);
+}
+
+// Call func on every band of rows, returning once all are done
+static void maze_render_pool_run(MazeRenderPool *pool, MazeBandFunc func, void *data, int rows) {
+    int band_count = (rows + MAZE_RENDER_BAND_ROWS - 1) / MAZE_RENDER_BAND_ROWS;
+    if (pool->thread_count == 0) {
+        func(data, 0, rows);
+        return;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->func = func;
+    pool->data = data;
+    pool->rows = rows;
+    pool->band_count = band_count;
+    pool->next_band = 0;
+    pool->bands_left = band_count;
+    pthread_cond_broadcast(&pool->wake);
+    
+    while (pool->next_band < pool->band_count) {
+        int band = pool->next_band++;
+        pthread_mutex_unlock(&pool->lock);
+        
+        int row_begin = band * MAZE_RENDER_BAND_ROWS;
+        func(data, row_begin, MIN(row_begin + MAZE_RENDER_BAND_ROWS, rows));
+        
+        pthread_mutex_lock(&pool->lock);
+        pool->bands_left--;
+    }
+    while (pool->bands_left > 0) {
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void free_maze3d_buffers(Maze3D *maze) {
+    if (maze->frame) {
+        cairo_surface_destroy(maze->frame);
+        maze->frame = NULL;
+    }
+    g_free(maze->ray_hits);
+    g_free(maze->wall_top);
+    g_free(maze->wall_bottom);
+    g_free(maze->wall_color);
+    g_free(maze->row_colors);
+    g_free(maze->decorations);
+    maze->ray_hits = NULL;
+    maze->wall_top = NULL;
+    maze->wall_bottom = NULL;
+    maze->wall_color = NULL;
+    maze->row_colors = NULL;
+    maze->decorations = NULL;
+    maze->decoration_count = 0;
+    maze->frame_width = 0;
+    maze->frame_height = 0;
+}
+
+// (Re)create the render buffers for a width x height window
+static gboolean prepare_maze3d_buffers(Maze3D *maze, int width, int height) {
+    if (maze->frame && maze->frame_width == width && maze->frame_height == height) {
+        return TRUE;
+    }
+    
+    free_maze3d_buffers(maze);
+    maze->frame = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+    if (cairo_surface_status(maze->frame) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(maze->frame);
+        maze->frame = NULL;
+        return FALSE;
+    }
+    maze->frame_width = width;
+    maze->frame_height = height;
+    maze->ray_hits = g_new(RayHit, width);
+    maze->wall_top = g_new(int, width);
+    maze->wall_bottom = g_new(int, width);
+    maze->wall_color = g_new(uint32_t, width);
+    maze->row_colors = g_new(uint32_t, height);
+    maze->decorations = g_new(MazeRect, 3 * width);
+    
+    // Sky gradient down to the horizon, then the floor gradient, sampled at
+    // pixel centers like the cairo gradients they replace
+    double half_height = height / 2.0;
+    for (int y = 0; y < height; y++) {
+        double pos = y + 0.5;
+        if (pos < half_height) {
+            double t = pos / half_height;
+            maze->row_colors[y] = pack_rgb(0.3 + 0.3 * t, 0.6 + 0.2 * t, 1.0);
+        } else {
+            double t = (pos - half_height) / half_height;
+            maze->row_colors[y] = pack_rgb(0.25 - 0.1 * t, 0.2 - 0.1 * t, 0.15 - 0.07 * t);
+        }
+    }
+    return TRUE;
+}
+
+void cleanup_maze3d_system(Visualizer *vis) {
+    Maze3D *maze = &vis->maze3d;
+    
+    if (maze->render_pool_started) {
+        maze_render_pool_stop(&maze->render_pool);
+        maze->render_pool_started = FALSE;
+    }
+    free_maze3d_buffers(maze);
+}
+
+// Rainbow color of wall bar bar_idx
+static void wall_bar_color(int bar_idx, int num_wall_bars, double *bar_r, double *bar_g, double *bar_b) {
+    double hue = (double)bar_idx / num_wall_bars;
+    
+    if (hue < 0.166) {
+        *bar_r = 1.0; *bar_g = hue / 0.166; *bar_b = 0.0;
+    } else if (hue < 0.333) {
+        *bar_r = 1.0 - (hue - 0.166) / 0.167; *bar_g = 1.0; *bar_b = 0.0;
+    } else if (hue < 0.5) {
+        *bar_r = 0.0; *bar_g = 1.0; *bar_b = (hue - 0.333) / 0.167;
+    } else if (hue < 0.666) {
+        *bar_r = 0.0; *bar_g = 1.0 - (hue - 0.5) / 0.166; *bar_b = 1.0;
+    } else if (hue < 0.833) {
+        *bar_r = (hue - 0.666) / 0.167; *bar_g = 0.0; *bar_b = 1.0;
+    } else {
+        *bar_r = 1.0; *bar_g = 0.0; *bar_b = 1.0 - (hue - 0.833) / 0.167;
+    }
+}
+
 void draw_maze3d(Visualizer *vis, cairo_t *cr) {
     Maze3D *maze = &vis->maze3d;
     Player *player = &maze->player;
     
     if (vis->width <= 0 || vis->height <= 0) return;
+    if (!prepare_maze3d_buffers(maze, vis->width, vis->height)) return;
+    if (!maze->render_pool_started) {
+        maze_render_pool_start(&maze->render_pool);
+        maze->render_pool_started = TRUE;
+    }
     
     // Disable antialiasing to prevent color blending artifacts
     cairo_set_antialias(cr, CAIRO_ANTIALIAS_NONE);
@@ -386,14 +795,43 @@ void draw_maze3d(Visualizer *vis, cairo_t *cr) {
     double half_width = vis->width / 2.0;
     double half_height = vis->height / 2.0;
     
-    // Draw textured sky with gradient
-    cairo_pattern_t *sky_pattern = cairo_pattern_create_linear(0, 0, 0, half_height);
-    cairo_pattern_add_color_stop_rgb(sky_pattern, 0, 0.3, 0.6, 1.0);
-    cairo_pattern_add_color_stop_rgb(sky_pattern, 1, 0.6, 0.8, 1.0);
-    cairo_set_source(cr, sky_pattern);
-    cairo_rectangle(cr, 0, 0, vis->width, half_height);
-    cairo_fill(cr);
-    cairo_pattern_destroy(sky_pattern);
+    // Raycasting parameters
+    double fov = M_PI / 3.0; // 60 degrees
+    int num_rays = vis->width;  // One ray per pixel column
+    RayHit *ray_hits = maze->ray_hits;
+    
+    // First pass: raycasting to find walls and store hit data
+    for (int ray = 0; ray < num_rays; ray++) {
+        double ray_angle = player->angle - fov / 2.0 + (ray / (double)num_rays) * fov;
+        
+        cast_ray(maze, player->x, player->y, cos(ray_angle), sin(ray_angle), &ray_hits[ray]);
+        
+        // Fix fish-eye effect
+        double dist = ray_hits[ray].dist * cos(ray_angle - player->angle);
+        if (dist < 0.1) dist = 0.1;
+        ray_hits[ray].dist = dist;
+        
+        // Calculate wall height
+        double wall_height = (vis->height / dist) * 0.5;
+        if (wall_height > vis->height * 2) wall_height = vis->height * 2;
+        
+        // Round positions to integer pixels
+        int top_y = (int)(half_height - wall_height / 2);
+        int height = (int)wall_height;
+        maze->wall_top[ray] = CLAMP(top_y, 0, vis->height);
+        maze->wall_bottom[ray] = CLAMP(top_y + height, 0, vis->height);
+        
+        // Distance-based brightness
+        double brightness = 1.0 / (1.0 + dist * 0.15);
+        brightness *= (1.0 + maze->audio_pulse * 0.3);
+        if (brightness > 1.0) brightness = 1.0;
+        
+        // Base color for this wall direction
+        int wall_type = ray_hits[ray].wall_type;
+        maze->wall_color[ray] = pack_rgb(maze->wall_colors[wall_type][0] * brightness,
+                                         maze->wall_colors[wall_type][1] * brightness,
+                                         maze->wall_colors[wall_type][2] * brightness);
+    }
     
     // Draw clouds in the sky - location aware based on player position
     double player_angle_normalized = player->angle;
@@ -402,6 +840,10 @@ void draw_maze3d(Visualizer *vis, cairo_t *cr) {
     
     // Map player viewing angle to horizontal cloud offset
     double cloud_offset = (player_angle_normalized / (2 * M_PI)) * vis->width * 4;
+    MazeRenderJob job;
+    job.maze = maze;
+    job.sky_rows = (int)ceil(half_height - 0.5);
+    job.puff_count = 0;
     
     for (int cloud_idx = 0; cloud_idx < 6; cloud_idx++) {
         // Position clouds based on viewing angle
@@ -422,126 +864,30 @@ void draw_maze3d(Visualizer *vis, cairo_t *cr) {
             // Vary cloud size based on cloud index
             double cloud_size_mult = 0.8 + cloud_noise * 0.4;
             
-            // Draw puffy cloud shapes
-            cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, cloud_opacity);
-            cairo_arc(cr, cloud_x - 15 * cloud_size_mult, cloud_y, 12.0 * cloud_size_mult, 0, 2 * M_PI);
-            cairo_fill(cr);
-            cairo_arc(cr, cloud_x, cloud_y - 8, 14.0 * cloud_size_mult, 0, 2 * M_PI);
-            cairo_fill(cr);
-            cairo_arc(cr, cloud_x + 15 * cloud_size_mult, cloud_y, 12.0 * cloud_size_mult, 0, 2 * M_PI);
-            cairo_fill(cr);
-        }
-    }
-    
-    // Draw textured floor with gradient
-    cairo_pattern_t *floor_pattern = cairo_pattern_create_linear(0, half_height, 0, vis->height);
-    cairo_pattern_add_color_stop_rgb(floor_pattern, 0, 0.25, 0.2, 0.15);
-    cairo_pattern_add_color_stop_rgb(floor_pattern, 1, 0.15, 0.1, 0.08);
-    cairo_set_source(cr, floor_pattern);
-    cairo_rectangle(cr, 0, half_height, vis->width, half_height);
-    cairo_fill(cr);
-    cairo_pattern_destroy(floor_pattern);
-    
-    // Raycasting parameters
-    double fov = M_PI / 3.0; // 60 degrees
-    int num_rays = vis->width;  // One ray per pixel column
-    
-    // Store wall distances for z-buffering
-    double *wall_distances = (double*)malloc(num_rays * sizeof(double));
-    RayHit *ray_hits = (RayHit*)malloc(num_rays * sizeof(RayHit));
-    
-    // First pass: raycasting to find walls and store hit data
-    for (int ray = 0; ray < num_rays; ray++) {
-        double ray_angle = player->angle - fov / 2.0 + (ray / (double)num_rays) * fov;
-        
-        double ray_dx = cos(ray_angle);
-        double ray_dy = sin(ray_angle);
-        
-        // Simple raycasting - step through until we hit a wall
-        double ray_x = player->x;
-        double ray_y = player->y;
-        double step_size = 0.02;
-        double dist = 0.0;
-        int hit = 0;
-        int wall_type = 0;
-        
-        while (dist < 20.0 && !hit) {
-            ray_x += ray_dx * step_size;
-            ray_y += ray_dy * step_size;
-            dist += step_size;
-            
-            int map_x = (int)ray_x;
-            int map_y = (int)ray_y;
-            
-            // Check bounds
-            if (map_x < 0 || map_x >= MAZE_WIDTH || map_y < 0 || map_y >= MAZE_HEIGHT) {
-                hit = 1;
-                wall_type = 0;
-                break;
-            }
-            
-            // Get fractional position within cell
-            double frac_x = ray_x - map_x;
-            double frac_y = ray_y - map_y;
-            
-            // Check which wall we hit
-            if (maze->cells[map_y][map_x] & WALL_NORTH && frac_y < 0.1) {
-                hit = 1;
-                wall_type = 0;
-            } else if (maze->cells[map_y][map_x] & WALL_SOUTH && frac_y > 0.9) {
-                hit = 1;
-                wall_type = 2;
-            } else if (maze->cells[map_y][map_x] & WALL_WEST && frac_x < 0.1) {
-                hit = 1;
-                wall_type = 3;
-            } else if (maze->cells[map_y][map_x] & WALL_EAST && frac_x > 0.9) {
-                hit = 1;
-                wall_type = 1;
+            // Puffy cloud shapes
+            CloudPuff *puff = &job.puffs[job.puff_count];
+            puff[0].x = cloud_x - 15 * cloud_size_mult;
+            puff[0].y = cloud_y;
+            puff[0].radius = 12.0 * cloud_size_mult;
+            puff[1].x = cloud_x;
+            puff[1].y = cloud_y - 8;
+            puff[1].radius = 14.0 * cloud_size_mult;
+            puff[2].x = cloud_x + 15 * cloud_size_mult;
+            puff[2].y = cloud_y;
+            puff[2].radius = 12.0 * cloud_size_mult;
+            for (int i = 0; i < 3; i++) {
+                puff[i].alpha = alpha_255(cloud_opacity);
             }
+            job.puff_count += 3;
         }
-        
-        // Fix fish-eye effect
-        dist = dist * cos(ray_angle - player->angle);
-        if (dist < 0.1) dist = 0.1;
-        
-        // Store wall distance for z-buffering
-        wall_distances[ray] = dist;
-        
-        // Store ray hit data
-        ray_hits[ray].wall_type = wall_type;
-        ray_hits[ray].hit_x = ray_x;
-        ray_hits[ray].hit_y = ray_y;
-        ray_hits[ray].dist = dist;
-        
-        // Calculate wall height
-        double wall_height = (vis->height / dist) * 0.5;
-        if (wall_height > vis->height * 2) wall_height = vis->height * 2;
-        
-        // Round positions to integer pixels
-        int top_y = (int)(half_height - wall_height / 2);
-        int height = (int)wall_height;
-        
-        // Distance-based brightness
-        double brightness = 1.0 / (1.0 + dist * 0.15);
-        brightness *= (1.0 + maze->audio_pulse * 0.3);
-        if (brightness > 1.0) brightness = 1.0;
-        
-        // Get base color for this wall direction
-        double r = maze->wall_colors[wall_type][0] * brightness;
-        double g = maze->wall_colors[wall_type][1] * brightness;
-        double b = maze->wall_colors[wall_type][2] * brightness;
-        
-        // Draw single pixel wide column
-        cairo_set_source_rgb(cr, r, g, b);
-        cairo_rectangle(cr, ray, top_y, 1, height);
-        cairo_fill(cr);
     }
     
-    // Draw wall decorations using stored hit data
+    // Wall decorations from the stored hit data, filled in column order
     int num_wall_bars = VIS_FREQUENCY_BARS;
+    maze->decoration_count = 0;
     
     for (int ray = 0; ray < num_rays; ray++) {
-        if (wall_distances[ray] > 0.5 && wall_distances[ray] < 10.0) {
+        if (ray_hits[ray].dist > 0.5 && ray_hits[ray].dist < 10.0) {
             int wall_type = ray_hits[ray].wall_type;
             double hit_x = ray_hits[ray].hit_x;
             double hit_y = ray_hits[ray].hit_y;
@@ -575,33 +921,16 @@ void draw_maze3d(Visualizer *vis, cairo_t *cr) {
                 double bar_bottom = center_y + bar_extend;
                 
                 // Multi-color gradient based on frequency
-                double hue = (double)bar_idx / num_wall_bars;
                 double bar_r, bar_g, bar_b;
-                
-                // Create rainbow spectrum
-                if (hue < 0.166) {
-                    bar_r = 1.0; bar_g = hue / 0.166; bar_b = 0.0;
-                } else if (hue < 0.333) {
-                    bar_r = 1.0 - (hue - 0.166) / 0.167; bar_g = 1.0; bar_b = 0.0;
-                } else if (hue < 0.5) {
-                    bar_r = 0.0; bar_g = 1.0; bar_b = (hue - 0.333) / 0.167;
-                } else if (hue < 0.666) {
-                    bar_r = 0.0; bar_g = 1.0 - (hue - 0.5) / 0.166; bar_b = 1.0;
-                } else if (hue < 0.833) {
-                    bar_r = (hue - 0.666) / 0.167; bar_g = 0.0; bar_b = 1.0;
-                } else {
-                    bar_r = 1.0; bar_g = 0.0; bar_b = 1.0 - (hue - 0.833) / 0.167;
-                }
+                wall_bar_color(bar_idx, num_wall_bars, &bar_r, &bar_g, &bar_b);
+                uint32_t bar_color = pack_rgb(bar_r, bar_g, bar_b);
                 
                 // Add glow effect
-                cairo_set_source_rgba(cr, bar_r, bar_g, bar_b, bar_intensity * 0.5);
-                cairo_rectangle(cr, ray - 1, bar_top - 2, 3, bar_bottom - bar_top + 4);
-                cairo_fill(cr);
+                add_decoration(maze, ray - 1, bar_top - 2, ray + 2, bar_bottom + 2,
+                                bar_color, bar_intensity * 0.5);
                 
                 // Draw bright core
-                cairo_set_source_rgba(cr, bar_r, bar_g, bar_b, 0.9);
-                cairo_rectangle(cr, ray, bar_top, 1, bar_bottom - bar_top);
-                cairo_fill(cr);
+                add_decoration(maze, ray, bar_top, ray + 1, bar_bottom, bar_color, 0.9);
             }
             
             // Draw oscilloscope on EAST walls (wall_type == 1)
@@ -610,26 +939,19 @@ void draw_maze3d(Visualizer *vis, cairo_t *cr) {
                 double sample = vis->audio_samples[sample_idx];
                 
                 double wave_y = center_y + sample * (wall_height * 0.4);
+                uint32_t wave_color = pack_rgb(0.2, 1.0, 0.8);
                 
                 // Draw grid lines
-                if ((int)ray % 32 == 0) {
-                    cairo_set_source_rgba(cr, 0.2, 0.2, 0.2, 0.3);
-                    cairo_move_to(cr, ray, top_y);
-                    cairo_line_to(cr, ray, top_y + height);
-                    cairo_stroke(cr);
+                if (ray % 32 == 0) {
+                    add_decoration(maze, ray - 0.75, top_y, ray + 0.75, top_y + height,
+                                    pack_rgb(0.2, 0.2, 0.2), 0.3);
                 }
                 
-                // Draw waveform line
-                cairo_set_source_rgba(cr, 0.2, 1.0, 0.8, 0.8);
-                cairo_set_line_width(cr, 1.5);
-                cairo_move_to(cr, ray, wave_y);
-                cairo_line_to(cr, ray + 1, wave_y);
-                cairo_stroke(cr);
+                // Draw waveform line, 1.5 pixels thick
+                add_decoration(maze, ray, wave_y - 0.75, ray + 1, wave_y + 0.75, wave_color, 0.8);
                 
-                // Add glow point
-                cairo_set_source_rgba(cr, 0.2, 1.0, 0.8, 0.6);
-                cairo_arc(cr, ray, wave_y, 1.0, 0, 2 * M_PI);
-                cairo_fill(cr);
+                // Add glow point: the pixels within one pixel of it
+                add_decoration(maze, ray - 1, wave_y - 0.866, ray + 1, wave_y + 0.866, wave_color, 0.6);
             }
             
             // Draw vertical bars on WEST walls (wall_type == 3)
@@ -640,30 +962,14 @@ void draw_maze3d(Visualizer *vis, cairo_t *cr) {
                 // Draw tall vertical bars across the wall
                 double bar_width = 2.0;
                 double bar_height = bar_intensity * height * 0.6;
-                double bar_x = ray;
                 double bar_top = center_y - bar_height * 0.5;
                 
                 // Rainbow colors
-                double hue = (double)bar_idx / num_wall_bars;
                 double bar_r, bar_g, bar_b;
+                wall_bar_color(bar_idx, num_wall_bars, &bar_r, &bar_g, &bar_b);
                 
-                if (hue < 0.166) {
-                    bar_r = 1.0; bar_g = hue / 0.166; bar_b = 0.0;
-                } else if (hue < 0.333) {
-                    bar_r = 1.0 - (hue - 0.166) / 0.167; bar_g = 1.0; bar_b = 0.0;
-                } else if (hue < 0.5) {
-                    bar_r = 0.0; bar_g = 1.0; bar_b = (hue - 0.333) / 0.167;
-                } else if (hue < 0.666) {
-                    bar_r = 0.0; bar_g = 1.0 - (hue - 0.5) / 0.166; bar_b = 1.0;
-                } else if (hue < 0.833) {
-                    bar_r = (hue - 0.666) / 0.167; bar_g = 0.0; bar_b = 1.0;
-                } else {
-                    bar_r = 1.0; bar_g = 0.0; bar_b = 1.0 - (hue - 0.833) / 0.167;
-                }
-                
-                cairo_set_source_rgba(cr, bar_r, bar_g, bar_b, 0.7);
-                cairo_rectangle(cr, bar_x, bar_top, bar_width, bar_height);
-                cairo_fill(cr);
+                add_decoration(maze, ray, bar_top, ray + bar_width, bar_top + bar_height,
+                                pack_rgb(bar_r, bar_g, bar_b), 0.7);
             }
             
             // Draw waveform on NORTH walls (wall_type == 0)
@@ -673,23 +979,27 @@ void draw_maze3d(Visualizer *vis, cairo_t *cr) {
                 double sample = vis->audio_samples[sample_idx];
                 
                 // Draw dark background
-                cairo_set_source_rgb(cr, 0.05, 0.05, 0.1);
-                cairo_rectangle(cr, ray, top_y, 1, height);
-                cairo_fill(cr);
+                add_decoration(maze, ray, top_y, ray + 1, top_y + height, pack_rgb(0.05, 0.05, 0.1), 1.0);
                 
-                // Draw centered waveform line
+                // Draw centered white waveform line
                 double wave_y = center_y + sample * (height * 0.35);
-                
-                // Draw white waveform with proper path
-                cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 0.8);
-                cairo_set_line_width(cr, 1.0);
-                cairo_move_to(cr, ray, wave_y);
-                cairo_line_to(cr, ray + 1, wave_y);
-                cairo_stroke(cr);
+                add_decoration(maze, ray, wave_y - 0.5, ray + 1, wave_y + 0.5, 0xFFFFFFFFu, 0.8);
             }
         }
     }
     
+    cairo_surface_flush(maze->frame);
+    job.frame.pixels = (uint32_t *)cairo_image_surface_get_data(maze->frame);
+    job.frame.stride = cairo_image_surface_get_stride(maze->frame) / 4;
+    job.frame.width = vis->width;
+    job.frame.row_begin = 0;
+    job.frame.row_end = vis->height;
+    maze_render_pool_run(&maze->render_pool, render_maze3d_band, &job, vis->height);
+    
+    cairo_surface_mark_dirty(maze->frame);
+    cairo_set_source_surface(cr, maze->frame, 0, 0);
+    cairo_paint(cr);
+    
 // In draw_maze3d function, replace the creature drawing calls with these:
 
 // Draw rats (replace existing rat drawing code)
@@ -712,7 +1022,7 @@ for (int i = 0; i < MAX_RATS; i++) {
         double screen_x = half_width + (angle_diff / (fov / 2.0)) * half_width;
         int rat_ray = (int)screen_x;
         
-        if (rat_ray >= 0 && rat_ray < num_rays && rat_dist < wall_distances[rat_ray]) {
+        if (rat_ray >= 0 && rat_ray < num_rays && rat_dist < ray_hits[rat_ray].dist) {
             draw_rat_3d(cr, screen_x, rat_dist, maze->rats[i].angle, maze->rats[i].bob_offset, half_height);
         }
     }
@@ -738,7 +1048,7 @@ for (int i = 0; i < MAX_ELEPHANTS; i++) {
         double screen_x = half_width + (angle_diff / (fov / 2.0)) * half_width;
         int elephant_ray = (int)screen_x;
         
-        if (elephant_ray >= 0 && elephant_ray < num_rays && elephant_dist < wall_distances[elephant_ray]) {
+        if (elephant_ray >= 0 && elephant_ray < num_rays && elephant_dist < ray_hits[elephant_ray].dist) {
             draw_elephant_3d(cr, screen_x, elephant_dist, maze->elephants[i].angle, maze->elephants[i].bob_offset, half_height);
         }
     }
@@ -759,16 +1069,12 @@ if (fabs(angle_diff) < fov / 2.0 && penguin_dist < 15.0) {
     int penguin_ray = (int)screen_x;
     
     // Only draw penguin if it's closer than the wall at this position
-    if (penguin_ray >= 0 && penguin_ray < num_rays && penguin_dist < wall_distances[penguin_ray]) {
+    if (penguin_ray >= 0 && penguin_ray < num_rays && penguin_dist < ray_hits[penguin_ray].dist) {
         draw_penguin_3d(cr, screen_x, penguin_dist, maze->penguin.scale,
                        maze->penguin.rotation, maze->penguin.bob_offset,
                        maze->penguin.found, maze->audio_pulse, half_height);
     }
 }
-    // Free the z-buffer and ray hits
-    free(wall_distances);
-    free(ray_hits);
-    
     // Draw minimap
     double minimap_size = 200;
     double minimap_x = vis->width - minimap_size - 20;
@@ -1,11 +1,17 @@
 #ifndef MAZE3D_H
 #define MAZE3D_H
 
+#include <stdint.h>
+#include <pthread.h>
+
 #define MAZE_WIDTH 16
 #define MAZE_HEIGHT 16
 #define MAX_PATH_LENGTH 256
 #define MAX_RATS 8
 #define MAX_ELEPHANTS 2
+#define MAZE_VIEW_DISTANCE 20.0   // Rays stop here if no wall is hit
+#define MAZE_RENDER_MAX_THREADS 8
+#define MAZE_RENDER_BAND_ROWS 64      // Rows per unit of render work
 
 typedef enum {
     WALL_NORTH = 1,
@@ -44,6 +50,44 @@ typedef struct {
     gboolean active;       // Is this entity active?
 } Creature;
 
+// What the ray through one screen column hit
+typedef struct {
+    int wall_type;
+    double hit_x;
+    double hit_y;
+    double dist;           // Corrected for fish-eye, also the column's z-buffer depth
+} RayHit;
+
+// A wall decoration, filled over the walls in the order they were added
+typedef struct {
+    float x0, y0, x1, y1;
+    uint32_t color;
+    uint32_t alpha;        // 0 to 255
+} MazeRect;
+
+typedef void (*MazeBandFunc)(void *data, int row_begin, int row_end);
+
+// Threads that help draw_maze3d() fill the frame, one band of rows at a
+// time. The drawing thread takes bands too and returns once every band is
+// done. Bands never share a pixel, so the frame comes out the same however
+// it was split.
+typedef struct {
+    pthread_t threads[MAZE_RENDER_MAX_THREADS];
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;         // Bands to take
+    pthread_cond_t finished;     // The last band of a frame is done
+    gboolean stop;
+
+    // Under lock
+    MazeBandFunc func;
+    void *data;
+    int rows;
+    int band_count;
+    int next_band;               // First band nobody has taken
+    int bands_left;              // Bands not finished, taken or not
+} MazeRenderPool;
+
 typedef struct {
     unsigned char cells[MAZE_HEIGHT][MAZE_WIDTH];  // Wall flags for each cell
     Point path[MAX_PATH_LENGTH];   // Solution path
@@ -64,6 +108,20 @@ typedef struct {
     double move_timer;             // Timer for automatic movement
     
     int exit_x, exit_y;            // Exit position (where penguin is)
+    
+    // Render buffers, kept until the window size changes
+    cairo_surface_t *frame;        // Sky, floor and walls are written straight into its pixels
+    int frame_width, frame_height;
+    RayHit *ray_hits;              // One per column
+    int *wall_top;                 // Rows each column's wall covers, clipped to the window
+    int *wall_bottom;
+    uint32_t *wall_color;
+    uint32_t *row_colors;          // Sky and floor gradient, one color per row
+    MazeRect *decorations;         // Up to three per column
+    int decoration_count;
+    
+    MazeRenderPool render_pool;
+    gboolean render_pool_started;
 } Maze3D;
 
 void draw_rat_3d(cairo_t *cr, double screen_x, double distance, double rotation, double bob_offset, double half_height);
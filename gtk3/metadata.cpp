@@ -3,68 +3,107 @@
 #include <stdio.h>
 #include <string.h>
 #include <glib.h>
+#include <mutex>
+#include "metadata_index.h"
 
-char* extract_metadata(const char *filepath) {
+// Copy a tag, cutting overlong text at a UTF-8 character boundary
+static void copy_tag_text(char *dest, const char *text) {
+    dest[0] = '\0';
+    if (!text) return;
+    size_t len = g_strlcpy(dest, text, TRACK_TEXT_MAX);
+    if (len >= TRACK_TEXT_MAX) {
+        len = TRACK_TEXT_MAX - 1;
+        while (len > 0 && ((unsigned char)dest[len] & 0xC0) == 0x80) len--;
+        dest[len] = '\0';
+    }
+}
+
+static void enable_thread_safe_strings(void) {
+    // TagLib otherwise keeps every returned string on one global list that
+    // isn't locked; each string is freed right after copying instead
+    taglib_set_string_management_enabled(FALSE);
+}
+
+bool read_track_metadata(const char *filepath, TrackMetadata *meta) {
+    static std::once_flag strings_once;
+    std::call_once(strings_once, enable_thread_safe_strings);
+
+    memset(meta, 0, sizeof(*meta));
     TagLib_File *file = taglib_file_new(filepath);
     if (!file || !taglib_file_is_valid(file)) {
         if (file) taglib_file_free(file);
-        return g_strdup("No metadata available");
+        return false;
     }
     
     TagLib_Tag *tag = taglib_file_tag(file);
-    const TagLib_AudioProperties *props = taglib_file_audioproperties(file);
-    
-    char metadata[1024] = "";
-    
     if (tag) {
-        const char *title = taglib_tag_title(tag);
-        const char *artist = taglib_tag_artist(tag);
-        const char *album = taglib_tag_album(tag);
-        const char *genre = taglib_tag_genre(tag);  // ADD THIS
-        unsigned int year = taglib_tag_year(tag);
-        
-        if (title && strlen(title) > 0)
-            snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
-                    "<b>Title:</b> %s\n", title);
-        if (artist && strlen(artist) > 0)
-            snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
-                    "<b>Artist:</b> %s\n", artist);
-        if (album && strlen(album) > 0)
-            snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
-                    "<b>Album:</b> %s\n", album);
-        if (genre && strlen(genre) > 0)  // ADD THIS
-            snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
-                    "<b>Genre:</b> %s\n", genre);
-        if (year > 0)
-            snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
-                    "<b>Year:</b> %u\n", year);
+        char *text = taglib_tag_title(tag);
+        copy_tag_text(meta->title, text);
+        taglib_free(text);
+        text = taglib_tag_artist(tag);
+        copy_tag_text(meta->artist, text);
+        taglib_free(text);
+        text = taglib_tag_album(tag);
+        copy_tag_text(meta->album, text);
+        taglib_free(text);
+        text = taglib_tag_genre(tag);
+        copy_tag_text(meta->genre, text);
+        taglib_free(text);
+        meta->year = taglib_tag_year(tag);
     }
     
+    const TagLib_AudioProperties *props = taglib_file_audioproperties(file);
     if (props) {
-        int duration = taglib_audioproperties_length(props);
-        int bitrate = taglib_audioproperties_bitrate(props);
-        int samplerate = taglib_audioproperties_samplerate(props);
-        int channels = taglib_audioproperties_channels(props);
-        
-        if (duration > 0) {
-            int minutes = duration / 60;
-            int seconds = duration % 60;
-            snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
-                    "<b>Duration:</b> %d:%02d\n", minutes, seconds);
-        }
-        
-        if (bitrate > 0)
-            snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
-                    "<b>Bitrate:</b> %d kbps\n", bitrate);
-        if (samplerate > 0)
-            snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
-                    "<b>Sample Rate:</b> %d Hz\n", samplerate);
-        if (channels > 0)
-            snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
-                    "<b>Channels:</b> %d\n", channels);
+        meta->duration = taglib_audioproperties_length(props);
+        meta->bitrate = taglib_audioproperties_bitrate(props);
+        meta->sample_rate = taglib_audioproperties_samplerate(props);
+        meta->channels = taglib_audioproperties_channels(props);
     }
     
     taglib_file_free(file);
+    return true;
+}
+
+char* extract_metadata(const char *filepath) {
+    TrackMetadata meta;
+    if (!read_track_metadata(filepath, &meta)) {
+        return g_strdup("No metadata available");
+    }
+    
+    char metadata[1024] = "";
+    
+    if (meta.title[0])
+        snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
+                "<b>Title:</b> %s\n", meta.title);
+    if (meta.artist[0])
+        snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
+                "<b>Artist:</b> %s\n", meta.artist);
+    if (meta.album[0])
+        snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
+                "<b>Album:</b> %s\n", meta.album);
+    if (meta.genre[0])
+        snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
+                "<b>Genre:</b> %s\n", meta.genre);
+    if (meta.year > 0)
+        snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
+                "<b>Year:</b> %u\n", meta.year);
+    
+    if (meta.duration > 0) {
+        int minutes = meta.duration / 60;
+        int seconds = meta.duration % 60;
+        snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
+                "<b>Duration:</b> %d:%02d\n", minutes, seconds);
+    }
+    
+    if (meta.bitrate > 0)
+        snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
+                "<b>Bitrate:</b> %d kbps\n", meta.bitrate);
+    if (meta.sample_rate > 0)
+        snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
+                "<b>Sample Rate:</b> %d Hz\n", meta.sample_rate);
+    if (meta.channels > 0)
+        snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
+                "<b>Channels:</b> %d\n", meta.channels);
     
     if (strlen(metadata) == 0) {
         return g_strdup("No metadata available");
@@ -74,19 +113,6 @@ char* extract_metadata(const char *filepath) {
 }
 
 int get_file_duration(const char *filepath) {
-    TagLib_File *file = taglib_file_new(filepath);
-    if (!file || !taglib_file_is_valid(file)) {
-        if (file) taglib_file_free(file);
-        return 0;
-    }
-    
-    const TagLib_AudioProperties *props = taglib_file_audioproperties(file);
-    int duration = 0;
-    
-    if (props) {
-        duration = taglib_audioproperties_length(props);
-    }
-    
-    taglib_file_free(file);
-    return duration;
+    TrackMetadata meta;
+    return read_track_metadata(filepath, &meta) ? meta.duration : 0;
 }
@@ -0,0 +1,361 @@
+#include "metadata_index.h"
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+char* extract_audio_from_zip(const char *zip_path);
+
+#define METADATA_INDEX_MAGIC "ZNMETA1"   // 8 bytes with the terminator
+
+// On-disk layout: this header, then count records of MetadataRecord each
+// followed by its five strings (path, title, artist, album, genre) as a
+// uint32_t length and the bytes, all in native byte order
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+} MetadataIndexHeader;
+
+typedef struct {
+    int64_t mtime;
+    int64_t size;
+    int64_t last_used;
+    uint32_t year;
+    int32_t duration;
+    int32_t bitrate;
+    int32_t sample_rate;
+    int32_t channels;
+    int32_t reserved;
+} MetadataRecord;
+
+typedef struct {
+    char *path;
+    int64_t mtime;
+    int64_t size;
+    int64_t last_used;
+    char *title;          // Strings are kept at their length, not TRACK_TEXT_MAX
+    char *artist;
+    char *album;
+    char *genre;
+    unsigned int year;
+    int duration;
+    int bitrate;
+    int sample_rate;
+    int channels;
+    bool checked;         // Matched against the file since the player started
+} MetadataIndexEntry;
+
+static void free_entry(gpointer data) {
+    MetadataIndexEntry *entry = (MetadataIndexEntry*)data;
+    g_free(entry->path);
+    g_free(entry->title);
+    g_free(entry->artist);
+    g_free(entry->album);
+    g_free(entry->genre);
+    g_free(entry);
+}
+
+static void entry_to_metadata(const MetadataIndexEntry *entry, TrackMetadata *meta) {
+    g_strlcpy(meta->title, entry->title, TRACK_TEXT_MAX);
+    g_strlcpy(meta->artist, entry->artist, TRACK_TEXT_MAX);
+    g_strlcpy(meta->album, entry->album, TRACK_TEXT_MAX);
+    g_strlcpy(meta->genre, entry->genre, TRACK_TEXT_MAX);
+    meta->year = entry->year;
+    meta->duration = entry->duration;
+    meta->bitrate = entry->bitrate;
+    meta->sample_rate = entry->sample_rate;
+    meta->channels = entry->channels;
+}
+
+static MetadataIndexEntry* entry_from_metadata(const char *path, int64_t mtime, int64_t size,
+                                               const TrackMetadata *meta) {
+    MetadataIndexEntry *entry = g_new0(MetadataIndexEntry, 1);
+    entry->path = g_strdup(path);
+    entry->mtime = mtime;
+    entry->size = size;
+    entry->last_used = (int64_t)time(NULL);
+    entry->title = g_strdup(meta->title);
+    entry->artist = g_strdup(meta->artist);
+    entry->album = g_strdup(meta->album);
+    entry->genre = g_strdup(meta->genre);
+    entry->year = meta->year;
+    entry->duration = meta->duration;
+    entry->bitrate = meta->bitrate;
+    entry->sample_rate = meta->sample_rate;
+    entry->channels = meta->channels;
+    entry->checked = true;
+    return entry;
+}
+
+static bool read_string(FILE *f, char **out) {
+    uint32_t len;
+    if (fread(&len, sizeof(len), 1, f) != 1 || len > 65536) return false;
+    char *text = (char*)g_malloc(len + 1);
+    if (len > 0 && fread(text, 1, len, f) != len) {
+        g_free(text);
+        return false;
+    }
+    text[len] = '\0';
+    *out = text;
+    return true;
+}
+
+static void append_string(GByteArray *image, const char *text) {
+    uint32_t len = (uint32_t)strlen(text);
+    g_byte_array_append(image, (const guint8*)&len, sizeof(len));
+    g_byte_array_append(image, (const guint8*)text, len);
+}
+
+// A damaged or foreign file just leaves the index empty; it is rebuilt
+// from the files as the queue shows them
+static void load_index(MetadataIndex *index) {
+    FILE *f = g_fopen(index->path, "rb");
+    if (!f) return;
+
+    MetadataIndexHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        memcmp(header.magic, METADATA_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != METADATA_INDEX_VERSION) {
+        printf("Metadata index: ignoring %s, unknown format\n", index->path);
+        fclose(f);
+        return;
+    }
+
+    for (uint32_t i = 0; i < header.count; i++) {
+        MetadataRecord record;
+        if (fread(&record, sizeof(record), 1, f) != 1) break;
+
+        MetadataIndexEntry *entry = g_new0(MetadataIndexEntry, 1);
+        if (!read_string(f, &entry->path) || !read_string(f, &entry->title) ||
+            !read_string(f, &entry->artist) || !read_string(f, &entry->album) ||
+            !read_string(f, &entry->genre)) {
+            free_entry(entry);
+            break;
+        }
+        entry->mtime = record.mtime;
+        entry->size = record.size;
+        entry->last_used = record.last_used;
+        entry->year = record.year;
+        entry->duration = record.duration;
+        entry->bitrate = record.bitrate;
+        entry->sample_rate = record.sample_rate;
+        entry->channels = record.channels;
+        g_hash_table_replace(index->entries, entry->path, entry);
+    }
+    fclose(f);
+}
+
+bool metadata_index_init(MetadataIndex *index) {
+    memset(index, 0, sizeof(*index));
+    pthread_mutex_init(&index->lock, NULL);
+    pthread_mutex_init(&index->save_lock, NULL);
+    index->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_entry);
+
+    char *directory = g_build_filename(g_get_user_cache_dir(), "zenamp", NULL);
+    if (g_mkdir_with_parents(directory, 0755) != 0) {
+        printf("Metadata index: cannot create %s, not saved\n", directory);
+        g_free(directory);
+        return false;
+    }
+    index->path = g_build_filename(directory, "metadata.idx", NULL);
+    g_free(directory);
+
+    load_index(index);
+    printf("Metadata index: %s, %u files\n", index->path, g_hash_table_size(index->entries));
+    return true;
+}
+
+static bool newer_first(const MetadataIndexEntry *a, const MetadataIndexEntry *b) {
+    return a->last_used > b->last_used;
+}
+
+// Caller holds the lock. Drops the least recently used entries beyond
+// METADATA_INDEX_MAX_ENTRIES and lays the rest out as the file holds them,
+// so the write itself needs no lock.
+static GByteArray* serialize_index(MetadataIndex *index) {
+    std::vector<MetadataIndexEntry*> entries;
+    entries.reserve(g_hash_table_size(index->entries));
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, index->entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        entries.push_back((MetadataIndexEntry*)value);
+    }
+    if (entries.size() > METADATA_INDEX_MAX_ENTRIES) {
+        std::sort(entries.begin(), entries.end(), newer_first);
+        for (size_t i = METADATA_INDEX_MAX_ENTRIES; i < entries.size(); i++) {
+            g_hash_table_remove(index->entries, entries[i]->path);
+        }
+        entries.resize(METADATA_INDEX_MAX_ENTRIES);
+    }
+
+    MetadataIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, METADATA_INDEX_MAGIC, sizeof(header.magic));
+    header.version = METADATA_INDEX_VERSION;
+    header.count = (uint32_t)entries.size();
+
+    GByteArray *image = g_byte_array_sized_new(sizeof(header) + entries.size() * 128);
+    g_byte_array_append(image, (const guint8*)&header, sizeof(header));
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        const MetadataIndexEntry *entry = entries[i];
+        MetadataRecord record;
+        memset(&record, 0, sizeof(record));
+        record.mtime = entry->mtime;
+        record.size = entry->size;
+        record.last_used = entry->last_used;
+        record.year = entry->year;
+        record.duration = entry->duration;
+        record.bitrate = entry->bitrate;
+        record.sample_rate = entry->sample_rate;
+        record.channels = entry->channels;
+        g_byte_array_append(image, (const guint8*)&record, sizeof(record));
+        append_string(image, entry->path);
+        append_string(image, entry->title);
+        append_string(image, entry->artist);
+        append_string(image, entry->album);
+        append_string(image, entry->genre);
+    }
+    return image;
+}
+
+// Written to a temporary file and renamed over the old one, so a crash
+// mid-save leaves the previous index intact
+static bool write_index(const char *path, const GByteArray *image) {
+    char *temp_path = g_strconcat(path, ".tmp", NULL);
+    FILE *f = g_fopen(temp_path, "wb");
+    if (!f) {
+        printf("Metadata index: cannot write %s\n", temp_path);
+        g_free(temp_path);
+        return false;
+    }
+
+    bool ok = fwrite(image->data, 1, image->len, f) == image->len;
+    ok = fclose(f) == 0 && ok;
+
+    if (ok) ok = g_rename(temp_path, path) == 0;
+    if (!ok) {
+        printf("Metadata index: cannot save %s\n", path);
+        g_unlink(temp_path);
+    }
+    g_free(temp_path);
+    return ok;
+}
+
+// The index is only locked while it is copied out, so lookups, including
+// metadata_index_peek() on the GUI thread, don't wait for the disk
+void metadata_index_flush(MetadataIndex *index) {
+    pthread_mutex_lock(&index->save_lock);
+
+    GByteArray *image = NULL;
+    char *path = NULL;
+    pthread_mutex_lock(&index->lock);
+    if (index->dirty && index->path) {
+        image = serialize_index(index);
+        path = g_strdup(index->path);
+        index->dirty = false;
+    }
+    pthread_mutex_unlock(&index->lock);
+
+    if (image) {
+        if (!write_index(path, image)) {
+            pthread_mutex_lock(&index->lock);
+            index->dirty = true;
+            pthread_mutex_unlock(&index->lock);
+        }
+        g_byte_array_free(image, TRUE);
+        g_free(path);
+    }
+
+    pthread_mutex_unlock(&index->save_lock);
+}
+
+void metadata_index_free(MetadataIndex *index) {
+    if (!index->entries) return;
+    metadata_index_flush(index);
+    printf("Metadata index: %llu hits, %llu files read\n",
+           (unsigned long long)index->hits, (unsigned long long)index->reads);
+
+    pthread_mutex_lock(&index->lock);
+    g_hash_table_destroy(index->entries);
+    index->entries = NULL;
+    g_free(index->path);
+    index->path = NULL;
+    pthread_mutex_unlock(&index->lock);
+}
+
+static bool has_zip_extension(const char *path) {
+    const char *ext = strrchr(path, '.');
+    return ext && g_ascii_strcasecmp(ext, ".zip") == 0;
+}
+
+// The audio inside a karaoke bundle, extracted to a temp file for TagLib
+static bool read_file_metadata(const char *filepath, TrackMetadata *meta) {
+    if (!has_zip_extension(filepath)) {
+        return read_track_metadata(filepath, meta);
+    }
+
+    memset(meta, 0, sizeof(*meta));
+    char *extracted_path = extract_audio_from_zip(filepath);
+    if (!extracted_path) return false;
+    bool ok = read_track_metadata(extracted_path, meta);
+    g_unlink(extracted_path);
+    g_free(extracted_path);
+    return ok;
+}
+
+bool metadata_index_get(MetadataIndex *index, const char *filepath, TrackMetadata *meta) {
+    GStatBuf st;
+    if (g_stat(filepath, &st) != 0) {
+        memset(meta, 0, sizeof(*meta));
+        return false;
+    }
+    int64_t mtime = (int64_t)st.st_mtime;
+    int64_t size = (int64_t)st.st_size;
+
+    pthread_mutex_lock(&index->lock);
+    MetadataIndexEntry *entry = index->entries ?
+        (MetadataIndexEntry*)g_hash_table_lookup(index->entries, filepath) : NULL;
+    if (entry && entry->mtime == mtime && entry->size == size) {
+        // The use order decides what is pruned on save, so it is saved too
+        entry->last_used = (int64_t)time(NULL);
+        entry->checked = true;
+        index->dirty = true;
+        entry_to_metadata(entry, meta);
+        index->hits++;
+        pthread_mutex_unlock(&index->lock);
+        return true;
+    }
+    pthread_mutex_unlock(&index->lock);
+
+    // Unreadable files are indexed too, so they aren't retried every refresh
+    read_file_metadata(filepath, meta);
+
+    pthread_mutex_lock(&index->lock);
+    if (index->entries) {
+        entry = entry_from_metadata(filepath, mtime, size, meta);
+        g_hash_table_replace(index->entries, entry->path, entry);
+        index->dirty = true;
+    }
+    index->reads++;
+    pthread_mutex_unlock(&index->lock);
+    return true;
+}
+
+bool metadata_index_peek(MetadataIndex *index, const char *filepath, TrackMetadata *meta) {
+    pthread_mutex_lock(&index->lock);
+    MetadataIndexEntry *entry = index->entries ?
+        (MetadataIndexEntry*)g_hash_table_lookup(index->entries, filepath) : NULL;
+    bool found = entry && entry->checked;
+    if (found) {
+        entry_to_metadata(entry, meta);
+        index->hits++;
+    }
+    pthread_mutex_unlock(&index->lock);
+    return found;
+}
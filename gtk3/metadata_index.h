@@ -0,0 +1,67 @@
+#ifndef METADATA_INDEX_H
+#define METADATA_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <glib.h>
+
+// Persistent index of the tags and duration of every file the queue shows,
+// so a refresh reads TagLib only for files that are new or have changed.
+// Entries are keyed by path, modification time and size (the same fields
+// the disk cache checks); a file whose mtime or size moved is read again.
+//
+// The index lives in memory while the player runs and is written to one
+// file under the user cache dir by metadata_index_flush(), so a batch of
+// lookups costs at most one write. Lookups may come from several threads;
+// the tag reading and the file writing happen outside the lock.
+
+#define METADATA_INDEX_VERSION      1
+#define METADATA_INDEX_MAX_ENTRIES  100000   // Least recently used beyond this are dropped on save
+#define TRACK_TEXT_MAX              256
+
+typedef struct {
+    char title[TRACK_TEXT_MAX];    // Empty when the file has no such tag
+    char artist[TRACK_TEXT_MAX];
+    char album[TRACK_TEXT_MAX];
+    char genre[TRACK_TEXT_MAX];
+    unsigned int year;
+    int duration;                  // Seconds, 0 when unknown
+    int bitrate;                   // kbps
+    int sample_rate;
+    int channels;
+} TrackMetadata;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_mutex_t save_lock;     // One save at a time, held without lock
+    GHashTable *entries;           // Path -> MetadataIndexEntry
+    char *path;                    // Index file, NULL if it can't be saved
+    bool dirty;                    // Changed since the last save
+
+    uint64_t hits;
+    uint64_t reads;
+} MetadataIndex;
+
+bool metadata_index_init(MetadataIndex *index);
+void metadata_index_free(MetadataIndex *index);
+
+// Metadata for filepath, from the index when the file is unchanged and read
+// from the file (and indexed) otherwise. Zip karaoke bundles are indexed
+// under the zip's own path with the tags of the audio inside. Returns false
+// with empty fields when the file can't be stat'ed.
+bool metadata_index_get(MetadataIndex *index, const char *filepath, TrackMetadata *meta);
+
+// Metadata for filepath if metadata_index_get() has already matched it
+// against the file since the player started; never touches the file, so
+// it is cheap enough for the GUI thread
+bool metadata_index_peek(MetadataIndex *index, const char *filepath, TrackMetadata *meta);
+
+// Write the index out if anything changed since the last save
+void metadata_index_flush(MetadataIndex *index);
+
+// Tags and audio properties from one TagLib open; false with empty fields
+// when TagLib can't read the file
+bool read_track_metadata(const char *filepath, TrackMetadata *meta);
+
+#endif // METADATA_INDEX_H
@@ -0,0 +1,150 @@
+#include "metadata_scanner.h"
+#include <stdio.h>
+#include <string.h>
+
+// Hand finished tracks to the callback, at most METADATA_SCAN_BATCH per run
+// so a burst of index hits doesn't stall the GUI in one go
+static gboolean deliver_results(gpointer data) {
+    MetadataScanner *scanner = (MetadataScanner*)data;
+
+    pthread_mutex_lock(&scanner->lock);
+    int count = (int)scanner->done->len;
+    if (count > METADATA_SCAN_BATCH) count = METADATA_SCAN_BATCH;
+    ScannedTrack *tracks = g_new(ScannedTrack, count > 0 ? count : 1);
+    memcpy(tracks, scanner->done->data, count * sizeof(ScannedTrack));
+    g_array_remove_range(scanner->done, 0, count);
+    bool more = scanner->done->len > 0;
+    if (!more) scanner->idle_id = 0;
+    pthread_mutex_unlock(&scanner->lock);
+
+    if (count > 0 && scanner->callback) {
+        scanner->callback(tracks, count, scanner->user_data);
+    }
+    for (int i = 0; i < count; i++) {
+        g_free(tracks[i].path);
+    }
+    g_free(tracks);
+    return more ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+static void* scanner_thread(void *arg) {
+    MetadataScanner *scanner = (MetadataScanner*)arg;
+
+    pthread_mutex_lock(&scanner->lock);
+    while (!scanner->stop) {
+        if (g_queue_is_empty(scanner->waiting)) {
+            pthread_cond_wait(&scanner->wake, &scanner->lock);
+            continue;
+        }
+
+        ScannedTrack track;
+        track.path = (char*)g_queue_pop_head(scanner->waiting);
+        scanner->busy++;
+        pthread_mutex_unlock(&scanner->lock);
+
+        metadata_index_get(scanner->index, track.path, &track.meta);
+
+        pthread_mutex_lock(&scanner->lock);
+        scanner->busy--;
+        g_hash_table_remove(scanner->queued, track.path);
+        g_array_append_val(scanner->done, track);
+        if (scanner->idle_id == 0) {
+            scanner->idle_id = g_idle_add(deliver_results, scanner);
+        }
+
+        // Last one out saves what the batch added to the index
+        if (g_queue_is_empty(scanner->waiting) && scanner->busy == 0) {
+            pthread_mutex_unlock(&scanner->lock);
+            metadata_index_flush(scanner->index);
+            pthread_mutex_lock(&scanner->lock);
+        }
+    }
+    pthread_mutex_unlock(&scanner->lock);
+    return NULL;
+}
+
+bool metadata_scanner_init(MetadataScanner *scanner, MetadataIndex *index,
+                           MetadataScanCallback callback, void *user_data) {
+    memset(scanner, 0, sizeof(*scanner));
+    pthread_mutex_init(&scanner->lock, NULL);
+    pthread_cond_init(&scanner->wake, NULL);
+    scanner->waiting = g_queue_new();
+    scanner->queued = g_hash_table_new(g_str_hash, g_str_equal);
+    scanner->done = g_array_new(FALSE, FALSE, sizeof(ScannedTrack));
+    scanner->index = index;
+    scanner->callback = callback;
+    scanner->user_data = user_data;
+
+    // Tag reading mostly waits on the disk, so even one core gets two
+    int wanted = (int)g_get_num_processors();
+    if (wanted < 2) wanted = 2;
+    if (wanted > METADATA_SCAN_MAX_THREADS) wanted = METADATA_SCAN_MAX_THREADS;
+    for (int i = 0; i < wanted; i++) {
+        if (pthread_create(&scanner->threads[i], NULL, scanner_thread, scanner) != 0) break;
+        scanner->thread_count++;
+    }
+
+    if (scanner->thread_count == 0) {
+        printf("Metadata scanner: cannot start worker threads\n");
+        return false;
+    }
+    printf("Metadata scanner: %d threads\n", scanner->thread_count);
+    return true;
+}
+
+void metadata_scanner_shutdown(MetadataScanner *scanner) {
+    if (!scanner->waiting) return;
+
+    pthread_mutex_lock(&scanner->lock);
+    scanner->stop = true;
+    pthread_cond_broadcast(&scanner->wake);
+    pthread_mutex_unlock(&scanner->lock);
+    for (int i = 0; i < scanner->thread_count; i++) {
+        pthread_join(scanner->threads[i], NULL);
+    }
+    scanner->thread_count = 0;
+
+    if (scanner->idle_id) {
+        g_source_remove(scanner->idle_id);
+        scanner->idle_id = 0;
+    }
+    for (guint i = 0; i < scanner->done->len; i++) {
+        g_free(g_array_index(scanner->done, ScannedTrack, i).path);
+    }
+    g_array_free(scanner->done, TRUE);
+    g_queue_free_full(scanner->waiting, g_free);
+    g_hash_table_destroy(scanner->queued);
+    scanner->done = NULL;
+    scanner->waiting = NULL;
+    scanner->queued = NULL;
+}
+
+void metadata_scanner_submit(MetadataScanner *scanner, const char *const *paths, int count) {
+    if (scanner->thread_count == 0 || count <= 0) return;
+
+    pthread_mutex_lock(&scanner->lock);
+    int added = 0;
+    for (int i = 0; i < count; i++) {
+        if (g_hash_table_contains(scanner->queued, paths[i])) continue;
+        char *path = g_strdup(paths[i]);
+        g_hash_table_add(scanner->queued, path);
+        g_queue_push_tail(scanner->waiting, path);
+        added++;
+    }
+    if (added > 0) {
+        pthread_cond_broadcast(&scanner->wake);
+    }
+    pthread_mutex_unlock(&scanner->lock);
+}
+
+void metadata_scanner_cancel(MetadataScanner *scanner) {
+    if (!scanner->waiting) return;
+
+    pthread_mutex_lock(&scanner->lock);
+    char *path;
+    while ((path = (char*)g_queue_pop_head(scanner->waiting)) != NULL) {
+        g_hash_table_remove(scanner->queued, path);
+        g_free(path);
+    }
+    pthread_mutex_unlock(&scanner->lock);
+}
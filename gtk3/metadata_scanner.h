@@ -0,0 +1,60 @@
+#ifndef METADATA_SCANNER_H
+#define METADATA_SCANNER_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <glib.h>
+#include "metadata_index.h"
+
+// Background tag and duration reading for the queue. The GUI thread hands
+// over batches of paths; a pool of workers looks each one up through the
+// metadata index (reading the file only when it is new or changed) and the
+// results come back on the GUI thread in batches, from one idle callback
+// that collects everything finished since it last ran.
+//
+// Workers take paths in the order they were submitted. A path is only
+// queued once while it is waiting or being read, however often it is
+// submitted. The index is saved whenever the workers run out of paths.
+
+#define METADATA_SCAN_MAX_THREADS  8
+#define METADATA_SCAN_BATCH        512   // Results handed to the callback per idle run
+
+typedef struct {
+    char *path;
+    TrackMetadata meta;
+} ScannedTrack;
+
+// Runs on the GUI thread. tracks and their paths are freed after it returns.
+typedef void (*MetadataScanCallback)(ScannedTrack *tracks, int count, void *user_data);
+
+typedef struct {
+    pthread_t threads[METADATA_SCAN_MAX_THREADS];
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool stop;
+
+    // Under lock
+    GQueue *waiting;              // Paths not picked up yet
+    GHashTable *queued;           // Paths waiting or being read
+    int busy;                     // Workers reading a file
+    GArray *done;                 // ScannedTrack not handed over yet
+    guint idle_id;                // Pending delivery, 0 if none
+
+    MetadataIndex *index;
+    MetadataScanCallback callback;
+    void *user_data;
+} MetadataScanner;
+
+bool metadata_scanner_init(MetadataScanner *scanner, MetadataIndex *index,
+                           MetadataScanCallback callback, void *user_data);
+void metadata_scanner_shutdown(MetadataScanner *scanner);
+
+// Queue paths for reading; they are copied
+void metadata_scanner_submit(MetadataScanner *scanner, const char *const *paths, int count);
+
+// Forget the paths nobody has picked up yet. Files being read still
+// report back.
+void metadata_scanner_cancel(MetadataScanner *scanner);
+
+#endif // METADATA_SCANNER_H
@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "midi_events.h"
+#include "midiplayer.h"
+
+// Parse-time cursor of one MTrk chunk
+typedef struct {
+    const uint8_t *pos;
+    const uint8_t *end;
+    uint32_t delay;       // Ticks until the next event is due
+    int status;           // Running status, -1 once the track has ended
+} TrackCursor;
+
+typedef struct {
+    MidiEventList *list;
+    uint32_t tick;
+    double seconds;
+    double tempo;         // Microseconds per quarter note
+    bool loop_start;
+    bool loop_end;
+    bool out_of_memory;
+} ParseState;
+
+static uint32_t read_big_endian(const uint8_t *p, int len) {
+    uint32_t value = 0;
+    for (int i = 0; i < len; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static bool read_var_len(TrackCursor *tc, uint32_t *value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        if (tc->pos >= tc->end) return false;
+        uint8_t c = *tc->pos++;
+        *value = (*value << 7) | (c & 0x7F);
+        if (!(c & 0x80)) return true;
+    }
+    return true;
+}
+
+static bool reserve_events(MidiEventList *list, int needed) {
+    if (needed <= list->capacity) return true;
+
+    int capacity = list->capacity ? list->capacity * 2 : 1024;
+    while (capacity < needed) capacity *= 2;
+
+    uint32_t *tick = (uint32_t*)realloc(list->tick, capacity * sizeof(uint32_t));
+    if (tick) list->tick = tick;
+    double *seconds = (double*)realloc(list->seconds, capacity * sizeof(double));
+    if (seconds) list->seconds = seconds;
+    uint8_t *status = (uint8_t*)realloc(list->status, capacity);
+    if (status) list->status = status;
+    uint8_t *data1 = (uint8_t*)realloc(list->data1, capacity);
+    if (data1) list->data1 = data1;
+    uint8_t *data2 = (uint8_t*)realloc(list->data2, capacity);
+    if (data2) list->data2 = data2;
+
+    if (!tick || !seconds || !status || !data1 || !data2) return false;
+    list->capacity = capacity;
+    return true;
+}
+
+// Insert at index, shifting later events up; index == count appends
+static bool insert_event(ParseState *ps, int index, uint8_t status, uint8_t data1, uint8_t data2) {
+    MidiEventList *list = ps->list;
+    if (!reserve_events(list, list->count + 1)) {
+        ps->out_of_memory = true;
+        return false;
+    }
+
+    int tail = list->count - index;
+    if (tail > 0) {
+        memmove(list->tick + index + 1, list->tick + index, tail * sizeof(uint32_t));
+        memmove(list->seconds + index + 1, list->seconds + index, tail * sizeof(double));
+        memmove(list->status + index + 1, list->status + index, tail);
+        memmove(list->data1 + index + 1, list->data1 + index, tail);
+        memmove(list->data2 + index + 1, list->data2 + index, tail);
+    }
+    list->tick[index] = ps->tick;
+    list->seconds[index] = ps->seconds;
+    list->status[index] = status;
+    list->data1[index] = data1;
+    list->data2[index] = data2;
+    list->count++;
+    return true;
+}
+
+static bool add_event(ParseState *ps, uint8_t status, uint8_t data1, uint8_t data2) {
+    return insert_event(ps, ps->list->count, status, data1, data2);
+}
+
+static bool handle_meta_event(ParseState *ps, TrackCursor *tc) {
+    if (tc->pos >= tc->end) return false;
+    uint8_t type = *tc->pos++;
+    uint32_t len;
+    if (!read_var_len(tc, &len) || len > (uint32_t)(tc->end - tc->pos)) return false;
+
+    const uint8_t *payload = tc->pos;
+    tc->pos += len;
+
+    if (type == META_END_OF_TRACK) {
+        return false;
+    } else if (type == META_TEMPO) {
+        if (len > 0 && len <= 4) {
+            ps->tempo = read_big_endian(payload, (int)len);
+        }
+    } else if (type == META_TEXT) {
+        // Text event - loop markers or custom instructions
+        char text[256];
+        size_t text_len = len < 255 ? len : 255;
+        memcpy(text, payload, text_len);
+        text[text_len] = '\0';
+
+        // Meta events carry no channel; the player always applied these
+        // commands to the low nibble of 0xFF, i.e. channel 15
+        int midCh = META_EVENT & 0x0F;
+
+        if (strcmp(text, "loopStart") == 0) {
+            ps->loop_start = true;
+        } else if (strcmp(text, "loopEnd") == 0) {
+            ps->loop_end = true;
+        } else if (strstr(text, "volume=") == text) {
+            int volume = atoi(text + 7);
+            if (volume >= 0 && volume <= 127) {
+                return add_event(ps, CONTROL_CHANGE | midCh, 7, (uint8_t)volume);
+            }
+        } else if (strstr(text, "instrument=") == text) {
+            int instrument = atoi(text + 11);
+            if (instrument >= 0 && instrument < 181) {
+                return add_event(ps, PROGRAM_CHANGE | midCh, (uint8_t)instrument, 0);
+            }
+        }
+    }
+    return true;
+}
+
+// Decode the event under the cursor and read the delay to the one after.
+// Returns false once the track ends, whether by an end-of-track event or by
+// running out of data.
+static bool handle_track_event(ParseState *ps, TrackCursor *tc) {
+    if (tc->pos >= tc->end) return false;
+
+    int status = *tc->pos;
+    if (status < 0x80) {
+        status = tc->status;   // Running status; the byte is data
+    } else {
+        tc->pos++;
+        tc->status = status;
+    }
+
+    size_t remaining = tc->end - tc->pos;
+    switch (status & 0xF0) {
+        case NOTE_OFF:
+        case NOTE_ON:
+        case CONTROL_CHANGE:
+        case PITCH_BEND: {
+            if (remaining < 2) return false;
+            uint8_t data1 = tc->pos[0], data2 = tc->pos[1];
+            tc->pos += 2;
+            if ((status & 0xF0) == NOTE_ON && data2 == 0) {
+                status = NOTE_OFF | (status & 0x0F);
+            }
+            if (!add_event(ps, (uint8_t)status, data1, data2)) return false;
+            break;
+        }
+
+        case PROGRAM_CHANGE:
+        case CHAN_PRESSURE: {
+            if (remaining < 1) return false;
+            if (!add_event(ps, (uint8_t)status, tc->pos[0], 0)) return false;
+            tc->pos += 1;
+            break;
+        }
+
+        case SYSTEM_MESSAGE: {
+            if (status == META_EVENT) {
+                if (!handle_meta_event(ps, tc)) return false;
+            } else {
+                // System exclusive - skip
+                uint32_t len;
+                if (!read_var_len(tc, &len) || len > (uint32_t)(tc->end - tc->pos)) return false;
+                tc->pos += len;
+            }
+            break;
+        }
+
+        default: {
+            // Poly pressure, or data before any status byte; the player
+            // ignores both, assume two data bytes
+            if (remaining < 2) return false;
+            tc->pos += 2;
+            break;
+        }
+    }
+
+    uint32_t delay;
+    if (!read_var_len(tc, &delay)) return false;
+    tc->delay += delay;
+    return true;
+}
+
+// Merge the tracks. Every step hands one due event from each track to the
+// list, in track order, then advances to the next due tick; that is the
+// order the player always dispatched events in, so events sharing a tick
+// keep their relative order.
+static bool merge_tracks(ParseState *ps, TrackCursor *tracks, int track_count, int division) {
+    for (;;) {
+        int step_first = ps->list->count;
+
+        for (int tk = 0; tk < track_count; tk++) {
+            if (tracks[tk].status >= 0 && tracks[tk].delay == 0) {
+                if (!handle_track_event(ps, &tracks[tk])) {
+                    tracks[tk].status = -1;
+                }
+            }
+        }
+
+        // A loop point restarts the whole step it was found in
+        if (ps->loop_start) {
+            if (!insert_event(ps, step_first, META_EVENT, MIDI_MARKER_LOOP_START, 0)) return false;
+            ps->loop_start = false;
+        } else if (ps->loop_end) {
+            if (!add_event(ps, META_EVENT, MIDI_MARKER_LOOP_END, 0)) return false;
+            ps->loop_end = false;
+        }
+
+        bool any_active = false;
+        uint32_t next_delay = 0;
+        for (int tk = 0; tk < track_count; tk++) {
+            if (tracks[tk].status < 0) continue;
+            if (!any_active || tracks[tk].delay < next_delay) {
+                next_delay = tracks[tk].delay;
+            }
+            any_active = true;
+        }
+        if (!any_active || ps->out_of_memory) {
+            ps->list->duration = ps->seconds;
+            return !ps->out_of_memory;
+        }
+
+        for (int tk = 0; tk < track_count; tk++) {
+            tracks[tk].delay -= next_delay;
+        }
+        ps->tick += next_delay;
+        ps->seconds += next_delay * ps->tempo / (division * 1000000.0);
+    }
+}
+
+bool midi_events_parse(MidiEventList *list, const uint8_t *data, size_t size) {
+    midi_events_free(list);
+
+    if (size < 14 || memcmp(data, "MThd", 4) != 0) {
+        fprintf(stderr, "Error: Not a valid MIDI file\n");
+        return false;
+    }
+    if (read_big_endian(data + 4, 4) != 6) {
+        fprintf(stderr, "Error: Invalid MIDI header length\n");
+        return false;
+    }
+
+    list->format = (int)read_big_endian(data + 8, 2);
+    list->track_count = (int)read_big_endian(data + 10, 2);
+    list->division = (int)read_big_endian(data + 12, 2);
+    if (list->track_count > MAX_TRACKS) {
+        fprintf(stderr, "Error: Too many tracks in MIDI file\n");
+        return false;
+    }
+    if (list->division == 0 || (list->division & 0x8000)) {
+        fprintf(stderr, "Error: Unsupported MIDI time division\n");
+        return false;
+    }
+
+    TrackCursor tracks[MAX_TRACKS];
+    const uint8_t *p = data + 14;
+    const uint8_t *end = data + size;
+    for (int tk = 0; tk < list->track_count; tk++) {
+        if (end - p < 8 || memcmp(p, "MTrk", 4) != 0) {
+            fprintf(stderr, "Error: Invalid track header\n");
+            return false;
+        }
+        uint32_t length = read_big_endian(p + 4, 4);
+        p += 8;
+        if (length > (uint32_t)(end - p)) {
+            length = (uint32_t)(end - p);   // Truncated file, play what's there
+        }
+
+        TrackCursor *tc = &tracks[tk];
+        tc->pos = p;
+        tc->end = p + length;
+        tc->status = 0;
+        tc->delay = 0;
+        if (!read_var_len(tc, &tc->delay)) {
+            tc->status = -1;
+        }
+        p += length;
+    }
+
+    ParseState ps;
+    ps.list = list;
+    ps.tick = 0;
+    ps.seconds = 0;
+    ps.tempo = 500000;   // Default 120 BPM
+    ps.loop_start = false;
+    ps.loop_end = false;
+    ps.out_of_memory = false;
+
+    if (!merge_tracks(&ps, tracks, list->track_count, list->division)) {
+        fprintf(stderr, "Error: Out of memory decoding MIDI events\n");
+        midi_events_free(list);
+        return false;
+    }
+    return true;
+}
+
+bool midi_events_load(MidiEventList *list, const char *filename) {
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Could not open file %s\n", filename);
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *data = size > 0 ? (uint8_t*)malloc(size) : NULL;
+    bool ok = data && fread(data, 1, size, f) == (size_t)size;
+    fclose(f);
+
+    if (!ok) {
+        fprintf(stderr, "Error: Could not read file %s\n", filename);
+        free(data);
+        return false;
+    }
+
+    ok = midi_events_parse(list, data, size);
+    free(data);
+    return ok;
+}
+
+void midi_events_free(MidiEventList *list) {
+    free(list->tick);
+    free(list->seconds);
+    free(list->status);
+    free(list->data1);
+    free(list->data2);
+    memset(list, 0, sizeof(*list));
+}
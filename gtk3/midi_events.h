@@ -0,0 +1,46 @@
+#ifndef MIDI_EVENTS_H
+#define MIDI_EVENTS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// A Standard MIDI File decoded once into a flat list of channel events, so
+// playback is a linear walk over memory instead of seeking and reading the
+// file for every event.
+//
+// Events are stored as parallel arrays in dispatch order: sorted by time,
+// and within one tick interleaved across tracks the same way the old
+// per-track cursors visited them. Tempo changes are applied while parsing,
+// so every event carries its absolute time in seconds and no tempo events
+// remain. Running status is resolved, note-on with velocity 0 becomes a
+// note-off, and the "volume=XX"/"instrument=XX" text commands become the
+// controller/program change they stand for. Everything the player ignores
+// (sysex, other meta events, poly pressure) is dropped.
+//
+// "loopStart"/"loopEnd" text events are kept as markers with status
+// META_EVENT and one of the MIDI_MARKER_* codes in data1.
+
+#define MIDI_MARKER_LOOP_START  1
+#define MIDI_MARKER_LOOP_END    2
+
+typedef struct {
+    int count;
+    int capacity;
+    uint32_t *tick;       // Absolute tick
+    double *seconds;      // Absolute time with the tempo map applied
+    uint8_t *status;      // Type in the high nibble, channel in the low
+    uint8_t *data1;
+    uint8_t *data2;
+
+    int format;
+    int track_count;
+    int division;         // Ticks per quarter note
+    double duration;      // Time the last track ends, at or after the last event
+} MidiEventList;
+
+bool midi_events_load(MidiEventList *list, const char *filename);
+bool midi_events_parse(MidiEventList *list, const uint8_t *data, size_t size);
+void midi_events_free(MidiEventList *list);
+
+#endif // MIDI_EVENTS_H
@@ -0,0 +1,487 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include "midi_renderer.h"
+#include "midiplayer.h"
+
+MidiRenderer* midi_renderer_new(int sample_rate, int volume) {
+    MidiRenderer *r = new MidiRenderer();   // Zeroed, so the synth starts empty
+    r->sample_rate = sample_rate;
+    r->volume = volume;
+    opl_synth_init(&r->opl, sample_rate);
+    return r;
+}
+
+void midi_renderer_free(MidiRenderer *r) {
+    if (!r) return;
+    midi_events_free(&r->events);
+    free(r->snapshots);
+    free(r->snapshot_notes);
+    opl_synth_free(&r->opl);
+    delete r;
+}
+
+// Apply one decoded channel event
+static void dispatch_event(MidiRenderer *r, uint8_t status, uint8_t data1, uint8_t data2) {
+    int midCh = status & 0x0F;
+    OPLSynth *opl = &r->opl;
+    
+    // Handle different event types
+    switch (status & 0xF0) {
+        case NOTE_OFF: {
+            // Note Off event; note on with velocity 0 arrives as this too
+            r->ch_bend[midCh] = 0;
+            opl_synth_note_off(opl, midCh, data1);
+            break;
+        }
+        
+        case NOTE_ON: {
+            opl_synth_note_on(opl, midCh, data1, data2);
+            break;
+        }
+        
+        case CONTROL_CHANGE: {
+            // Control Change
+            switch (data1) {
+                case 1:  // Modulation Wheel
+                    r->ch_vibrato[midCh] = data2;
+                    // Implementation depends on dbopl_wrapper.cpp supporting this
+                    // We could add a new function: OPL_SetModulation(midCh, data2);
+                    break;
+                    
+                case 6:  // Data Entry MSB (for RPN/NRPN)
+                    // Could be used for fine pitch control
+                    break;
+                    
+                case 7:  // Channel Volume
+                    r->ch_volume[midCh] = data2;
+                    opl_synth_set_volume(opl, midCh, data2);
+                    break;
+                    
+                case 10: // Pan
+                    r->ch_panning[midCh] = data2;
+                    opl_synth_set_pan(opl, midCh, data2);
+                    break;
+                    
+                case 11: // Expression
+                    // Expression is like a secondary volume control
+                    // We could scale the existing volume by this value
+                    for (int i = 0; i < opl->voice_count; i++) {
+                        if (opl->channels[i].active && opl->channels[i].midi_channel == midCh) {
+                            opl_synth_set_channel_volume(opl, i, opl->channels[i].velocity, 
+                                                         (r->ch_volume[midCh] * data2) / 127);
+                        }
+                    }
+                    break;
+                    
+                case 64: // Sustain Pedal
+                    // Implement sustain by delaying note-offs
+                    // This would require tracking sustained notes
+                    break;
+                    
+                case 71: // Sound Controller 2 - Resonance/Timbre
+                    // Could adjust FM feedback parameters
+                    break;
+                    
+                case 72: // Sound Controller 3 - Release Time
+                    // Could adjust envelope release rate
+                    break;
+                    
+                case 73: // Sound Controller 4 - Attack Time
+                    // Could adjust envelope attack rate
+                    break;
+                    
+                case 74: // Sound Controller 5 - Brightness
+                    // Could adjust FM modulation index or carrier frequency
+                    break;
+                    
+                case 91: // Effects 1 Depth (Reverb)
+                    // Could implement basic reverb simulation
+                    break;
+                    
+                case 93: // Effects 3 Depth (Chorus)
+                    // Could implement chorus effect through slight detuning
+                    break;
+                    
+                case 120: // All Sound Off
+                    // Immediately silence all sound (emergency)
+                    opl_synth_reset(opl);
+                    break;
+                    
+                case 121: // Reset All Controllers
+                    // Reset controllers to default
+                    for (int i = 0; i < 16; i++) {
+                        r->ch_bend[i] = 0;
+                        r->ch_vibrato[i] = 0;
+                        // Don't reset volume and panning
+                    }
+                    break;
+                    
+                case 123: // All Notes Off
+                    // Turn off all notes on this channel
+                    for (int i = 0; i < opl->voice_count; i++) {
+                        if (opl->channels[i].active && opl->channels[i].midi_channel == midCh) {
+                            opl_synth_note_off(opl, midCh, opl->channels[i].midi_note);
+                        }
+                    }
+                    break;
+            }
+            break;
+        }
+        
+        case PROGRAM_CHANGE: {
+            // Program Change
+            r->ch_patch[midCh] = data1;
+            opl_synth_program_change(opl, midCh, data1);
+            break;
+        }
+        
+        case CHAN_PRESSURE: {
+            // Channel Aftertouch
+            // Could apply pressure to all active notes on this channel
+            // Similar to expression control
+            for (int i = 0; i < opl->voice_count; i++) {
+                if (opl->channels[i].active && opl->channels[i].midi_channel == midCh) {
+                    // Apply aftertouch as a volume scaling
+                    opl_synth_set_channel_volume(opl, i, opl->channels[i].velocity, 
+                                                 (r->ch_volume[midCh] * data1) / 127);
+                }
+            }
+            break;
+        }
+        
+        case PITCH_BEND: {
+            // Pitch Bend
+            // Combine LSB and MSB into a 14-bit value
+            int bend = (data2 << 7) | data1;
+            r->ch_bend[midCh] = bend;
+            
+            opl_synth_set_pitch_bend(opl, midCh, bend);
+            break;
+        }
+    }
+}
+
+// Either loop or stop playback once every event has been played
+static void end_of_events(MidiRenderer *r) {
+    if (r->loop_wait > 0) {
+        r->event_cursor = r->loop_cursor;
+        r->event_time = r->loop_time;
+        r->play_wait = r->loop_wait;
+    } else {
+        r->playing = false;
+    }
+}
+
+// Loop markers jump back within the event list; no file access here
+void midi_renderer_process_events(MidiRenderer *r) {
+    const MidiEventList *events = &r->events;
+    double now = r->event_time;
+    
+    while (r->event_cursor < events->count && events->seconds[r->event_cursor] <= now) {
+        int ev = r->event_cursor++;
+        uint8_t status = events->status[ev];
+        
+        if (status != META_EVENT) {
+            dispatch_event(r, status, events->data1[ev], events->data2[ev]);
+        } else if (events->data1[ev] == MIDI_MARKER_LOOP_START) {
+            // Save loop beginning point
+            r->loop_cursor = ev;
+            r->loop_time = now;
+            r->loop_wait = r->play_wait;
+        } else if (r->loop_time < now) {
+            // Return to loop beginning; an empty loop would never advance
+            r->event_cursor = r->loop_cursor;
+            r->event_time = r->loop_time;
+            r->play_wait = r->loop_wait;
+            return;
+        }
+    }
+    
+    // The song lasts until its last track ends, which can be after the
+    // last event
+    double next = r->event_cursor < events->count ? events->seconds[r->event_cursor] : events->duration;
+    if (r->event_cursor >= events->count && next <= now) {
+        end_of_events(r);
+        return;
+    }
+    
+    // Schedule next event
+    r->play_wait += next - now;
+    r->event_time = next;
+}
+
+// Channel and chip state as at the very start of the song
+static void reset_state(MidiRenderer *r) {
+    for (int i = 0; i < 16; i++) {
+        r->ch_patch[i] = 0;
+        r->ch_bend[i] = 0;
+        r->ch_volume[i] = 127;
+        r->ch_panning[i] = 64;
+        r->ch_vibrato[i] = 0;
+    }
+    memset(r->held, 0, sizeof(r->held));
+    opl_synth_init(&r->opl, r->sample_rate);
+    
+    r->loop_cursor = 0;
+    r->loop_time = 0;
+    r->loop_wait = 0;
+}
+
+// What play_wait holds when playback from the start dispatches the batch at
+// seconds: midi_renderer_render() renders whole samples, leaving up to half
+// a sample either way
+static double dispatch_wait(const MidiRenderer *r, double seconds) {
+    double due = seconds * r->sample_rate;
+    return (due - floor(due + 0.5)) / r->sample_rate;
+}
+
+// Apply the events from ev up to, not including, seconds without
+// synthesising anything. Program, controller and pitch bend changes go to
+// the channels as usual; notes are only tracked in held. Returns the first
+// event not applied.
+static int replay_events(MidiRenderer *r, int ev, double seconds) {
+    const MidiEventList *events = &r->events;
+    
+    for (; ev < events->count && events->seconds[ev] < seconds; ev++) {
+        uint8_t status = events->status[ev];
+        uint8_t data1 = events->data1[ev];
+        int midCh = status & 0x0F;
+        
+        if (status == META_EVENT) {
+            // Playback is linear up to the seek point, only loop starts matter
+            if (data1 == MIDI_MARKER_LOOP_START) {
+                r->loop_cursor = ev;
+                r->loop_time = events->seconds[ev];
+                r->loop_wait = dispatch_wait(r, events->seconds[ev]);
+            }
+            continue;
+        }
+        
+        switch (status & 0xF0) {
+            case NOTE_ON:
+                r->held[midCh][data1 & 0x7F] = events->data2[ev];
+                break;
+                
+            case NOTE_OFF:
+                r->held[midCh][data1 & 0x7F] = 0;
+                r->ch_bend[midCh] = 0;
+                break;
+                
+            case CONTROL_CHANGE:
+                if (data1 == 120) memset(r->held, 0, sizeof(r->held));
+                else if (data1 == 123) memset(r->held[midCh], 0, sizeof(r->held[midCh]));
+                dispatch_event(r, status, data1, events->data2[ev]);
+                break;
+                
+            default:
+                dispatch_event(r, status, data1, events->data2[ev]);
+                break;
+        }
+    }
+    return ev;
+}
+
+static bool save_snapshot(MidiRenderer *r, MidiSnapshot *snap, double seconds, int ev) {
+    snap->seconds = seconds;
+    snap->event_cursor = ev;
+    snap->loop_cursor = r->loop_cursor;
+    snap->loop_time = r->loop_time;
+    snap->loop_wait = r->loop_wait;
+    memcpy(snap->ch_patch, r->ch_patch, sizeof(snap->ch_patch));
+    memcpy(snap->ch_bend, r->ch_bend, sizeof(snap->ch_bend));
+    memcpy(snap->ch_volume, r->ch_volume, sizeof(snap->ch_volume));
+    memcpy(snap->ch_panning, r->ch_panning, sizeof(snap->ch_panning));
+    memcpy(snap->ch_vibrato, r->ch_vibrato, sizeof(snap->ch_vibrato));
+    memcpy(snap->opl_program, r->opl.program, sizeof(snap->opl_program));
+    memcpy(snap->opl_volume, r->opl.volume, sizeof(snap->opl_volume));
+    memcpy(snap->opl_pan, r->opl.pan, sizeof(snap->opl_pan));
+    
+    // Held notes go to the shared pool, usually only a handful
+    snap->held_first = r->snapshot_note_count;
+    snap->held_count = 0;
+    for (int ch = 0; ch < 16; ch++) {
+        for (int note = 0; note < 128; note++) {
+            if (!r->held[ch][note]) continue;
+            
+            if (r->snapshot_note_count == r->snapshot_note_capacity) {
+                int capacity = r->snapshot_note_capacity ? r->snapshot_note_capacity * 2 : 256;
+                MidiHeldNote *notes = (MidiHeldNote*)realloc(r->snapshot_notes, capacity * sizeof(MidiHeldNote));
+                if (!notes) return false;
+                r->snapshot_notes = notes;
+                r->snapshot_note_capacity = capacity;
+            }
+            MidiHeldNote *held = &r->snapshot_notes[r->snapshot_note_count++];
+            held->channel = (uint8_t)ch;
+            held->note = (uint8_t)note;
+            held->velocity = r->held[ch][note];
+            snap->held_count++;
+        }
+    }
+    return true;
+}
+
+// Expects the state reset_state() leaves; returns the first event to replay
+static int restore_snapshot(MidiRenderer *r, const MidiSnapshot *snap) {
+    r->loop_cursor = snap->loop_cursor;
+    r->loop_time = snap->loop_time;
+    r->loop_wait = snap->loop_wait;
+    memcpy(r->ch_patch, snap->ch_patch, sizeof(r->ch_patch));
+    memcpy(r->ch_bend, snap->ch_bend, sizeof(r->ch_bend));
+    memcpy(r->ch_volume, snap->ch_volume, sizeof(r->ch_volume));
+    memcpy(r->ch_panning, snap->ch_panning, sizeof(r->ch_panning));
+    memcpy(r->ch_vibrato, snap->ch_vibrato, sizeof(r->ch_vibrato));
+    memcpy(r->opl.program, snap->opl_program, sizeof(r->opl.program));
+    memcpy(r->opl.volume, snap->opl_volume, sizeof(r->opl.volume));
+    memcpy(r->opl.pan, snap->opl_pan, sizeof(r->opl.pan));
+    
+    for (int i = 0; i < snap->held_count; i++) {
+        const MidiHeldNote *held = &r->snapshot_notes[snap->held_first + i];
+        r->held[held->channel][held->note] = held->velocity;
+    }
+    return snap->event_cursor;
+}
+
+// One replay over the whole song, saving the state every
+// MIDI_SNAPSHOT_INTERVAL seconds. Without the index seeks still work, they
+// just replay from the start.
+static void build_snapshots(MidiRenderer *r) {
+    free(r->snapshots);
+    free(r->snapshot_notes);
+    r->snapshots = NULL;
+    r->snapshot_notes = NULL;
+    r->snapshot_count = 0;
+    r->snapshot_note_count = 0;
+    r->snapshot_note_capacity = 0;
+    
+    int count = (int)(r->events.duration / MIDI_SNAPSHOT_INTERVAL) + 1;
+    r->snapshots = (MidiSnapshot*)malloc(count * sizeof(MidiSnapshot));
+    if (!r->snapshots) {
+        fprintf(stderr, "Warning: No memory for the MIDI seek index\n");
+        return;
+    }
+    
+    reset_state(r);
+    int ev = 0;
+    for (int i = 0; i < count; i++) {
+        double seconds = i * MIDI_SNAPSHOT_INTERVAL;
+        ev = replay_events(r, ev, seconds);
+        if (!save_snapshot(r, &r->snapshots[i], seconds, ev)) {
+            fprintf(stderr, "Warning: No memory for the MIDI seek index\n");
+            break;
+        }
+        r->snapshot_count = i + 1;
+    }
+}
+
+// Restore the last snapshot at or before seconds and replay the few events
+// after it. Notes held at that point are struck again so sustained parts
+// don't drop out until their next note-on; percussion is left alone.
+void midi_renderer_seek(MidiRenderer *r, double seconds) {
+    const MidiEventList *events = &r->events;
+    
+    if (seconds < 0) seconds = 0;
+    if (seconds > events->duration) seconds = events->duration;
+    
+    reset_state(r);
+    int ev = 0;
+    if (r->snapshot_count > 0) {
+        int index = (int)(seconds / MIDI_SNAPSHOT_INTERVAL);
+        if (index >= r->snapshot_count) index = r->snapshot_count - 1;
+        ev = restore_snapshot(r, &r->snapshots[index]);
+    }
+    ev = replay_events(r, ev, seconds);
+    
+    for (int ch = 0; ch < 16; ch++) {
+        if (ch == 9) continue;
+        for (int note = 0; note < 128; note++) {
+            if (r->held[ch][note]) {
+                opl_synth_note_on(&r->opl, ch, note, r->held[ch][note]);
+            }
+        }
+    }
+    
+    // Whatever falls on the seek point itself goes out with the first sample
+    r->event_cursor = ev;
+    r->event_time = ev < events->count ? events->seconds[ev] : events->duration;
+    r->play_time = seconds;
+    r->play_wait = r->event_time - seconds;
+    r->playing = true;
+}
+
+void midi_renderer_rewind(MidiRenderer *r) {
+    midi_renderer_seek(r, 0);
+}
+
+static bool finish_load(MidiRenderer *r, const char *name) {
+    printf("MIDI file loaded: %s\n", name);
+    printf("Format: %d, Tracks: %d, Time Division: %d, Events: %d\n",
+           r->events.format, r->events.track_count, r->events.division, r->events.count);
+    
+    build_snapshots(r);
+    midi_renderer_rewind(r);
+    return true;
+}
+
+bool midi_renderer_load(MidiRenderer *r, const char *filename) {
+    if (!midi_events_load(&r->events, filename)) {
+        r->playing = false;
+        return false;
+    }
+    return finish_load(r, filename);
+}
+
+bool midi_renderer_load_data(MidiRenderer *r, const uint8_t *data, size_t size, const char *name) {
+    if (!midi_events_parse(&r->events, data, size)) {
+        r->playing = false;
+        return false;
+    }
+    return finish_load(r, name);
+}
+
+static uint64_t elapsed_ns(std::chrono::steady_clock::time_point since) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - since).count();
+}
+
+// Events land on the nearest sample: the block is rendered in spans that
+// end where the next batch of events is due, so note timing no longer snaps
+// to the caller's buffer size. Quiet stretches still go to the chip in one
+// call per block.
+int midi_renderer_render(MidiRenderer *r, int16_t *buffer, int frames) {
+    int done = 0;
+    
+    while (done < frames && r->playing) {
+        // Dispatch every batch due before the middle of the next sample
+        double due = r->play_wait * r->sample_rate;
+        if (due < 0.5) {
+            if (r->profile) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                midi_renderer_process_events(r);
+                r->dispatch_ns += elapsed_ns(start);
+            } else {
+                midi_renderer_process_events(r);
+            }
+            continue;
+        }
+        
+        int span = frames - done;
+        if (due < span) span = (int)(due + 0.5);
+        if (r->profile) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            opl_synth_generate(&r->opl, buffer + done * AUDIO_CHANNELS, span, r->volume);
+            r->synth_ns += elapsed_ns(start);
+        } else {
+            opl_synth_generate(&r->opl, buffer + done * AUDIO_CHANNELS, span, r->volume);
+        }
+        
+        // Subtracting the exact span keeps rounding from building up
+        double duration = (double)span / r->sample_rate;
+        r->play_time += duration;
+        r->play_wait -= duration;
+        done += span;
+    }
+    return done;
+}
@@ -0,0 +1,108 @@
+#ifndef MIDI_RENDERER_H
+#define MIDI_RENDERER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "midi_events.h"
+#include "dbopl_wrapper.h"
+
+// Everything needed to turn one MIDI file into PCM: the decoded events,
+// the playback position, MIDI channel state and a private OPL3 chip. No
+// globals are touched, so separate renderers can convert separate files on
+// separate threads at once.
+
+#define MIDI_SNAPSHOT_INTERVAL  5.0   // Seconds of song between seek snapshots
+
+typedef struct {
+    uint8_t channel;
+    uint8_t note;
+    uint8_t velocity;
+} MidiHeldNote;
+
+// Channel state at one point of the song, as a seek needs it. The OPL chip
+// itself isn't saved: seeking starts from a fresh chip and strikes the held
+// notes again, so the program, volume and pan settings are all it needs.
+typedef struct {
+    double seconds;
+    int event_cursor;        // First event after the snapshot
+    int loop_cursor;
+    double loop_time;
+    double loop_wait;
+    int ch_patch[16];
+    double ch_bend[16];
+    int ch_volume[16];
+    int ch_panning[16];
+    int ch_vibrato[16];
+    int opl_program[16];
+    int opl_volume[16];
+    int opl_pan[16];
+    int held_first;          // Range of held notes in snapshot_notes
+    int held_count;
+} MidiSnapshot;
+
+typedef struct {
+    MidiEventList events;
+    int sample_rate;
+    int volume;              // Percent, applied to the synth output
+
+    // Position in events
+    int event_cursor;
+    double event_time;       // Song time the next batch of events is due at
+    int loop_cursor;
+    double loop_time;
+    double loop_wait;
+    double play_wait;        // Seconds of output until that batch
+    double play_time;        // Seconds rendered so far
+    bool playing;
+
+    // MIDI channel state
+    int ch_patch[16];
+    double ch_bend[16];
+    int ch_volume[16];
+    int ch_panning[16];
+    int ch_vibrato[16];
+    uint8_t held[16][128];   // Velocity of notes held, kept while seeking only
+
+    OPLSynth opl;
+
+    // Seek index, one snapshot every MIDI_SNAPSHOT_INTERVAL from 0
+    MidiSnapshot *snapshots;
+    int snapshot_count;
+    MidiHeldNote *snapshot_notes;
+    int snapshot_note_count;
+    int snapshot_note_capacity;
+
+    // Wall time midi_renderer_render spends dispatching events and in the
+    // synth, summed while profile is set
+    bool profile;
+    uint64_t dispatch_ns;
+    uint64_t synth_ns;
+} MidiRenderer;
+
+MidiRenderer* midi_renderer_new(int sample_rate, int volume);
+void midi_renderer_free(MidiRenderer *renderer);
+
+// Decode filename, index it for seeking and rewind to its start
+bool midi_renderer_load(MidiRenderer *renderer, const char *filename);
+
+// Same for a file already in memory; name is only used for logging
+bool midi_renderer_load_data(MidiRenderer *renderer, const uint8_t *data, size_t size, const char *name);
+
+// Back to the start of the loaded file with fresh channel and chip state
+void midi_renderer_rewind(MidiRenderer *renderer);
+
+// Continue from seconds into the song. The channel state there is rebuilt
+// from the nearest snapshot plus the few events after it, which costs no
+// synthesis and doesn't grow with the song's length. Melodic notes held at
+// that point are struck again.
+void midi_renderer_seek(MidiRenderer *renderer, double seconds);
+
+// Render up to frames stereo frames into buffer, dispatching each event at
+// the sample it falls due on. Returns the frames written, which is short
+// of frames only when the song ends inside the block and 0 after that.
+int midi_renderer_render(MidiRenderer *renderer, int16_t *buffer, int frames);
+
+// Dispatch the batch of events due now and schedule the next one
+void midi_renderer_process_events(MidiRenderer *renderer);
+
+#endif // MIDI_RENDERER_H
@@ -92,6 +92,7 @@ void initFMInstruments();
 bool initSDL();
 void cleanup();
 bool loadMidiFile(const char* filename);
+void unloadMidiFile();
 void playMidiFile();
 void handleEvents();
 void updateVolume(int change);
@@ -0,0 +1,156 @@
+#include "pcm_block.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static size_t page_size(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+static void* map_pages(size_t bytes) {
+#ifdef _WIN32
+    return VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+#endif
+}
+
+static void unmap_block(PCMBlock *block) {
+#ifdef _WIN32
+    if (block->file_backed) UnmapViewOfFile(block->mapping);
+    else VirtualFree(block->mapping, 0, MEM_RELEASE);
+#else
+    munmap(block->mapping, block->mapped_size);
+#endif
+}
+
+PCMBlock* pcm_block_create(size_t length) {
+    PCMBlock *block = (PCMBlock*)calloc(1, sizeof(PCMBlock));
+    if (!block) return NULL;
+
+    // Anonymous mappings come back zeroed, and an empty block still gets a
+    // page so data is never NULL
+    size_t page = page_size();
+    size_t bytes = length * sizeof(int16_t);
+    block->mapped_size = bytes == 0 ? page : (bytes + page - 1) / page * page;
+    block->mapping = map_pages(block->mapped_size);
+    if (!block->mapping) {
+        printf("PCM block: cannot map %zu bytes\n", block->mapped_size);
+        free(block);
+        return NULL;
+    }
+
+    block->data = (int16_t*)block->mapping;
+    block->length = length;
+    block->file_backed = false;
+    block->sealed = false;
+    block->refs.store(1, std::memory_order_relaxed);
+    return block;
+}
+
+PCMBlock* pcm_block_map_file(const char *path, size_t offset, size_t length) {
+    size_t bytes = offset + length * sizeof(int16_t);
+    void *mapping = NULL;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && (unsigned long long)file_size.QuadPart >= bytes && bytes > 0) {
+        // The view keeps the file mapped after both handles are closed
+        HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map) {
+            mapping = MapViewOfFile(map, FILE_MAP_READ, 0, 0, bytes);
+            CloseHandle(map);
+        }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= bytes && bytes > 0) {
+        void *p = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) mapping = p;
+    }
+    close(fd);
+#endif
+
+    if (!mapping) return NULL;
+
+    PCMBlock *block = (PCMBlock*)calloc(1, sizeof(PCMBlock));
+    if (!block) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+#else
+        munmap(mapping, bytes);
+#endif
+        return NULL;
+    }
+
+    block->mapping = mapping;
+    block->mapped_size = bytes;
+    block->data = (int16_t*)((char*)mapping + offset);
+    block->length = length;
+    block->file_backed = true;
+    block->sealed = true;
+    block->refs.store(1, std::memory_order_relaxed);
+    return block;
+}
+
+void pcm_block_seal(PCMBlock *block) {
+    if (!block || block->sealed) return;
+
+    // Protection is only a guard against stray writes; the block is treated
+    // as immutable whether or not the platform honours it
+#ifdef _WIN32
+    DWORD old_protect;
+    VirtualProtect(block->mapping, block->mapped_size, PAGE_READONLY, &old_protect);
+#else
+    mprotect(block->mapping, block->mapped_size, PROT_READ);
+#endif
+    block->sealed = true;
+}
+
+PCMBlock* pcm_block_ref(PCMBlock *block) {
+    if (block) {
+        block->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return block;
+}
+
+void pcm_block_unref(PCMBlock *block) {
+    if (!block) return;
+
+    if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        unmap_block(block);
+        free(block);
+    }
+}
+
+int pcm_block_refs(const PCMBlock *block) {
+    return block ? block->refs.load(std::memory_order_acquire) : 0;
+}
+
+size_t pcm_block_bytes(const PCMBlock *block) {
+    return block ? block->length * sizeof(int16_t) : 0;
+}
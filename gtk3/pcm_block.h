@@ -0,0 +1,44 @@
+#ifndef PCM_BLOCK_H
+#define PCM_BLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <atomic>
+
+// Reference-counted block of decoded 16-bit PCM. A block is filled once,
+// sealed read-only and then shared: the audio cache and the playback source
+// each hold a reference, so a cache hit hands out the same memory instead of
+// copying it. The payload is page-mapped so freeing a large track returns
+// the memory to the system straight away. A block can also map a file from
+// the disk cache directly, which is read-only from the start.
+
+typedef struct PCMBlock {
+    std::atomic<int> refs;
+    int16_t *data;
+    size_t length;         // In samples
+    void *mapping;         // Start of the mapping, data may sit past it
+    size_t mapped_size;    // Bytes mapped, page rounded for anonymous blocks
+    bool file_backed;
+    bool sealed;           // Read-only from here on
+} PCMBlock;
+
+// New block of `length` zeroed samples with one reference, or NULL
+PCMBlock* pcm_block_create(size_t length);
+
+// Map `length` samples starting `offset` bytes into a file, read-only. The
+// offset must keep the samples 2-byte aligned. Returns NULL if the file is
+// too short or cannot be mapped.
+PCMBlock* pcm_block_map_file(const char *path, size_t offset, size_t length);
+
+// Make the payload read-only. Call once the block has been filled.
+void pcm_block_seal(PCMBlock *block);
+
+PCMBlock* pcm_block_ref(PCMBlock *block);
+void pcm_block_unref(PCMBlock *block);
+
+// References held right now, only meaningful on the thread that owns them
+int pcm_block_refs(const PCMBlock *block);
+size_t pcm_block_bytes(const PCMBlock *block);
+
+#endif // PCM_BLOCK_H
@@ -0,0 +1,203 @@
+#include "prefetch.h"
+#include "audio_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static bool has_extension(const char *path, const char *ext) {
+    const char *dot = strrchr(path, '.');
+    if (!dot) return false;
+    for (; *dot && *ext; dot++, ext++) {
+        if (tolower((unsigned char)*dot) != *ext) return false;
+    }
+    return *dot == '\0' && *ext == '\0';
+}
+
+bool prefetch_can_decode(const char *path) {
+    // Streamed formats start within the prebuffer anyway and are never held
+    // in memory whole; karaoke bundles need the GUI thread
+    if (is_streamable_file(path)) return false;
+    if (has_extension(path, ".zip") || has_extension(path, ".lrc")) return false;
+    return true;
+}
+
+// Same header handling as load_wav_file(), reading in chunks so a cancel
+// doesn't have to wait for the whole file
+static PCMBlock* read_wav_file(Prefetcher *pf, const char *path, unsigned generation,
+                               size_t budget, DiskCacheInfo *info) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    char header[44];
+    if (fread(header, 1, 44, f) != 44 ||
+        strncmp(header, "RIFF", 4) != 0 || strncmp(header + 8, "WAVE", 4) != 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    info->sample_rate = *(int*)(header + 24);
+    info->channels = *(short*)(header + 22);
+    info->bits_per_sample = *(short*)(header + 34);
+
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    size_t samples = file_size > 44 ? (size_t)(file_size - 44) / sizeof(int16_t) : 0;
+    if (info->bits_per_sample != 16 || info->channels <= 0 || info->sample_rate <= 0 ||
+        samples == 0 || samples * sizeof(int16_t) > budget) {
+        fclose(f);
+        return NULL;
+    }
+    info->song_duration = (double)samples / ((double)info->sample_rate * info->channels);
+
+    PCMBlock *block = pcm_block_create(samples);
+    if (!block) {
+        fclose(f);
+        return NULL;
+    }
+
+    fseek(f, 44, SEEK_SET);
+    size_t done = 0;
+    size_t chunk = PREFETCH_READ_CHUNK / sizeof(int16_t);
+    while (done < samples) {
+        if (pf->generation.load(std::memory_order_relaxed) != generation) break;
+
+        size_t want = samples - done < chunk ? samples - done : chunk;
+        size_t got = fread(block->data + done, sizeof(int16_t), want, f);
+        done += got;
+        if (got < want) break;
+    }
+    fclose(f);
+
+    if (done < samples) {
+        pcm_block_unref(block);
+        return NULL;
+    }
+    pcm_block_seal(block);
+    return block;
+}
+
+static PCMBlock* decode_path(Prefetcher *pf, const char *path, unsigned generation,
+                             size_t budget, DiskCacheInfo *info) {
+    if (has_extension(path, ".wav")) {
+        return read_wav_file(pf, path, generation, budget, info);
+    }
+    return pf->disk_cache ? disk_cache_lookup(pf->disk_cache, path, info) : NULL;
+}
+
+static void* prefetch_thread(void *arg) {
+    Prefetcher *pf = (Prefetcher*)arg;
+
+    pthread_mutex_lock(&pf->lock);
+    while (!pf->stop) {
+        if (pf->job_count == 0) {
+            pthread_cond_wait(&pf->wake, &pf->lock);
+            continue;
+        }
+
+        char *path = pf->jobs[0];
+        memmove(pf->jobs, pf->jobs + 1, (pf->job_count - 1) * sizeof(char*));
+        pf->job_count--;
+        unsigned generation = pf->generation.load(std::memory_order_relaxed);
+        size_t budget = pf->budget_bytes;
+        pthread_mutex_unlock(&pf->lock);
+
+        DiskCacheInfo info;
+        PCMBlock *block = decode_path(pf, path, generation, budget, &info);
+
+        pthread_mutex_lock(&pf->lock);
+        size_t bytes = block ? block->length * sizeof(int16_t) : 0;
+        if (block && generation == pf->generation.load(std::memory_order_relaxed) &&
+            pf->ready_count < PREFETCH_AHEAD && bytes <= pf->budget_bytes) {
+            PrefetchResult *result = &pf->ready[pf->ready_count++];
+            result->path = path;
+            result->block = block;
+            result->info = info;
+            pf->budget_bytes -= bytes;
+            printf("Prefetched %s (%.2f MB)\n", path, bytes / (1024.0 * 1024.0));
+        } else {
+            pcm_block_unref(block);
+            free(path);
+        }
+    }
+    pthread_mutex_unlock(&pf->lock);
+    return NULL;
+}
+
+bool prefetch_init(Prefetcher *pf, DiskCache *disk_cache) {
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->wake, NULL);
+    pf->stop = false;
+    pf->generation.store(0);
+    pf->job_count = 0;
+    pf->budget_bytes = 0;
+    pf->ready_count = 0;
+    pf->disk_cache = disk_cache;
+
+    pf->thread_started = pthread_create(&pf->thread, NULL, prefetch_thread, pf) == 0;
+    if (!pf->thread_started) {
+        printf("Prefetch: cannot start worker thread\n");
+    }
+    return pf->thread_started;
+}
+
+// Drop pending jobs and unclaimed results. Caller holds the lock.
+static void clear_work(Prefetcher *pf) {
+    for (int i = 0; i < pf->job_count; i++) {
+        free(pf->jobs[i]);
+    }
+    pf->job_count = 0;
+    for (int i = 0; i < pf->ready_count; i++) {
+        free(pf->ready[i].path);
+        pcm_block_unref(pf->ready[i].block);
+    }
+    pf->ready_count = 0;
+}
+
+void prefetch_shutdown(Prefetcher *pf) {
+    if (pf->thread_started) {
+        pthread_mutex_lock(&pf->lock);
+        pf->stop = true;
+        pf->generation.fetch_add(1);
+        pthread_cond_signal(&pf->wake);
+        pthread_mutex_unlock(&pf->lock);
+
+        pthread_join(pf->thread, NULL);
+        pf->thread_started = false;
+    }
+
+    pthread_mutex_lock(&pf->lock);
+    clear_work(pf);
+    pthread_mutex_unlock(&pf->lock);
+}
+
+void prefetch_schedule(Prefetcher *pf, const char *const *paths, int count, size_t budget_bytes) {
+    if (!pf->thread_started) return;
+
+    pthread_mutex_lock(&pf->lock);
+    pf->generation.fetch_add(1);
+    clear_work(pf);
+    for (int i = 0; i < count && i < PREFETCH_AHEAD; i++) {
+        char *copy = strdup(paths[i]);
+        if (copy) pf->jobs[pf->job_count++] = copy;
+    }
+    pf->budget_bytes = budget_bytes;
+    pthread_cond_signal(&pf->wake);
+    pthread_mutex_unlock(&pf->lock);
+}
+
+void prefetch_cancel(Prefetcher *pf) {
+    prefetch_schedule(pf, NULL, 0, 0);
+}
+
+bool prefetch_take_result(Prefetcher *pf, PrefetchResult *result) {
+    pthread_mutex_lock(&pf->lock);
+    bool found = pf->ready_count > 0;
+    if (found) {
+        *result = pf->ready[0];
+        memmove(pf->ready, pf->ready + 1, (pf->ready_count - 1) * sizeof(PrefetchResult));
+        pf->ready_count--;
+    }
+    pthread_mutex_unlock(&pf->lock);
+    return found;
+}
@@ -0,0 +1,64 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <atomic>
+#include "pcm_block.h"
+#include "disk_cache.h"
+
+// Background decoding of the tracks after the current one. The GUI thread
+// hands over the next few queue entries and a memory budget; a worker
+// thread decodes them into PCM blocks which the GUI thread later moves into
+// the audio cache, so switching to one of them needs no decoding at all.
+//
+// The worker only runs decoders that are safe off the GUI thread: plain
+// WAV, and anything already in the disk cache. Other formats are decoded
+// on demand as before.
+
+#define PREFETCH_AHEAD        2     // Queue entries decoded ahead
+#define PREFETCH_READ_CHUNK   (1024 * 1024)   // Bytes read between cancellation checks
+
+typedef struct {
+    char *path;
+    PCMBlock *block;
+    DiskCacheInfo info;
+} PrefetchResult;
+
+typedef struct {
+    pthread_t thread;
+    bool thread_started;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool stop;
+
+    // Bumped by every schedule or cancel; work for an older generation is
+    // abandoned as soon as the worker notices
+    std::atomic<unsigned> generation;
+
+    // Under lock
+    char *jobs[PREFETCH_AHEAD];
+    int job_count;
+    size_t budget_bytes;          // Of decoded PCM for the current jobs
+    PrefetchResult ready[PREFETCH_AHEAD];
+    int ready_count;
+
+    DiskCache *disk_cache;
+} Prefetcher;
+
+bool prefetch_init(Prefetcher *pf, DiskCache *disk_cache);
+void prefetch_shutdown(Prefetcher *pf);
+
+// Replace the pending work. paths are copied.
+void prefetch_schedule(Prefetcher *pf, const char *const *paths, int count, size_t budget_bytes);
+void prefetch_cancel(Prefetcher *pf);
+
+// Pop one finished result; the caller takes the path and the block reference
+bool prefetch_take_result(Prefetcher *pf, PrefetchResult *result);
+
+// Formats the worker can decode, given a disk cache hit for converted ones
+bool prefetch_can_decode(const char *path);
+
+#endif // PREFETCH_H
@@ -182,7 +182,10 @@ char* extract_audio_from_zip(const char *zip_path) {
                 // Build cross-platform temp path
                 std::string temp_dir = get_temp_directory_queue();
                 std::string filename = fs::path(name).filename().string();
-                std::string temp_path = (fs::path(temp_dir) / ("zenamp-" + filename)).string();
+                // Numbered, as the metadata scanner extracts several at once
+                static gint extract_count = 0;
+                std::string unique = std::to_string(g_atomic_int_add(&extract_count, 1));
+                std::string temp_path = (fs::path(temp_dir) / ("zenamp-" + unique + "-" + filename)).string();
 
                 void *data = mz_zip_reader_extract_to_heap(&zip, i, NULL, 0);
                 if (data) {
@@ -485,68 +488,144 @@ void on_queue_row_activated(GtkTreeView *tree_view, GtkTreePath *path,
     g_free(filepath);
 }
 
+#define QUEUE_REFRESH_DELAY_MS  500   // Rebuilds while the scanner changes a filtered view
+
+// Column text for one queue row
+static void format_queue_row(const TrackMetadata *meta, char *title, char *artist,
+                             char *album, char *genre, char *duration_str) {
+    g_strlcpy(title, meta->title[0] ? meta->title : "Unknown Title", 256);
+    g_strlcpy(artist, meta->artist[0] ? meta->artist : "Unknown Artist", 256);
+    g_strlcpy(album, meta->album[0] ? meta->album : "Unknown Album", 256);
+    g_strlcpy(genre, meta->genre[0] ? meta->genre : "Unknown Genre", 256);
+    if (meta->duration > 0) {
+        snprintf(duration_str, 16, "%d:%02d", meta->duration / 60, meta->duration % 60);
+    } else {
+        duration_str[0] = '\0';
+    }
+}
+
+// Columns for one queue row, straight from the metadata index when it has
+// already checked the file. Otherwise they stay blank and the file goes in
+// misses for the scanner; row (-1 when the filter hides it) is remembered
+// so the columns can be filled in when the tags arrive.
+static bool get_queue_row_metadata(AudioPlayer *player, const char *filepath,
+                                   char *title, char *artist, char *album,
+                                   char *genre, char *duration_str) {
+    TrackMetadata meta;
+    if (metadata_index_peek(&player->metadata_index, filepath, &meta)) {
+        format_queue_row(&meta, title, artist, album, genre, duration_str);
+        return true;
+    }
+    title[0] = artist[0] = album[0] = genre[0] = duration_str[0] = '\0';
+    return false;
+}
+
+static void add_pending_row(AudioPlayer *player, const char *filepath, int row, GPtrArray *misses) {
+    GArray *rows = (GArray*)g_hash_table_lookup(player->queue_pending_rows, filepath);
+    if (!rows) {
+        rows = g_array_new(FALSE, FALSE, sizeof(int));
+        g_hash_table_insert(player->queue_pending_rows, g_strdup(filepath), rows);
+        g_ptr_array_add(misses, (gpointer)filepath);
+    }
+    g_array_append_val(rows, row);
+}
+
+static void free_pending_rows(gpointer data) {
+    g_array_free((GArray*)data, TRUE);
+}
+
+// Start of a display rebuild: rows recorded by the last one are gone
+static void reset_pending_rows(AudioPlayer *player) {
+    if (!player->queue_pending_rows) {
+        player->queue_pending_rows = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                           g_free, free_pending_rows);
+    }
+    g_hash_table_remove_all(player->queue_pending_rows);
+}
+
+// End of a display rebuild: scan what it couldn't show, in queue order,
+// instead of whatever an earlier rebuild asked for
+static void scan_pending_rows(AudioPlayer *player, GPtrArray *misses) {
+    metadata_scanner_cancel(&player->metadata_scanner);
+    metadata_scanner_submit(&player->metadata_scanner,
+                            (const char *const *)misses->pdata, (int)misses->len);
+    g_ptr_array_free(misses, TRUE);
+}
+
+static gboolean refresh_queue_display(gpointer user_data) {
+    AudioPlayer *player = (AudioPlayer*)user_data;
+    player->queue_refresh_id = 0;
+    update_queue_display_with_filter(player, false);
+    return G_SOURCE_REMOVE;
+}
+
+// The row the last rebuild put filepath in, unless it has moved since
+static bool get_pending_row_iter(AudioPlayer *player, int row, const char *filepath,
+                                 GtkTreeIter *iter) {
+    if (row < 0 || !gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(player->queue_store),
+                                                  iter, NULL, row)) {
+        return false;
+    }
+    char *row_path = NULL;
+    gtk_tree_model_get(GTK_TREE_MODEL(player->queue_store), iter, COL_FILEPATH, &row_path, -1);
+    bool same = row_path && strcmp(row_path, filepath) == 0;
+    g_free(row_path);
+    return same;
+}
+
+void on_queue_metadata_scanned(ScannedTrack *tracks, int count, void *user_data) {
+    AudioPlayer *player = (AudioPlayer*)user_data;
+    if (!player->queue_store || !player->queue_pending_rows) return;
+
+    // With a filter the new tags can show or hide rows, and a row dragged
+    // elsewhere can't be found by its position; both need a rebuild
+    bool rebuild = player->queue_filter_text[0] != '\0';
+
+    for (int i = 0; i < count; i++) {
+        GArray *rows = (GArray*)g_hash_table_lookup(player->queue_pending_rows, tracks[i].path);
+        if (!rows) continue;
+
+        char title[256], artist[256], album[256], genre[256], duration_str[16];
+        format_queue_row(&tracks[i].meta, title, artist, album, genre, duration_str);
+
+        for (guint j = 0; j < rows->len; j++) {
+            int row = g_array_index(rows, int, j);
+            GtkTreeIter iter;
+            if (!get_pending_row_iter(player, row, tracks[i].path, &iter)) {
+                if (row >= 0) rebuild = true;
+                continue;
+            }
+            gtk_list_store_set(player->queue_store, &iter,
+                COL_TITLE, title,
+                COL_ARTIST, artist,
+                COL_ALBUM, album,
+                COL_GENRE, genre,
+                COL_DURATION, duration_str,
+                -1);
+        }
+        g_hash_table_remove(player->queue_pending_rows, tracks[i].path);
+    }
+
+    if (rebuild && player->queue_refresh_id == 0) {
+        player->queue_refresh_id = g_timeout_add(QUEUE_REFRESH_DELAY_MS, refresh_queue_display, player);
+    }
+}
+
 void update_queue_display(AudioPlayer *player) {
     if (player->queue_store) {
         gtk_list_store_clear(player->queue_store);
     }
+    reset_pending_rows(player);
+    GPtrArray *misses = g_ptr_array_new();
     
     for (int i = 0; i < player->queue.count; i++) {
-        GtkTreeIter iter;
-        gtk_list_store_append(player->queue_store, &iter);
-        
-        char *metadata = NULL;
-
         const char *ext = strrchr(player->queue.files[i], '.');
-        if (ext && strcasecmp(ext, ".zip") == 0) {
-            char *extracted_path = extract_audio_from_zip(player->queue.files[i]);
-            if (extracted_path) {
-                metadata = extract_metadata(extracted_path);
-                g_free(extracted_path);
-            } else {
-                metadata = g_strdup("No metadata available");
-            }
-        } else {
-            metadata = extract_metadata(player->queue.files[i]);
-        }
-        char title[256] = "", artist[256] = "", album[256] = "", genre[256] = "";
-        int duration_seconds = 0;
-        
-        parse_metadata(metadata, title, artist, album, genre);
-
-        
-        const char *duration_patterns[] = {
-            "<b>Duration:</b>",
-            "<b>Length:</b>",
-            "Duration:",
-            "Length:"
-        };
-        
-        for (int j = 0; j < 4; j++) {
-            const char *duration_start = strstr(metadata, duration_patterns[j]);
-            if (duration_start) {
-                duration_start = strchr(duration_start, ':');
-                if (duration_start) {
-                    duration_start++;
-                    const char *time_start = strchr(duration_start, ':');
-                    if (time_start) {
-                        const char *scan = time_start - 1;
-                        while (scan > duration_start && isdigit(*scan)) {
-                            scan--;
-                        }
-                        scan++;
-                        
-                        int minutes = 0, seconds = 0;
-                        if (sscanf(scan, "%d:%d", &minutes, &seconds) == 2) {
-                            duration_seconds = minutes * 60 + seconds;
-                            break;
-                        }
-                    }
-                }
-            }
+        char title[256], artist[256], album[256], genre[256], duration_str[16];
+        if (!get_queue_row_metadata(player, player->queue.files[i],
+                                    title, artist, album, genre, duration_str)) {
+            add_pending_row(player, player->queue.files[i], i, misses);
         }
         
-        g_free(metadata);
-        
         char *basename = g_path_get_basename(player->queue.files[i]);
         
         //const char *ext = strrchr(player->queue.files[i], '.');
@@ -555,17 +634,10 @@ void update_queue_display(AudioPlayer *player) {
             cdgk_indicator = "✓";
         }
         
-        char duration_str[16];
-        if (duration_seconds > 0) {
-            snprintf(duration_str, sizeof(duration_str), "%d:%02d", 
-                     duration_seconds / 60, duration_seconds % 60);
-        } else {
-            strcpy(duration_str, "");
-        }
-        
         const char *indicator = (i == player->queue.current_index) ? "▶" : "";
         
-        gtk_list_store_set(player->queue_store, &iter,
+        // One row-inserted signal per row instead of an insert plus a change
+        gtk_list_store_insert_with_values(player->queue_store, NULL, -1,
             COL_FILEPATH, player->queue.files[i],
             COL_PLAYING, indicator,
             COL_FILENAME, basename,
@@ -580,6 +652,7 @@ void update_queue_display(AudioPlayer *player) {
 
         g_free(basename);
     }
+    scan_pending_rows(player, misses);
     
     if (player->queue.current_index >= 0 && player->queue_tree_view) {
         GtkTreePath *path = gtk_tree_path_new_from_indices(
@@ -1056,31 +1129,17 @@ void update_queue_display_with_filter(AudioPlayer *player, bool scroll_to_curren
 
     int visible_count = 0;
 
+    reset_pending_rows(player);
+    GPtrArray *misses = g_ptr_array_new();
+
     for (int i = 0; i < player->queue.count; i++) {
         const char *filepath = player->queue.files[i];
         const char *ext = strrchr(filepath, '.');
 
-        char *metadata = NULL;
-        int duration_seconds = 0;
-
-        if (ext && strcasecmp(ext, ".zip") == 0) {
-            char *extracted_path = extract_audio_from_zip(filepath);
-            if (extracted_path) {
-                metadata = extract_metadata(extracted_path);
-                duration_seconds = get_file_duration(extracted_path);
-                unlink(extracted_path);
-                g_free(extracted_path);
-            } else {
-                metadata = g_strdup("No metadata available");
-            }
-        } else {
-            metadata = extract_metadata(filepath);
-            duration_seconds = get_file_duration(filepath);
-        }
-
-        char title[256] = "", artist[256] = "", album[256] = "", genre[256] = "";
-        parse_metadata(metadata, title, artist, album, genre);
-        g_free(metadata);
+        // Until the scanner has read a file only its name can match
+        char title[256], artist[256], album[256], genre[256], duration_str[16];
+        bool known = get_queue_row_metadata(player, filepath, title, artist, album,
+                                            genre, duration_str);
 
         char *basename = g_path_get_basename(filepath);
 
@@ -1093,22 +1152,15 @@ void update_queue_display_with_filter(AudioPlayer *player, bool scroll_to_curren
                       matches_filter(genre, filter);
         }
 
-        if (matches) {
-            GtkTreeIter iter;
-            gtk_list_store_append(player->queue_store, &iter);
-
-            char duration_str[16];
-            if (duration_seconds > 0) {
-                snprintf(duration_str, sizeof(duration_str), "%d:%02d",
-                         duration_seconds / 60, duration_seconds % 60);
-            } else {
-                strcpy(duration_str, "");
-            }
+        if (!known) {
+            add_pending_row(player, filepath, matches ? visible_count : -1, misses);
+        }
 
+        if (matches) {
             const char *cdgk_indicator = (ext && strcasecmp(ext, ".zip") == 0) ? "✓" : "";
             const char *indicator = (i == player->queue.current_index) ? "▶" : "";
 
-            gtk_list_store_set(player->queue_store, &iter,
+            gtk_list_store_insert_with_values(player->queue_store, NULL, -1,
                 COL_FILEPATH, filepath,
                 COL_PLAYING, indicator,
                 COL_FILENAME, basename,
@@ -1126,6 +1178,7 @@ void update_queue_display_with_filter(AudioPlayer *player, bool scroll_to_curren
 
         g_free(basename);
     }
+    scan_pending_rows(player, misses);
 
     // Restore scroll position or scroll to current
     if (scroll_to_current && player->queue.current_index >= 0 && player->queue_tree_view) {
@@ -1199,4 +1252,12 @@ void cleanup_queue_filter(AudioPlayer *player) {
         g_source_remove(player->queue_filter_timeout_id);
         player->queue_filter_timeout_id = 0;
     }
+    if (player->queue_refresh_id != 0) {
+        g_source_remove(player->queue_refresh_id);
+        player->queue_refresh_id = 0;
+    }
+    if (player->queue_pending_rows) {
+        g_hash_table_destroy(player->queue_pending_rows);
+        player->queue_pending_rows = NULL;
+    }
 }
@@ -0,0 +1,654 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <glib.h>
+#include "resampler.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RESAMPLER_X86 1
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static inline int16_t float_to_s16(float v) {
+    if (v >= 32767.0f) return 32767;
+    if (v <= -32768.0f) return -32768;
+    return (int16_t)lrintf(v);
+}
+
+#ifdef RESAMPLER_X86
+static inline float hsum_ps(__m128 v) {
+    __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+#endif
+
+// n must be a multiple of 4
+static float dot_product(const float *a, const float *b, size_t n) {
+#ifdef RESAMPLER_X86
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    for (; i < n; i += 4) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    return hsum_ps(_mm_add_ps(acc0, acc1));
+#else
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++) sum += a[i] * b[i];
+    return sum;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Polyphase resampler
+// ---------------------------------------------------------------------------
+
+static int resampler_taps_for(ResampleQuality quality) {
+    switch (quality) {
+        case RESAMPLE_QUALITY_FAST: return 8;
+        case RESAMPLE_QUALITY_BEST: return 32;
+        default: return 16;
+    }
+}
+
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+// Table entry (row, tap) sits `tap - (taps/2 - 1) - row/PHASES` frames from
+// the output position
+static double resampler_tap_offset(int taps, int row, int tap) {
+    return (tap - (taps / 2 - 1)) - (double)row / RESAMPLER_PHASES;
+}
+
+ResampleFilter* resample_filter_new(ResampleQuality quality, double cutoff) {
+    ResampleFilter *filter = (ResampleFilter*)malloc(sizeof(ResampleFilter));
+    if (!filter) {
+        printf("Resampler: out of memory\n");
+        return NULL;
+    }
+
+    int taps = resampler_taps_for(quality);
+    filter->quality = quality;
+    filter->taps = taps;
+    filter->cutoff = cutoff;
+
+    double beta = taps <= 8 ? 5.0 : (taps <= 16 ? 7.0 : 9.0);
+    double norm = bessel_i0(beta);
+    double half = taps / 2;
+
+    for (int row = 0; row <= RESAMPLER_PHASES; row++) {
+        float *h = filter->coeffs + row * taps;
+        double sum = 0.0;
+
+        for (int tap = 0; tap < taps; tap++) {
+            double offset = resampler_tap_offset(taps, row, tap);
+            double t = offset / half;
+            double inside = 1.0 - t * t;
+            double window = inside > 0.0 ? bessel_i0(beta * sqrt(inside)) / norm : 0.0;
+            double x = offset * cutoff;
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double v = sinc * window;
+            h[tap] = (float)v;
+            sum += v;
+        }
+        // Unity gain at DC for every phase
+        if (sum != 0.0) {
+            for (int tap = 0; tap < taps; tap++) h[tap] = (float)(h[tap] / sum);
+        }
+    }
+    return filter;
+}
+
+void resample_filter_free(ResampleFilter *filter) {
+    free(filter);
+}
+
+double resampler_cutoff_for(double ratio) {
+    return ratio > 1.0 ? 0.97 / ratio : 1.0;
+}
+
+bool resampler_init(Resampler *rs, int channels, ResampleQuality quality) {
+    memset(rs, 0, sizeof(*rs));
+    if (channels < 1 || channels > RESAMPLER_MAX_CHANNELS) {
+        printf("Resampler: unsupported channel count %d\n", channels);
+        return false;
+    }
+
+    rs->channels = channels;
+    rs->filter = resample_filter_new(quality, 1.0);
+    rs->scratch = (int16_t*)malloc(RESAMPLER_CHUNK * channels * sizeof(int16_t));
+    bool ok = rs->filter && rs->scratch;
+    for (int c = 0; c < channels; c++) {
+        rs->history[c] = (float*)calloc(RESAMPLER_HISTORY, sizeof(float));
+        ok = ok && rs->history[c];
+    }
+    if (!ok) {
+        printf("Resampler: out of memory\n");
+        resampler_free(rs);
+        return false;
+    }
+
+    rs->ratio = 1.0;
+    resampler_reset(rs);
+    return true;
+}
+
+void resampler_free(Resampler *rs) {
+    resample_filter_free(rs->filter);
+    free(rs->scratch);
+    for (int c = 0; c < RESAMPLER_MAX_CHANNELS; c++) free(rs->history[c]);
+    memset(rs, 0, sizeof(*rs));
+}
+
+// Forget buffered input, e.g. after a seek. The first output lines up with
+// the next upstream frame.
+void resampler_reset(Resampler *rs) {
+    size_t lead = rs->filter->taps / 2 - 1;
+    for (int c = 0; c < rs->channels; c++) {
+        memset(rs->history[c], 0, lead * sizeof(float));
+    }
+    rs->history_len = lead;
+    rs->position = (double)lead;
+    rs->pending_skip = 0;
+    rs->draining = false;
+}
+
+ResampleFilter* resampler_swap_filter(Resampler *rs, ResampleFilter *filter) {
+    ResampleFilter *old = rs->filter;
+    rs->filter = filter;
+
+    // A longer filter reaches further back than the history may go: pad the
+    // front with silence, as after a reset
+    size_t lead = filter->taps / 2 - 1;
+    size_t centre = (size_t)rs->position;
+    if (centre < lead) {
+        size_t pad = lead - centre;
+        for (int c = 0; c < rs->channels; c++) {
+            memmove(rs->history[c] + pad, rs->history[c], rs->history_len * sizeof(float));
+            memset(rs->history[c], 0, pad * sizeof(float));
+        }
+        rs->history_len += pad;
+        rs->position += pad;
+        if (rs->draining) rs->drain_end += pad;
+    }
+    return old;
+}
+
+void resampler_set_ratio(Resampler *rs, double ratio) {
+    if (ratio <= 0.0) ratio = 1.0;
+    rs->ratio = ratio;
+}
+
+// Drop history before `base` and append the next upstream chunk
+static bool resampler_refill(Resampler *rs, size_t base, AudioReadFn read, void *ctx) {
+    if (base >= rs->history_len) {
+        rs->pending_skip += base - rs->history_len;
+        rs->history_len = 0;
+    } else if (base > 0) {
+        size_t keep = rs->history_len - base;
+        for (int c = 0; c < rs->channels; c++) {
+            memmove(rs->history[c], rs->history[c] + base, keep * sizeof(float));
+        }
+        rs->history_len = keep;
+    }
+    rs->position -= base;
+    if (rs->draining) rs->drain_end -= base;
+
+    size_t space = RESAMPLER_HISTORY - rs->history_len;
+    size_t want = space < RESAMPLER_CHUNK ? space : RESAMPLER_CHUNK;
+    size_t got = read(ctx, rs->scratch, want);
+    if (got == 0) return false;
+
+    size_t skip = rs->pending_skip < got ? rs->pending_skip : got;
+    rs->pending_skip -= skip;
+
+    const int channels = rs->channels;
+    for (size_t i = skip; i < got; i++) {
+        for (int c = 0; c < channels; c++) {
+            rs->history[c][rs->history_len] = rs->scratch[i * channels + c];
+        }
+        rs->history_len++;
+    }
+    return true;
+}
+
+// One output frame: interpolate between two filter rows and run the dot
+// product for every channel
+static inline void resampler_frame(const Resampler *rs, size_t base, const float *h0, const float *h1,
+                                   float w, int16_t *dst) {
+    const int channels = rs->channels;
+#ifdef RESAMPLER_X86
+    __m128 wv = _mm_set1_ps(w);
+    __m128 acc[RESAMPLER_MAX_CHANNELS];
+    for (int c = 0; c < channels; c++) acc[c] = _mm_setzero_ps();
+
+    for (int k = 0; k < rs->filter->taps; k += 4) {
+        __m128 a = _mm_loadu_ps(h0 + k);
+        __m128 coeff = _mm_add_ps(a, _mm_mul_ps(wv, _mm_sub_ps(_mm_loadu_ps(h1 + k), a)));
+        for (int c = 0; c < channels; c++) {
+            acc[c] = _mm_add_ps(acc[c], _mm_mul_ps(coeff, _mm_loadu_ps(rs->history[c] + base + k)));
+        }
+    }
+    for (int c = 0; c < channels; c++) dst[c] = float_to_s16(hsum_ps(acc[c]));
+#else
+    float acc[RESAMPLER_MAX_CHANNELS] = { 0.0f };
+    for (int k = 0; k < rs->filter->taps; k++) {
+        float coeff = h0[k] + w * (h1[k] - h0[k]);
+        for (int c = 0; c < channels; c++) acc[c] += coeff * rs->history[c][base + k];
+    }
+    for (int c = 0; c < channels; c++) dst[c] = float_to_s16(acc[c]);
+#endif
+}
+
+// Produce up to `frames` output frames, pulling upstream as needed. Returns
+// fewer when upstream has nothing more to give right now.
+size_t resampler_process(Resampler *rs, int16_t *out, size_t frames, AudioReadFn read, void *ctx) {
+    const int channels = rs->channels;
+    const ResampleFilter *filter = rs->filter;
+    const int taps = filter->taps;
+    const size_t lead = taps / 2 - 1;
+    const bool passthrough = filter->cutoff >= 1.0;
+    size_t produced = 0;
+
+    while (produced < frames) {
+        // Only silence is left past the end of the input being drained
+        if (rs->draining && rs->position >= rs->drain_end) break;
+
+        size_t centre = (size_t)rs->position;
+        size_t base = centre - lead;
+        if (base + taps > rs->history_len) {
+            if (!resampler_refill(rs, base, read, ctx)) break;
+            continue;
+        }
+
+        int16_t *dst = out + produced * channels;
+        double frac = rs->position - (double)centre;
+
+        if (frac == 0.0 && passthrough) {
+            // On an input frame with an interpolating filter: copy it
+            for (int c = 0; c < channels; c++) dst[c] = float_to_s16(rs->history[c][centre]);
+        } else {
+            double phase = frac * RESAMPLER_PHASES;
+            int row = (int)phase;
+            const float *h0 = filter->coeffs + row * taps;
+            resampler_frame(rs, base, h0, h0 + taps, (float)(phase - row), dst);
+        }
+
+        rs->position += rs->ratio;
+        produced++;
+    }
+    return produced;
+}
+
+static size_t read_silence(void *ctx, int16_t *dst, size_t max_frames) {
+    const Resampler *rs = (const Resampler*)ctx;
+    memset(dst, 0, max_frames * rs->channels * sizeof(int16_t));
+    return max_frames;
+}
+
+size_t resampler_drain(Resampler *rs, int16_t *out, size_t frames) {
+    if (!rs->draining) {
+        rs->draining = true;
+        rs->drain_end = (double)rs->history_len;
+    }
+
+    double left = rs->drain_end - rs->position;
+    if (left <= 0.0) return 0;
+    size_t owed = (size_t)ceil(left / rs->ratio);
+    if (owed > frames) owed = frames;
+    return resampler_process(rs, out, owed, read_silence, rs);
+}
+
+// ---------------------------------------------------------------------------
+// WSOLA time stretch
+// ---------------------------------------------------------------------------
+
+bool time_stretch_init(TimeStretch *ts, int channels, AudioReadFn source, void *source_ctx) {
+    memset(ts, 0, sizeof(*ts));
+    if (channels < 1 || channels > RESAMPLER_MAX_CHANNELS) {
+        printf("Time stretch: unsupported channel count %d\n", channels);
+        return false;
+    }
+
+    ts->channels = channels;
+    ts->speed = 1.0;
+    ts->source = source;
+    ts->source_ctx = source_ctx;
+
+    const size_t L = TIME_STRETCH_OVERLAP;
+    ts->fade_in = (float*)malloc(L * sizeof(float));
+    ts->mono = (float*)malloc((3 * L + 2 * TIME_STRETCH_SEEK) * sizeof(float));
+    ts->output = (int16_t*)malloc(L * channels * sizeof(int16_t));
+    ts->scratch = (int16_t*)malloc(RESAMPLER_CHUNK * channels * sizeof(int16_t));
+    bool ok = ts->fade_in && ts->mono && ts->output && ts->scratch;
+    for (int c = 0; c < channels; c++) {
+        ts->input[c] = (float*)calloc(TIME_STRETCH_BUFFER, sizeof(float));
+        ts->tail[c] = (float*)calloc(L, sizeof(float));
+        ok = ok && ts->input[c] && ts->tail[c];
+    }
+    if (!ok) {
+        printf("Time stretch: out of memory\n");
+        time_stretch_free(ts);
+        return false;
+    }
+
+    // sin^2 rise, so fade in + fade out is exactly 1
+    for (size_t i = 0; i < L; i++) {
+        double s = sin(0.5 * M_PI * (i + 0.5) / L);
+        ts->fade_in[i] = (float)(s * s);
+    }
+
+    time_stretch_reset(ts);
+    return true;
+}
+
+void time_stretch_free(TimeStretch *ts) {
+    free(ts->fade_in);
+    free(ts->mono);
+    free(ts->output);
+    free(ts->scratch);
+    for (int c = 0; c < RESAMPLER_MAX_CHANNELS; c++) {
+        free(ts->input[c]);
+        free(ts->tail[c]);
+    }
+    memset(ts, 0, sizeof(*ts));
+}
+
+void time_stretch_reset(TimeStretch *ts) {
+    ts->input_len = 0;
+    ts->analysis_pos = 0.0;
+    ts->prev_start = 0;
+    ts->has_prev = false;
+    ts->output_pos = 0;
+    ts->output_len = 0;
+    ts->draining = false;
+}
+
+void time_stretch_set_speed(TimeStretch *ts, double speed) {
+    if (speed < 0.05) speed = 0.05;
+    if (speed > 8.0) speed = 8.0;
+    ts->speed = speed;
+}
+
+static void time_stretch_discard(TimeStretch *ts, size_t frames) {
+    if (frames == 0) return;
+    size_t keep = ts->input_len - frames;
+    for (int c = 0; c < ts->channels; c++) {
+        memmove(ts->input[c], ts->input[c] + frames, keep * sizeof(float));
+    }
+    ts->input_len = keep;
+    ts->analysis_pos -= frames;
+    ts->prev_start -= frames;
+    if (ts->draining) ts->drain_end -= frames < ts->drain_end ? frames : ts->drain_end;
+}
+
+static bool time_stretch_fill(TimeStretch *ts, size_t needed) {
+    const int channels = ts->channels;
+    while (ts->input_len < needed) {
+        size_t space = TIME_STRETCH_BUFFER - ts->input_len;
+        size_t want = space < RESAMPLER_CHUNK ? space : RESAMPLER_CHUNK;
+        if (want == 0) return false;
+
+        size_t got = ts->draining ? 0 : ts->source(ts->source_ctx, ts->scratch, want);
+        if (got == 0) {
+            if (!ts->draining) return false;
+            memset(ts->scratch, 0, want * channels * sizeof(int16_t));
+            got = want;
+        }
+
+        for (size_t i = 0; i < got; i++) {
+            for (int c = 0; c < channels; c++) {
+                ts->input[c][ts->input_len] = ts->scratch[i * channels + c];
+            }
+            ts->input_len++;
+        }
+    }
+    return true;
+}
+
+// Candidate start in [lo, hi] whose opening best matches the natural
+// continuation of the previous segment (normalised cross-correlation on a
+// mono mix, coarse pass then a fine pass around the winner)
+static size_t time_stretch_align(TimeStretch *ts, size_t lo, size_t hi) {
+    const size_t L = TIME_STRETCH_OVERLAP;
+    const size_t span = hi - lo;
+    float *ref = ts->mono;
+    float *region = ts->mono + L;
+
+    for (size_t i = 0; i < L; i++) {
+        float sum = 0.0f;
+        for (int c = 0; c < ts->channels; c++) sum += ts->input[c][ts->prev_start + L + i];
+        ref[i] = sum;
+    }
+    for (size_t i = 0; i < span + L; i++) {
+        float sum = 0.0f;
+        for (int c = 0; c < ts->channels; c++) sum += ts->input[c][lo + i];
+        region[i] = sum;
+    }
+
+    size_t best = 0;
+    float best_score = -INFINITY;
+    for (size_t d = 0; d <= span; d += 4) {
+        const float *cand = region + d;
+        float score = dot_product(ref, cand, L) / sqrtf(dot_product(cand, cand, L) + 1.0f);
+        if (score > best_score) {
+            best_score = score;
+            best = d;
+        }
+    }
+
+    size_t first = best > 3 ? best - 3 : 0;
+    size_t last = best + 3 < span ? best + 3 : span;
+    size_t coarse = best;
+    for (size_t d = first; d <= last; d++) {
+        if (d == coarse) continue;
+        const float *cand = region + d;
+        float score = dot_product(ref, cand, L) / sqrtf(dot_product(cand, cand, L) + 1.0f);
+        if (score > best_score) {
+            best_score = score;
+            best = d;
+        }
+    }
+    return lo + best;
+}
+
+static bool time_stretch_hop(TimeStretch *ts) {
+    const size_t L = TIME_STRETCH_OVERLAP;
+    const int channels = ts->channels;
+
+    size_t ideal = (size_t)(ts->analysis_pos + 0.5);
+    size_t lo = ideal, hi = ideal;
+    if (ts->has_prev) {
+        lo = ideal > TIME_STRETCH_SEEK ? ideal - TIME_STRETCH_SEEK : 0;
+        hi = ideal + TIME_STRETCH_SEEK;
+    }
+
+    // Past the end of the real input while draining, one more hop plays out
+    // the faded tail of the previous segment if that holds any
+    if (ts->draining && ideal >= ts->drain_end) {
+        bool tail_left = ts->has_prev && ts->prev_start + L < ts->drain_end;
+        if (!tail_left) return false;
+        ts->drain_end = 0;
+    }
+
+    // Keep the natural continuation of the previous segment for the search
+    size_t keep_from = lo;
+    if (ts->has_prev && ts->prev_start + L < keep_from) keep_from = ts->prev_start + L;
+    time_stretch_discard(ts, keep_from);
+    lo -= keep_from;
+    hi -= keep_from;
+
+    if (!time_stretch_fill(ts, hi + 2 * L)) {
+        // Upstream ran dry: search whatever is buffered
+        if (ts->input_len < lo + 2 * L) return false;
+        hi = ts->input_len - 2 * L;
+    }
+
+    size_t start = ts->has_prev && hi > lo ? time_stretch_align(ts, lo, hi) : lo;
+
+    for (size_t i = 0; i < L; i++) {
+        float fade_in = ts->fade_in[i];
+        for (int c = 0; c < channels; c++) {
+            float v = ts->input[c][start + i];
+            if (ts->has_prev) v = ts->tail[c][i] + v * fade_in;
+            ts->output[i * channels + c] = float_to_s16(v);
+            ts->tail[c][i] = ts->input[c][start + L + i] * (1.0f - fade_in);
+        }
+    }
+
+    ts->prev_start = start;
+    ts->has_prev = true;
+    ts->analysis_pos += ts->speed * L;
+    ts->output_pos = 0;
+    ts->output_len = L;
+    return true;
+}
+
+// AudioReadFn over the stretched output, so it can feed the resampler
+size_t time_stretch_read(void *ctx, int16_t *dst, size_t max_frames) {
+    TimeStretch *ts = (TimeStretch*)ctx;
+    const int channels = ts->channels;
+    size_t produced = 0;
+
+    while (produced < max_frames) {
+        if (ts->output_pos >= ts->output_len && !time_stretch_hop(ts)) break;
+
+        size_t n = ts->output_len - ts->output_pos;
+        if (n > max_frames - produced) n = max_frames - produced;
+        memcpy(dst + produced * channels, ts->output + ts->output_pos * channels,
+               n * channels * sizeof(int16_t));
+        ts->output_pos += n;
+        produced += n;
+    }
+    return produced;
+}
+
+void time_stretch_drain(TimeStretch *ts) {
+    if (ts->draining) return;
+    ts->draining = true;
+    ts->drain_end = ts->input_len;
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark (zenamp --benchmark-resampler): CPU time per device block for
+// each quality and a range of speeds
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const int16_t *data;
+    size_t frames;
+    size_t pos;
+    int channels;
+} BenchSource;
+
+// Loops forever so the benchmark never runs dry
+static size_t bench_read(void *ctx, int16_t *dst, size_t max_frames) {
+    BenchSource *src = (BenchSource*)ctx;
+    for (size_t i = 0; i < max_frames; i++) {
+        memcpy(dst + i * src->channels, src->data + src->pos * src->channels, src->channels * sizeof(int16_t));
+        src->pos = (src->pos + 1) % src->frames;
+    }
+    return max_frames;
+}
+
+static void bench_run(const char *label, int source_rate, double speed, bool stretch,
+                      ResampleQuality quality, BenchSource *src) {
+    const int device_rate = 44100;
+    const size_t block = 1024;
+    const int blocks = 400;
+    const int channels = src->channels;
+    int16_t out[1024 * RESAMPLER_MAX_CHANNELS];
+
+    Resampler rs;
+    TimeStretch ts;
+    if (!resampler_init(&rs, channels, quality)) return;
+    if (!time_stretch_init(&ts, channels, bench_read, src)) {
+        resampler_free(&rs);
+        return;
+    }
+    time_stretch_set_speed(&ts, speed);
+    double rate_ratio = (double)source_rate / device_rate;
+    double ratio = stretch ? rate_ratio : rate_ratio * speed;
+    resampler_set_ratio(&rs, ratio);
+    resample_filter_free(resampler_swap_filter(&rs, resample_filter_new(quality, resampler_cutoff_for(ratio))));
+    src->pos = 0;
+
+    gint64 total = 0, worst = 0;
+    for (int b = 0; b < blocks; b++) {
+        gint64 start = g_get_monotonic_time();
+        if (stretch) {
+            resampler_process(&rs, out, block, time_stretch_read, &ts);
+        } else {
+            resampler_process(&rs, out, block, bench_read, src);
+        }
+        gint64 elapsed = g_get_monotonic_time() - start;
+        total += elapsed;
+        if (elapsed > worst) worst = elapsed;
+    }
+
+    double avg = (double)total / blocks;
+    double block_us = block * 1e6 / device_rate;
+    printf("  %-6s %6d Hz  %4.2fx  %-7s %9.1f %9lld %8.2f%%\n",
+           label, source_rate, speed, stretch ? "wsola" : "rate",
+           avg, (long long)worst, avg / block_us * 100.0);
+
+    time_stretch_free(&ts);
+    resampler_free(&rs);
+}
+
+int resampler_benchmark(void) {
+    const int channels = 2;
+    const size_t frames = 44100 * 10;
+    int16_t *data = (int16_t*)malloc(frames * channels * sizeof(int16_t));
+    if (!data) {
+        printf("Resampler benchmark: out of memory\n");
+        return 1;
+    }
+
+    unsigned int seed = 12345;
+    for (size_t f = 0; f < frames; f++) {
+        for (int c = 0; c < channels; c++) {
+            seed = seed * 1103515245u + 12345u;
+            double tone = sin(2.0 * M_PI * (330.0 * (c + 1)) * f / 44100.0) * 12000.0;
+            double noise = (double)((seed >> 16) & 0x7FFF) / 32768.0 * 4000.0 - 2000.0;
+            data[f * channels + c] = (int16_t)(tone + noise);
+        }
+    }
+
+    BenchSource src = { data, frames, 0, channels };
+    const char *labels[] = { "fast", "medium", "best" };
+    const double speeds[] = { 0.5, 0.75, 1.0, 1.5, 2.0 };
+
+    printf("Resampler benchmark: 1024-frame blocks to 44100 Hz stereo, 400 blocks per row\n");
+    printf("  %-6s %9s  %5s  %-7s %9s %9s %9s\n", "filter", "source", "speed", "mode", "avg us", "max us", "of block");
+    for (int q = RESAMPLE_QUALITY_FAST; q <= RESAMPLE_QUALITY_BEST; q++) {
+        for (size_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++) {
+            bench_run(labels[q], 44100, speeds[s], false, (ResampleQuality)q, &src);
+        }
+        bench_run(labels[q], 48000, 1.0, false, (ResampleQuality)q, &src);
+    }
+    for (size_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++) {
+        if (speeds[s] == 1.0) continue;
+        bench_run(labels[RESAMPLE_QUALITY_MEDIUM], 44100, speeds[s], true, RESAMPLE_QUALITY_MEDIUM, &src);
+    }
+
+    free(data);
+    return 0;
+}
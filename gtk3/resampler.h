@@ -0,0 +1,121 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Frame-based rate conversion for the playback path. The audio device runs
+// at one fixed rate; every source is pulled at its own rate and converted
+// here, with the playback speed folded into the conversion ratio. The
+// optional time stretch stage changes tempo without changing pitch.
+
+#define RESAMPLER_MAX_CHANNELS 2
+#define RESAMPLER_PHASES       256    // Filter rows per input frame, interpolated between
+#define RESAMPLER_MAX_TAPS     32
+#define RESAMPLER_CHUNK        1024   // Frames pulled from upstream per read
+#define RESAMPLER_HISTORY      (RESAMPLER_CHUNK + 2 * RESAMPLER_MAX_TAPS)   // Room to pad for a longer filter
+
+typedef enum {
+    RESAMPLE_QUALITY_FAST,     // 8 taps
+    RESAMPLE_QUALITY_MEDIUM,   // 16 taps
+    RESAMPLE_QUALITY_BEST      // 32 taps
+} ResampleQuality;
+
+// Upstream reader: fill dst with up to max_frames interleaved frames and
+// return how many were written. 0 means nothing is available right now.
+typedef size_t (*AudioReadFn)(void *ctx, int16_t *dst, size_t max_frames);
+
+// Kaiser-windowed sinc table for one tap count and cutoff. Building one
+// costs a few hundred microseconds, so it is done off the audio thread and
+// handed to the resampler, which only reads it.
+typedef struct ResampleFilter {
+    ResampleQuality quality;
+    int taps;
+    double cutoff;           // Relative to input Nyquist, 1.0 only interpolates
+    float coeffs[(RESAMPLER_PHASES + 1) * RESAMPLER_MAX_TAPS];   // PHASES + 1 rows of `taps`
+} ResampleFilter;
+
+ResampleFilter* resample_filter_new(ResampleQuality quality, double cutoff);
+void resample_filter_free(ResampleFilter *filter);
+
+// The cutoff a filter needs for a ratio: reading faster than the output
+// rate pulls the passband down below the output Nyquist
+double resampler_cutoff_for(double ratio);
+
+// Polyphase windowed-sinc resampler
+typedef struct {
+    int channels;
+    double ratio;            // Input frames consumed per output frame
+    ResampleFilter *filter;  // Owned
+    float *history[RESAMPLER_MAX_CHANNELS];   // Deinterleaved input
+    size_t history_len;
+    double position;         // Next output position in history, in frames
+    size_t pending_skip;     // Upstream frames to drop after a large jump
+    bool draining;           // Upstream has ended, see resampler_drain()
+    double drain_end;        // End of the real input in history while draining
+    int16_t *scratch;        // Interleaved upstream reads
+} Resampler;
+
+bool resampler_init(Resampler *rs, int channels, ResampleQuality quality);
+void resampler_free(Resampler *rs);
+void resampler_reset(Resampler *rs);
+
+// Install a filter and return the one it replaces, for the caller to free
+// outside the audio thread. Buffered input is kept, so changing the quality
+// or cutoff doesn't skip.
+ResampleFilter* resampler_swap_filter(Resampler *rs, ResampleFilter *filter);
+
+// Only sets the ratio; the filter for it comes through resampler_swap_filter()
+void resampler_set_ratio(Resampler *rs, double ratio);
+size_t resampler_process(Resampler *rs, int16_t *out, size_t frames, AudioReadFn read, void *ctx);
+
+// Once upstream has ended: the output still owed for input already read,
+// with silence after it so the last frames get their full filter. Returns
+// fewer than `frames` once everything is out.
+size_t resampler_drain(Resampler *rs, int16_t *out, size_t frames);
+
+// WSOLA time stretch. Each hop picks the input segment near the ideal
+// analysis position that best lines up with the natural continuation of the
+// previous one and cross-fades it in, so tempo changes but pitch does not.
+#define TIME_STRETCH_OVERLAP  512    // Output frames per hop, half the segment
+#define TIME_STRETCH_SEEK     256    // Alignment search either side of the ideal position
+#define TIME_STRETCH_BUFFER   8192   // Input frames kept for the search
+
+typedef struct {
+    int channels;
+    double speed;
+    AudioReadFn source;
+    void *source_ctx;
+
+    float *input[RESAMPLER_MAX_CHANNELS];
+    size_t input_len;
+    double analysis_pos;     // Ideal start of the next segment in input
+    size_t prev_start;       // Start of the previous segment
+    bool has_prev;
+
+    float *tail[RESAMPLER_MAX_CHANNELS];   // Faded-out second half of the previous segment
+    float *fade_in;          // Cross-fade curve, fade out is 1 - fade_in
+    float *mono;             // Search scratch
+    int16_t *output;         // One hop of interleaved output
+    size_t output_pos;
+    size_t output_len;
+    bool draining;           // Upstream has ended, see time_stretch_drain()
+    size_t drain_end;        // End of the real input in input while draining
+    int16_t *scratch;
+} TimeStretch;
+
+bool time_stretch_init(TimeStretch *ts, int channels, AudioReadFn source, void *source_ctx);
+void time_stretch_free(TimeStretch *ts);
+void time_stretch_reset(TimeStretch *ts);
+void time_stretch_set_speed(TimeStretch *ts, double speed);
+size_t time_stretch_read(void *ctx, int16_t *dst, size_t max_frames);
+
+// Once upstream has ended: pad the input with silence so the last partial
+// segment and the faded tail of the one before it still come out of
+// time_stretch_read(), which then returns 0 for good
+void time_stretch_drain(TimeStretch *ts);
+
+int resampler_benchmark(void);
+
+#endif // RESAMPLER_H
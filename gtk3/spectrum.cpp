@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "spectrum.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SPECTRUM_X86 1
+#endif
+
+// ---------------------------------------------------------------------------
+// Plan
+// ---------------------------------------------------------------------------
+
+bool fft_plan_init(FFTPlan *plan, int size) {
+    memset(plan, 0, sizeof(*plan));
+
+    int half = size / 2;
+    int log2_half = 0;
+    while ((1 << log2_half) < half) log2_half++;
+    if (size < 8 || (1 << log2_half) != half) {
+        printf("FFT size must be a power of two >= 8 (got %d)\n", size);
+        return false;
+    }
+
+    plan->size = size;
+    plan->half = half;
+    plan->bitrev = (int*)malloc(half * sizeof(int));
+    plan->tw_re = (float*)malloc(half * sizeof(float));
+    plan->tw_im = (float*)malloc(half * sizeof(float));
+    plan->post_re = (float*)malloc((half + 1) * sizeof(float));
+    plan->post_im = (float*)malloc((half + 1) * sizeof(float));
+    plan->window = (float*)malloc(size * sizeof(float));
+
+    if (!plan->bitrev || !plan->tw_re || !plan->tw_im ||
+        !plan->post_re || !plan->post_im || !plan->window) {
+        printf("Failed to allocate FFT plan\n");
+        fft_plan_free(plan);
+        return false;
+    }
+
+    for (int i = 0; i < half; i++) {
+        int r = 0;
+        for (int b = 0; b < log2_half; b++) {
+            if (i & (1 << b)) r |= 1 << (log2_half - 1 - b);
+        }
+        plan->bitrev[i] = r;
+    }
+
+    // Twiddles for butterfly span m live at [m, 2m) so every stage reads a
+    // contiguous run, which is what the SIMD kernels want
+    plan->tw_re[0] = 1.0f;
+    plan->tw_im[0] = 0.0f;
+    for (int m = 1; m < half; m <<= 1) {
+        for (int j = 0; j < m; j++) {
+            double angle = M_PI * j / m;
+            plan->tw_re[m + j] = (float)cos(angle);
+            plan->tw_im[m + j] = (float)-sin(angle);
+        }
+    }
+
+    for (int k = 0; k <= half; k++) {
+        double angle = 2.0 * M_PI * k / size;
+        plan->post_re[k] = (float)cos(angle);
+        plan->post_im[k] = (float)-sin(angle);
+    }
+
+    double window_sum = 0.0;
+    for (int i = 0; i < size; i++) {
+        plan->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / (size - 1)));
+        window_sum += plan->window[i];
+    }
+    plan->gain = (float)(2.0 / window_sum);
+
+    return true;
+}
+
+void fft_plan_free(FFTPlan *plan) {
+    free(plan->bitrev);
+    free(plan->tw_re);
+    free(plan->tw_im);
+    free(plan->post_re);
+    free(plan->post_im);
+    free(plan->window);
+    memset(plan, 0, sizeof(*plan));
+}
+
+// ---------------------------------------------------------------------------
+// Butterfly kernels. Data is split real/imaginary and already in bit-reversed
+// order; each kernel runs one radix-2 stage of span m over the whole array.
+// ---------------------------------------------------------------------------
+
+#ifndef SPECTRUM_X86
+static void fft_stage_scalar(float *re, float *im, const float *tw_re, const float *tw_im, int n, int m) {
+    for (int g = 0; g < n; g += 2 * m) {
+        for (int j = 0; j < m; j++) {
+            int a = g + j;
+            int b = a + m;
+            float wr = tw_re[m + j];
+            float wi = tw_im[m + j];
+            float tr = re[b] * wr - im[b] * wi;
+            float ti = re[b] * wi + im[b] * wr;
+            re[b] = re[a] - tr;
+            im[b] = im[a] - ti;
+            re[a] += tr;
+            im[a] += ti;
+        }
+    }
+}
+#endif
+
+#ifdef SPECTRUM_X86
+// SSE2 is part of x86-64, so this needs no runtime check. Requires m >= 4.
+static void fft_stage_sse2(float *re, float *im, const float *tw_re, const float *tw_im, int n, int m) {
+    for (int g = 0; g < n; g += 2 * m) {
+        for (int j = 0; j < m; j += 4) {
+            float *ra = re + g + j, *ia = im + g + j;
+            float *rb = ra + m, *ib = ia + m;
+            __m128 wr = _mm_loadu_ps(tw_re + m + j);
+            __m128 wi = _mm_loadu_ps(tw_im + m + j);
+            __m128 br = _mm_loadu_ps(rb);
+            __m128 bi = _mm_loadu_ps(ib);
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(br, wr), _mm_mul_ps(bi, wi));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(br, wi), _mm_mul_ps(bi, wr));
+            __m128 ar = _mm_loadu_ps(ra);
+            __m128 ai = _mm_loadu_ps(ia);
+            _mm_storeu_ps(rb, _mm_sub_ps(ar, tr));
+            _mm_storeu_ps(ib, _mm_sub_ps(ai, ti));
+            _mm_storeu_ps(ra, _mm_add_ps(ar, tr));
+            _mm_storeu_ps(ia, _mm_add_ps(ai, ti));
+        }
+    }
+}
+
+// Requires m >= 8
+__attribute__((target("avx2")))
+static void fft_stage_avx2(float *re, float *im, const float *tw_re, const float *tw_im, int n, int m) {
+    for (int g = 0; g < n; g += 2 * m) {
+        for (int j = 0; j < m; j += 8) {
+            float *ra = re + g + j, *ia = im + g + j;
+            float *rb = ra + m, *ib = ia + m;
+            __m256 wr = _mm256_loadu_ps(tw_re + m + j);
+            __m256 wi = _mm256_loadu_ps(tw_im + m + j);
+            __m256 br = _mm256_loadu_ps(rb);
+            __m256 bi = _mm256_loadu_ps(ib);
+            __m256 tr = _mm256_sub_ps(_mm256_mul_ps(br, wr), _mm256_mul_ps(bi, wi));
+            __m256 ti = _mm256_add_ps(_mm256_mul_ps(br, wi), _mm256_mul_ps(bi, wr));
+            __m256 ar = _mm256_loadu_ps(ra);
+            __m256 ai = _mm256_loadu_ps(ia);
+            _mm256_storeu_ps(rb, _mm256_sub_ps(ar, tr));
+            _mm256_storeu_ps(ib, _mm256_sub_ps(ai, ti));
+            _mm256_storeu_ps(ra, _mm256_add_ps(ar, tr));
+            _mm256_storeu_ps(ia, _mm256_add_ps(ai, ti));
+        }
+    }
+}
+
+static bool cpu_has_avx2(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return cached == 1;
+}
+#endif
+
+// First two stages fused into one radix-4 pass; their twiddles are 1 and -i
+static void fft_radix4_first_pass(float *re, float *im, int n) {
+    for (int g = 0; g < n; g += 4) {
+        float b0r = re[g] + re[g + 1],     b0i = im[g] + im[g + 1];
+        float b1r = re[g] - re[g + 1],     b1i = im[g] - im[g + 1];
+        float b2r = re[g + 2] + re[g + 3], b2i = im[g + 2] + im[g + 3];
+        float b3r = re[g + 2] - re[g + 3], b3i = im[g + 2] - im[g + 3];
+
+        re[g]     = b0r + b2r;  im[g]     = b0i + b2i;
+        re[g + 2] = b0r - b2r;  im[g + 2] = b0i - b2i;
+        // b3 * -i = (b3i, -b3r)
+        re[g + 1] = b1r + b3i;  im[g + 1] = b1i - b3r;
+        re[g + 3] = b1r - b3i;  im[g + 3] = b1i + b3r;
+    }
+}
+
+static void fft_complex(const FFTPlan *plan, float *re, float *im) {
+    int n = plan->half;
+    fft_radix4_first_pass(re, im, n);
+
+    for (int m = 4; m < n; m <<= 1) {
+#ifdef SPECTRUM_X86
+        if (m >= 8 && cpu_has_avx2()) {
+            fft_stage_avx2(re, im, plan->tw_re, plan->tw_im, n, m);
+        } else {
+            fft_stage_sse2(re, im, plan->tw_re, plan->tw_im, n, m);
+        }
+#else
+        fft_stage_scalar(re, im, plan->tw_re, plan->tw_im, n, m);
+#endif
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Spectrum
+// ---------------------------------------------------------------------------
+
+bool spectrum_init(Spectrum *spec) {
+    memset(spec, 0, sizeof(*spec));
+    if (!fft_plan_init(&spec->plan, SPECTRUM_FFT_SIZE)) return false;
+
+    int half = spec->plan.half;
+    spec->re = (float*)calloc(half, sizeof(float));
+    spec->im = (float*)calloc(half, sizeof(float));
+    spec->bin_re = (float*)calloc(SPECTRUM_BINS, sizeof(float));
+    spec->bin_im = (float*)calloc(SPECTRUM_BINS, sizeof(float));
+    spec->magnitude = (float*)calloc(SPECTRUM_BINS, sizeof(float));
+    spec->sample_rate = 44100;
+
+    if (!spec->re || !spec->im || !spec->bin_re || !spec->bin_im || !spec->magnitude) {
+        printf("Failed to allocate spectrum buffers\n");
+        spectrum_free(spec);
+        return false;
+    }
+    return true;
+}
+
+void spectrum_free(Spectrum *spec) {
+    fft_plan_free(&spec->plan);
+    free(spec->re);
+    free(spec->im);
+    free(spec->bin_re);
+    free(spec->bin_im);
+    free(spec->magnitude);
+    spec->re = spec->im = NULL;
+    spec->bin_re = spec->bin_im = spec->magnitude = NULL;
+    spec->valid = false;
+}
+
+// mono holds SPECTRUM_FFT_SIZE samples, oldest first
+void spectrum_process(Spectrum *spec, const int16_t *mono, int sample_rate) {
+    const FFTPlan *plan = &spec->plan;
+    int half = plan->half;
+    const float scale = 1.0f / 32768.0f;
+
+    if (!spec->re) return;
+    if (sample_rate > 0) spec->sample_rate = sample_rate;
+
+    // Window and pack even/odd samples as one complex signal of half the
+    // length, written straight into bit-reversed order
+    for (int k = 0; k < half; k++) {
+        int dst = plan->bitrev[k];
+        spec->re[dst] = mono[2 * k] * scale * plan->window[2 * k];
+        spec->im[dst] = mono[2 * k + 1] * scale * plan->window[2 * k + 1];
+    }
+
+    fft_complex(plan, spec->re, spec->im);
+
+    // Split the half-length complex result into the real signal's spectrum
+    for (int k = 0; k <= half; k++) {
+        int ka = (k == half) ? 0 : k;
+        int kb = (k == 0) ? 0 : half - k;
+        float ar = spec->re[ka], ai = spec->im[ka];
+        float br = spec->re[kb], bi = spec->im[kb];
+
+        float even_r = 0.5f * (ar + br);
+        float even_i = 0.5f * (ai - bi);
+        float odd_r = 0.5f * (ai + bi);
+        float odd_i = -0.5f * (ar - br);
+
+        float wr = plan->post_re[k], wi = plan->post_im[k];
+        float xr = (even_r + wr * odd_r - wi * odd_i) * plan->gain;
+        float xi = (even_i + wr * odd_i + wi * odd_r) * plan->gain;
+
+        spec->bin_re[k] = xr;
+        spec->bin_im[k] = xi;
+        spec->magnitude[k] = sqrtf(xr * xr + xi * xi);
+    }
+
+    spec->valid = true;
+}
+
+int spectrum_frequency_to_bin(const Spectrum *spec, double hz) {
+    int bin = (int)(hz * spec->plan.size / spec->sample_rate + 0.5);
+    if (bin < 1) bin = 1;
+    if (bin > SPECTRUM_BINS - 1) bin = SPECTRUM_BINS - 1;
+    return bin;
+}
+
+// Bin at log-spaced position index/count between the min and max frequency
+int spectrum_log_bin(const Spectrum *spec, int index, int count) {
+    double max_freq = fmin(SPECTRUM_MAX_FREQ, spec->sample_rate * 0.5);
+    double t = count > 0 ? (double)index / count : 0.0;
+    double hz = SPECTRUM_MIN_FREQ * pow(max_freq / SPECTRUM_MIN_FREQ, t);
+    return spectrum_frequency_to_bin(spec, hz);
+}
+
+// Peak level of bins [first_bin, last_bin] mapped from dB to 0..1
+double spectrum_band_level(const Spectrum *spec, int first_bin, int last_bin) {
+    if (!spec->valid) return 0.0;
+    if (last_bin < first_bin) last_bin = first_bin;
+
+    float peak = 0.0f;
+    for (int k = first_bin; k <= last_bin && k < SPECTRUM_BINS; k++) {
+        if (spec->magnitude[k] > peak) peak = spec->magnitude[k];
+    }
+
+    double db = 20.0 * log10(peak + 1e-9);
+    double level = (db - SPECTRUM_FLOOR_DB) / -SPECTRUM_FLOOR_DB;
+    if (level < 0.0) level = 0.0;
+    if (level > 1.0) level = 1.0;
+    return level;
+}
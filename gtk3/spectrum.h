@@ -0,0 +1,52 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Windowed real FFT shared by all spectrum-driven visualizers. One frame is
+// the latest SPECTRUM_FFT_SIZE mono samples, so consecutive frames overlap.
+
+#define SPECTRUM_FFT_SIZE   2048
+#define SPECTRUM_BINS       (SPECTRUM_FFT_SIZE / 2 + 1)
+#define SPECTRUM_MIN_FREQ   40.0
+#define SPECTRUM_MAX_FREQ   16000.0
+#define SPECTRUM_FLOOR_DB   -70.0
+
+// Everything that only depends on the FFT size, computed once
+typedef struct {
+    int size;            // Real transform length
+    int half;            // Complex transform length (size / 2)
+    int *bitrev;         // Bit-reversal permutation, half entries
+    float *tw_re;        // Butterfly twiddles, [span + j] for span 1..half/2
+    float *tw_im;
+    float *post_re;      // Real-FFT split twiddles, half + 1 entries
+    float *post_im;
+    float *window;       // Hann window, size entries
+    float gain;          // 2 / sum(window), scales a full-scale sine to 1.0
+} FFTPlan;
+
+typedef struct {
+    FFTPlan plan;
+    float *re;           // Complex workspace, half entries
+    float *im;
+    float *bin_re;       // Spectrum of the last frame, SPECTRUM_BINS entries,
+    float *bin_im;       // normalised so a full-scale sine has magnitude 1.0
+    float *magnitude;
+    int sample_rate;
+    bool valid;          // At least one frame processed
+} Spectrum;
+
+bool fft_plan_init(FFTPlan *plan, int size);
+void fft_plan_free(FFTPlan *plan);
+
+bool spectrum_init(Spectrum *spec);
+void spectrum_free(Spectrum *spec);
+void spectrum_process(Spectrum *spec, const int16_t *mono, int sample_rate);
+
+int spectrum_frequency_to_bin(const Spectrum *spec, double hz);
+int spectrum_log_bin(const Spectrum *spec, int index, int count);
+double spectrum_band_level(const Spectrum *spec, int first_bin, int last_bin);
+
+#endif // SPECTRUM_H
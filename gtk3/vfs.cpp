@@ -5,6 +5,7 @@
 #include <pthread.h>
 #include "vfs.h"
 #include "audio_player.h"
+#include "midi_renderer.h"
 
 // Global virtual filesystem
 static GHashTable* virtual_filesystem = NULL;
@@ -299,124 +300,80 @@ void virtual_wav_converter_free(VirtualWAVConverter* converter) {
     }
 }
 
-// Modified functions for the audio player
-bool convert_midi_to_virtual_wav(AudioPlayer *player, const char* filename) {
-    // Generate a unique virtual filename
-    static int virtual_counter = 0;
-    char virtual_filename[256];
-    snprintf(virtual_filename, sizeof(virtual_filename), "virtual_midi_%d.wav", virtual_counter++);
-    
-    strncpy(player->temp_wav_file, virtual_filename, sizeof(player->temp_wav_file) - 1);
-    player->temp_wav_file[sizeof(player->temp_wav_file) - 1] = '\0';
-    
-    printf("Converting MIDI to virtual WAV: %s -> %s\n", filename, virtual_filename);
-    
-    // Temporarily shut down the main SDL audio system
-    if (player->audio_device) {
-        SDL_CloseAudioDevice(player->audio_device);
-        player->audio_device = 0;
-    }
-    SDL_QuitSubSystem(SDL_INIT_AUDIO);
-    
-    playTime = 0;
-    isPlaying = true;
-    
-    if (!initSDL()) {
-        printf("SDL init for conversion failed\n");
-        return false;
-    }
-    
-    if (!loadMidiFile(filename)) {
+// Render a MIDI file straight into a virtual WAV: parser and OPL synth in,
+// PCM out, no audio device involved, so the player's output can stay open
+// while the next track is prepared. A partial file is deleted on failure.
+bool render_midi_to_virtual_wav(const char* filename, const char* virtual_filename) {
+    MidiRenderer *renderer = midi_renderer_new(SAMPLE_RATE, 100);
+    if (!midi_renderer_load(renderer, filename)) {
         printf("MIDI file load failed\n");
-        cleanup();
+        midi_renderer_free(renderer);
         return false;
     }
     
     VirtualWAVConverter* wav_converter = virtual_wav_converter_init(virtual_filename, SAMPLE_RATE, AUDIO_CHANNELS);
     if (!wav_converter) {
         printf("Virtual WAV converter init failed\n");
-        cleanup();
+        midi_renderer_free(renderer);
         return false;
     }
     
     int16_t audio_buffer[AUDIO_BUFFER * AUDIO_CHANNELS];
-    double buffer_duration = (double)AUDIO_BUFFER / SAMPLE_RATE;
+    int last_reported = -1;
+    bool ok = true;
+    int frames;
     
-    processEvents();
-    
-    while (isPlaying) {
-        memset(audio_buffer, 0, sizeof(audio_buffer));
-        OPL_Generate(audio_buffer, AUDIO_BUFFER);
-        
-        if (!virtual_wav_converter_write(wav_converter, audio_buffer, AUDIO_BUFFER * AUDIO_CHANNELS)) {
+    while ((frames = midi_renderer_render(renderer, audio_buffer, AUDIO_BUFFER)) > 0) {
+        if (!virtual_wav_converter_write(wav_converter, audio_buffer, frames * AUDIO_CHANNELS)) {
             printf("Virtual WAV write failed\n");
+            ok = false;
             break;
         }
         
-        playTime += buffer_duration;
-        playwait -= buffer_duration;
-        
-        while (playwait <= 0 && isPlaying) {
-            processEvents();
+        int seconds = (int)renderer->play_time;
+        if (seconds >= MIDI_RENDER_TIMEOUT) {
+            // Songs with loop markers never end by themselves
+            printf("MIDI conversion timed out after %d seconds\n", MIDI_RENDER_TIMEOUT);
+            ok = false;
+            break;
         }
-        
-        if (((int)playTime) % 10 == 0) {
-            static int last_reported = -1;
-            if ((int)playTime != last_reported) {
-                printf("Converting... %d seconds\n", (int)playTime);
-                last_reported = (int)playTime;
-            }
+        if (seconds % 10 == 0 && seconds != last_reported) {
+            printf("Converting... %d seconds\n", seconds);
+            last_reported = seconds;
         }
     }
     
     virtual_wav_converter_finish(wav_converter);
     virtual_wav_converter_free(wav_converter);
-    cleanup();
     
-    printf("Virtual conversion complete: %.2f seconds\n", playTime);
+    double rendered_seconds = renderer->play_time;
+    midi_renderer_free(renderer);
+    printf("Virtual conversion complete: %.2f seconds\n", rendered_seconds);
     
-    // Reinitialize the main SDL audio system for playback
-    printf("Reinitializing SDL audio for playback...\n");
-    if (!init_audio(player)) {
-        printf("Failed to reinitialize audio for playback\n");
-        return false;
+    if (ok && rendered_seconds <= 0.1) {
+        printf("MIDI conversion produced no audio\n");
+        ok = false;
+    }
+    if (!ok) {
+        delete_virtual_file(virtual_filename);
     }
+    return ok;
+}
+
+bool convert_midi_to_virtual_wav(AudioPlayer *player, const char* filename) {
+    // Generate a unique virtual filename
+    static int virtual_counter = 0;
+    char virtual_filename[256];
+    snprintf(virtual_filename, sizeof(virtual_filename), "virtual_midi_%d.wav", virtual_counter++);
     
-    return true;
+    strncpy(player->temp_wav_file, virtual_filename, sizeof(player->temp_wav_file) - 1);
+    player->temp_wav_file[sizeof(player->temp_wav_file) - 1] = '\0';
+    
+    printf("Converting MIDI to virtual WAV: %s -> %s\n", filename, virtual_filename);
+    return render_midi_to_virtual_wav(filename, virtual_filename);
 }
 
 bool load_virtual_wav_file(AudioPlayer *player, const char* virtual_filename) {
-    // Check cache first (use virtual filename as key)
-    CachedAudioBuffer *cached = find_in_cache(&player->audio_cache, virtual_filename);
-    if (cached) {
-        player->sample_rate = cached->sample_rate;
-        player->channels = cached->channels;
-        player->bits_per_sample = cached->bits_per_sample;
-        player->song_duration = cached->song_duration;
-        
-        if (!init_audio(player, player->sample_rate, player->channels)) {
-            return false;
-        }
-        
-        // COPY data from cache
-        int16_t *data_copy = malloc(cached->length * sizeof(int16_t));
-        if (!data_copy) return false;
-        memcpy(data_copy, cached->data, cached->length * sizeof(int16_t));
-        
-        pthread_mutex_lock(&player->audio_mutex);
-        if (player->audio_buffer.data) free(player->audio_buffer.data);
-        player->audio_buffer.data = data_copy;
-        player->audio_buffer.length = cached->length;
-        player->audio_buffer.position = 0;
-        pthread_mutex_unlock(&player->audio_mutex);
-        
-        printf("Loaded virtual file from cache: %zu samples\n", cached->length);
-        
-        // Can delete virtual file now since it's in cache
-        delete_virtual_file(virtual_filename);
-        return true;
-    }
-    
     VirtualFile* vf = get_virtual_file(virtual_filename);
     if (!vf) {
         printf("Cannot open virtual WAV file: %s\n", virtual_filename);
@@ -448,7 +405,7 @@ bool load_virtual_wav_file(AudioPlayer *player, const char* virtual_filename) {
            player->sample_rate, player->channels, player->bits_per_sample);
     
     // Reinitialize audio with the correct sample rate and channels
-    if (!init_audio(player, player->sample_rate, player->channels)) {
+    if (!init_audio(player)) {
         printf("Failed to reinitialize audio for virtual WAV format\n");
         return false;
     }
@@ -460,44 +417,32 @@ bool load_virtual_wav_file(AudioPlayer *player, const char* virtual_filename) {
     player->song_duration = data_size / (double)(player->sample_rate * player->channels * (player->bits_per_sample / 8));
     printf("Virtual WAV duration: %.2f seconds\n", player->song_duration);
     
-    // Allocate NEW buffer (separate from VirtualFile)
-    int16_t* wav_data = (int16_t*)malloc(data_size);
-    if (!wav_data) {
+    // Copy out of the virtual file into a shareable block, the virtual
+    // file is deleted below
+    size_t samples = data_size / sizeof(int16_t);
+    PCMBlock *block = pcm_block_create(samples);
+    if (!block) {
         printf("Memory allocation failed\n");
         return false;
     }
     
-    // COPY data from virtual file (don't share the pointer)
-    if (virtual_file_read(vf, wav_data, data_size) != data_size) {
+    if (virtual_file_read(vf, block->data, samples * sizeof(int16_t)) != samples * sizeof(int16_t)) {
         printf("Virtual WAV data read failed\n");
-        free(wav_data);
+        pcm_block_unref(block);
         return false;
     }
+    pcm_block_seal(block);
     
-    // Make a copy for cache
-    int16_t *cache_copy = malloc(data_size);
-    if (cache_copy) {
-        memcpy(cache_copy, wav_data, data_size);
-        add_to_cache(&player->audio_cache, virtual_filename, cache_copy,
-                     data_size / sizeof(int16_t), player->sample_rate,
-                     player->channels, player->bits_per_sample,
-                     player->song_duration);
-    }
+    // Not cached under the virtual name, which is unique per conversion;
+    // load_file() caches the block under the source path instead
     
     // Store in audio buffer
-    pthread_mutex_lock(&player->audio_mutex);
-    if (player->audio_buffer.data) {
-        free(player->audio_buffer.data);
-    }
-    player->audio_buffer.data = wav_data;
-    player->audio_buffer.length = data_size / sizeof(int16_t);
-    player->audio_buffer.position = 0;
-    pthread_mutex_unlock(&player->audio_mutex);
+    set_audio_source(player, block, NULL, block->length);
     
     printf("Loaded %zu samples from virtual file\n", player->audio_buffer.length);
     
-    // NOW delete the virtual file since we've copied the data and cached it
-    printf("Deleting virtual file '%s' after copying to cache\n", virtual_filename);
+    // NOW delete the virtual file since we've copied the data out
+    printf("Deleting virtual file '%s' after copying\n", virtual_filename);
     fflush(stdout);
     delete_virtual_file(virtual_filename);
     
@@ -47,4 +47,8 @@ void virtual_wav_converter_finish(VirtualWAVConverter* converter);
 void virtual_wav_converter_free(VirtualWAVConverter* converter);
 bool load_virtual_wav_file(AudioPlayer *player, const char* virtual_filename);
 
+// Longest MIDI render before giving up, in seconds of audio
+#define MIDI_RENDER_TIMEOUT 300
+bool render_midi_to_virtual_wav(const char* filename, const char* virtual_filename);
+
 #endif // VIRTUAL_FILESYSTEM_H
@@ -21,7 +21,6 @@ Visualizer* visualizer_new(void) {
     vis->audio_samples = g_malloc0(VIS_SAMPLES * sizeof(double));
     vis->frequency_bands = g_malloc0(VIS_FREQUENCY_BARS * sizeof(double));
     vis->peak_data = g_malloc0(VIS_FREQUENCY_BARS * sizeof(double));
-    vis->band_values = g_malloc0(VIS_FREQUENCY_BARS * sizeof(double));
     
     // Initialize history
     for (int i = 0; i < VIS_HISTORY_SIZE; i++) {
@@ -29,8 +28,13 @@ Visualizer* visualizer_new(void) {
     }
     vis->history_index = 0;
     
-    // Initialize simple frequency band analysis
-    init_frequency_bands(vis);
+    // Triple buffer: slot 0 for the audio thread, 1 spare, 2 for the GUI
+    vis->snapshot.write_index = 0;
+    vis->snapshot.shared.store(1);
+    vis->snapshot.read_index = 2;
+    
+    // FFT plan and buffers shared by every spectrum visualizer
+    spectrum_init(&vis->spectrum);
 
     // Fractal
     init_mandelbrot_system(vis);
@@ -125,13 +129,9 @@ void visualizer_free(Visualizer *vis) {
     g_free(vis->audio_samples);
     g_free(vis->frequency_bands);
     g_free(vis->peak_data);
-    g_free(vis->band_values);
-    
-    for (int i = 0; i < VIS_FREQUENCY_BARS; i++) {
-        if (vis->band_filters[i]) {
-            g_free(vis->band_filters[i]);
-        }
-    }
+    spectrum_free(&vis->spectrum);
+    cleanup_mandelbrot_system(vis);
+    cleanup_maze3d_system(vis);
     
     for (int i = 0; i < VIS_HISTORY_SIZE; i++) {
         g_free(vis->history[i]);
@@ -258,9 +258,6 @@ void visualizer_update_audio_data(Visualizer *vis, int16_t *samples, size_t samp
     
     // Calculate overall volume level (RMS)
     vis->volume_level = sqrt(rms_sum / VIS_SAMPLES);
-    
-    // Process simple frequency analysis
-    process_audio_simple(vis);
 }
 
 void visualizer_set_enabled(Visualizer *vis, gboolean enabled) {
@@ -276,53 +273,75 @@ void visualizer_set_enabled(Visualizer *vis, gboolean enabled) {
     }
 }
 
-void init_frequency_bands(Visualizer *vis) {
-    // Create simple frequency band filters using moving averages
-    // This is a basic approximation without FFT
-    for (int band = 0; band < VIS_FREQUENCY_BARS; band++) {
-        vis->band_filters[band] = g_malloc0(VIS_SAMPLES * sizeof(double));
-        
-        // Create simple band-pass filter coefficients
-        // Lower bands = longer averaging windows (bass)
-        // Higher bands = shorter averaging windows (treble)
-        int window_size = VIS_SAMPLES / (band + 2);
-        if (window_size < 2) window_size = 2;
-        if (window_size > VIS_SAMPLES / 4) window_size = VIS_SAMPLES / 4;
-        
-        for (int i = 0; i < window_size; i++) {
-            vis->band_filters[band][i] = 1.0 / window_size;
+// Called from the audio callback: copy the block and swap it into the spare
+// slot. No locks, no allocation, and none of the analysis happens here.
+void visualizer_publish_audio(Visualizer *vis, const int16_t *samples, size_t frame_count, int channels, int sample_rate) {
+    if (!vis || !samples || frame_count == 0 || channels <= 0) return;
+    
+    VisSnapshotBuffer *buf = &vis->snapshot;
+    VisAudioSnapshot *slot = &buf->slots[buf->write_index];
+    
+    // Every block goes into the mono history, even the part that does not
+    // fit the snapshot, so the FFT frame is always the latest audio
+    const size_t mask = SPECTRUM_FFT_SIZE - 1;
+    size_t pos = buf->fft_history_pos;
+    for (size_t i = 0; i < frame_count; i++) {
+        int sum = 0;
+        for (int c = 0; c < channels; c++) {
+            sum += samples[i * channels + c];
         }
+        buf->fft_history[pos & mask] = (int16_t)(sum / channels);
+        pos++;
+    }
+    buf->fft_history_pos = pos;
+    
+    size_t start = pos & mask;
+    memcpy(slot->mono, buf->fft_history + start, (SPECTRUM_FFT_SIZE - start) * sizeof(int16_t));
+    memcpy(slot->mono + (SPECTRUM_FFT_SIZE - start), buf->fft_history, start * sizeof(int16_t));
+    slot->sample_rate = sample_rate;
+    
+    size_t max_frames = VIS_SNAPSHOT_SAMPLES / channels;
+    if (frame_count > max_frames) frame_count = max_frames;
+    
+    memcpy(slot->samples, samples, frame_count * channels * sizeof(int16_t));
+    slot->frame_count = frame_count;
+    slot->channels = channels;
+    
+    int previous = buf->shared.exchange(buf->write_index | VIS_SNAPSHOT_FRESH, std::memory_order_acq_rel);
+    buf->write_index = previous & (VIS_SNAPSHOT_FRESH - 1);
+}
+
+// Called from the GUI timer: pick up the newest block, if any, and run the
+// waveform/RMS/band analysis on it
+bool visualizer_consume_audio(Visualizer *vis) {
+    VisSnapshotBuffer *buf = &vis->snapshot;
+    
+    if (!(buf->shared.load(std::memory_order_acquire) & VIS_SNAPSHOT_FRESH)) {
+        return false;
+    }
+    
+    int previous = buf->shared.exchange(buf->read_index, std::memory_order_acq_rel);
+    buf->read_index = previous & (VIS_SNAPSHOT_FRESH - 1);
+    
+    VisAudioSnapshot *slot = &buf->slots[buf->read_index];
+    visualizer_update_audio_data(vis, slot->samples, slot->frame_count, slot->channels);
+    
+    if (vis->enabled) {
+        spectrum_process(&vis->spectrum, slot->mono, slot->sample_rate);
+        visualizer_update_spectrum(vis);
     }
+    return true;
 }
 
-void process_audio_simple(Visualizer *vis) {
-    // Simple frequency band analysis using filtering
+// Map the shared FFT onto the log-spaced bars used by the bar, radial and
+// trippy visualizers
+void visualizer_update_spectrum(Visualizer *vis) {
     for (int band = 0; band < VIS_FREQUENCY_BARS; band++) {
-        double band_energy = 0.0;
+        int first_bin = spectrum_log_bin(&vis->spectrum, band, VIS_FREQUENCY_BARS);
+        int last_bin = spectrum_log_bin(&vis->spectrum, band + 1, VIS_FREQUENCY_BARS) - 1;
         
-        // Split the audio samples into frequency-like bands
-        // Each band analyzes a different section of the sample array
-        int samples_per_band = VIS_SAMPLES / VIS_FREQUENCY_BARS;
-        int start_idx = band * samples_per_band;
-        int end_idx = start_idx + samples_per_band;
-        if (end_idx > VIS_SAMPLES) end_idx = VIS_SAMPLES;
-        
-        // Calculate RMS energy for this band
-        for (int i = start_idx; i < end_idx; i++) {
-            band_energy += vis->audio_samples[i] * vis->audio_samples[i];
-        }
-        
-        if (end_idx > start_idx) {
-            band_energy = sqrt(band_energy / (end_idx - start_idx));
-        }
-        
-        // Apply some frequency-based weighting
-        // Higher frequencies get boosted slightly for visual balance
-        double freq_weight = 1.0 + (double)band / VIS_FREQUENCY_BARS * 0.5;
-        band_energy *= freq_weight;
-        
-        // Apply logarithmic scaling for better visual representation
-        band_energy = log(1.0 + band_energy * 10.0) / log(11.0);
+        // Levels are in dB, so sensitivity acts as a gain on the 0..1 scale
+        double band_energy = spectrum_band_level(&vis->spectrum, first_bin, last_bin) * vis->sensitivity;
         
         // Clamp to reasonable range
         if (band_energy > 1.0) band_energy = 1.0;
@@ -532,6 +551,9 @@ gboolean visualizer_timer_callback(gpointer user_data) {
     static VisualizationType last_vis_type = VIS_WAVEFORM;
     
     if (vis->enabled) {
+        // Analyse whatever the audio callback published since the last tick
+        visualizer_consume_audio(vis);
+        
         bool vis_type_changed = (last_vis_type != vis->type);
         
         // Check if window is visible on screen
@@ -5,6 +5,8 @@
 #include <cairo.h>
 #include <math.h>
 #include <string.h>
+#include <stdint.h>
+#include <atomic>
 #include "sudoku.h"
 #include "generatepuzzle.h"
 #include "bouncyball.h"
@@ -31,10 +33,37 @@
 #include "bouncingcircle.h"
 #include "mandelbrot.h"
 #include "pong.h"
+#include "spectrum.h"
 
 #define VIS_SAMPLES 512
 #define VIS_FREQUENCY_BARS 32
 #define VIS_HISTORY_SIZE 64
+#define VIS_SNAPSHOT_SAMPLES 8192   // Max interleaved samples kept per audio block
+
+// Raw audio block handed from the audio callback to the GUI thread
+typedef struct {
+    int16_t samples[VIS_SNAPSHOT_SAMPLES];
+    size_t frame_count;
+    int channels;
+    int16_t mono[SPECTRUM_FFT_SIZE];   // Latest FFT frame, oldest sample first
+    int sample_rate;
+} VisAudioSnapshot;
+
+// Lock-free triple buffer. The audio callback fills write_index, the GUI
+// reads read_index, and the spare slot is swapped through `shared`, whose
+// VIS_SNAPSHOT_FRESH bit says a new block is waiting.
+#define VIS_SNAPSHOT_FRESH 4
+
+typedef struct {
+    VisAudioSnapshot slots[3];
+    std::atomic<int> shared;
+    int write_index;    // Audio thread only
+    int read_index;     // GUI thread only
+    
+    // Mono history so each FFT frame overlaps the previous one, audio thread only
+    int16_t fft_history[SPECTRUM_FFT_SIZE];
+    size_t fft_history_pos;
+} VisSnapshotBuffer;
 
 typedef enum {
     VIS_WAVEFORM,
@@ -86,7 +115,11 @@ typedef struct {
     double error_display_time;
     bool showing_error;
 
+    // Latest audio from the playback callback, analysed on the GUI timer
+    VisSnapshotBuffer snapshot;
+
     // Audio analysis data
+    Spectrum spectrum;
     double *audio_samples;
     double *frequency_bands;
     double *peak_data;
@@ -112,10 +145,6 @@ typedef struct {
     bool cdg_needs_update;
     int cdg_last_packet;
     
-    // Simple frequency analysis without FFT
-    double *band_filters[VIS_FREQUENCY_BARS];  // Use renamed constant
-    double *band_values;
-    
     // Visualization settings
     VisualizationType type;
     double sensitivity;
@@ -361,6 +390,8 @@ Visualizer* visualizer_new(void);
 void visualizer_free(Visualizer *vis);
 void visualizer_set_type(Visualizer *vis, VisualizationType type);
 void visualizer_update_audio_data(Visualizer *vis, int16_t *samples, size_t sample_count, int channels);
+void visualizer_publish_audio(Visualizer *vis, const int16_t *samples, size_t frame_count, int channels, int sample_rate);
+bool visualizer_consume_audio(Visualizer *vis);
 void visualizer_set_enabled(Visualizer *vis, gboolean enabled);
 GtkWidget* create_visualization_controls(Visualizer *vis);
 
@@ -374,8 +405,7 @@ void draw_bars(Visualizer *vis, cairo_t *cr);
 void draw_circle(Visualizer *vis, cairo_t *cr);
 void draw_volume_meter(Visualizer *vis, cairo_t *cr);
 void draw_bubbles(Visualizer *vis, cairo_t *cr);
-void process_audio_simple(Visualizer *vis);
-void init_frequency_bands(Visualizer *vis);
+void visualizer_update_spectrum(Visualizer *vis);
 bool save_last_visualization(VisualizationType vis_type);
 bool load_last_visualization(VisualizationType *vis_type);
 static gboolean on_queue_focus_in(GtkWidget *widget, GdkEventFocus *event, gpointer user_data);
@@ -644,6 +674,7 @@ void generate_maze(Maze3D *maze);
 void solve_maze(Maze3D *maze);
 void update_maze3d(Visualizer *vis, double dt);
 void draw_maze3d(Visualizer *vis, cairo_t *cr);
+void cleanup_maze3d_system(Visualizer *vis);
 void draw_penguin_3d(cairo_t *cr, double screen_x, double distance, double scale, 
                      double rotation, double bob_offset, gboolean found, double pulse);
 
@@ -663,6 +694,7 @@ void draw_bouncing_circle(void *vis, cairo_t *cr, double width, double height, B
 
 // Initialization and cleanup
 void init_mandelbrot_system(void *vis);
+void cleanup_mandelbrot_system(void *vis);
 
 // Update and render
 void update_mandelbrot(void *vis, double dt);
@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <chrono>
+#include "midiplayer.h"
+#include "midi_renderer.h"
+#include "dbopl_wrapper.h"
+#include "dbopl.h"
+
+// Render speed benchmark for the player's MIDI -> PCM path (../gtk3).
+// Every file is rendered into a null sink and reported as one JSON object
+// per line on stdout, so results can be collected and compared across
+// builds. Progress and the renderer's own logging go to stderr.
+
+#define BENCH_BLOCK       1024   // Frames per render call, what the audio callback asks for
+#define STRESS_SECONDS    60     // Length of each synthetic stress file
+#define STRESS_DIVISION   480    // Ticks per quarter note; 960 ticks a second at 120 BPM
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} ByteBuffer;
+
+typedef struct {
+    int events;
+    uint64_t frames;
+    double audio_seconds;
+    double wall_seconds;
+    double dispatch_seconds;
+    double synth_seconds;
+    long peak_rss_kb;
+    uint64_t checksum;
+} BenchResult;
+
+static FILE *results = NULL;
+
+/*
+ * Synthetic stress files
+ */
+
+static void put_byte(ByteBuffer *bb, uint8_t value) {
+    if (bb->size == bb->capacity) {
+        size_t capacity = bb->capacity ? bb->capacity * 2 : 4096;
+        uint8_t *data = (uint8_t*)realloc(bb->data, capacity);
+        if (!data) {
+            fprintf(stderr, "Out of memory building stress file\n");
+            exit(1);
+        }
+        bb->data = data;
+        bb->capacity = capacity;
+    }
+    bb->data[bb->size++] = value;
+}
+
+static void put_big_endian(ByteBuffer *bb, uint32_t value, int len) {
+    for (int i = len - 1; i >= 0; i--) {
+        put_byte(bb, (uint8_t)(value >> (i * 8)));
+    }
+}
+
+static void put_var_len(ByteBuffer *bb, uint32_t value) {
+    uint8_t bytes[4];
+    int count = 0;
+    do {
+        bytes[count++] = value & 0x7F;
+        value >>= 7;
+    } while (value && count < 4);
+    while (count > 1) put_byte(bb, bytes[--count] | 0x80);
+    put_byte(bb, bytes[0]);
+}
+
+static void put_event(ByteBuffer *bb, uint32_t delay, uint8_t status, uint8_t data1, int data2) {
+    put_var_len(bb, delay);
+    put_byte(bb, status);
+    put_byte(bb, data1);
+    if (data2 >= 0) put_byte(bb, (uint8_t)data2);
+}
+
+// Wrap one track's events in a format 0 file
+static void finish_file(ByteBuffer *file, ByteBuffer *track, uint32_t delay) {
+    put_var_len(track, delay);
+    put_byte(track, META_EVENT);
+    put_byte(track, META_END_OF_TRACK);
+    put_byte(track, 0);
+
+    put_big_endian(file, 0x4D546864, 4);   // MThd
+    put_big_endian(file, 6, 4);
+    put_big_endian(file, 0, 2);
+    put_big_endian(file, 1, 2);
+    put_big_endian(file, STRESS_DIVISION, 2);
+    put_big_endian(file, 0x4D54726B, 4);   // MTrk
+    put_big_endian(file, (uint32_t)track->size, 4);
+    for (size_t i = 0; i < track->size; i++) put_byte(file, track->data[i]);
+    free(track->data);
+}
+
+// Six note chords on all 16 channels, struck again every eighth of a
+// second: far more notes than OPL voices, so the allocator steals constantly
+static void build_polyphony_stress(ByteBuffer *file) {
+    ByteBuffer track = {NULL, 0, 0};
+    const int ticks_per_chord = STRESS_DIVISION / 4;
+    const int chords = STRESS_SECONDS * 8;
+    uint32_t delay = 0;
+
+    for (int c = 0; c < chords; c++) {
+        for (int ch = 0; ch < 16; ch++) {
+            int root = 36 + (c * 5 + ch * 3) % 48;
+            if (c > 0) {
+                int old_root = 36 + ((c - 1) * 5 + ch * 3) % 48;
+                for (int n = 0; n < 6; n++) {
+                    put_event(&track, delay, NOTE_OFF | ch, (uint8_t)(old_root + n * 4), 0);
+                    delay = 0;
+                }
+            }
+            if (c % 16 == 0 && ch != 9) {
+                put_event(&track, delay, PROGRAM_CHANGE | ch, (uint8_t)((c / 16 * 7 + ch * 8) % 128), -1);
+                delay = 0;
+            }
+            for (int n = 0; n < 6; n++) {
+                put_event(&track, delay, NOTE_ON | ch, (uint8_t)(root + n * 4), 64 + (n * 11 + c) % 64);
+                delay = 0;
+            }
+        }
+        delay = ticks_per_chord;
+    }
+    finish_file(file, &track, delay);
+}
+
+// Two held notes on every channel under a stream of pitch bends and volume,
+// pan and modulation changes, one batch per channel every 4 ticks
+static void build_controller_stress(ByteBuffer *file) {
+    ByteBuffer track = {NULL, 0, 0};
+    const int step = 4;
+    const int steps = STRESS_SECONDS * STRESS_DIVISION * 2 / step;
+    const int steps_per_note = STRESS_DIVISION * 4 / step;
+    uint32_t delay = 0;
+
+    for (int s = 0; s < steps; s++) {
+        for (int ch = 0; ch < 16; ch++) {
+            if (s % steps_per_note == 0) {
+                int note = 48 + (s / steps_per_note + ch) % 24;
+                if (s > 0) {
+                    int old_note = 48 + (s / steps_per_note - 1 + ch) % 24;
+                    put_event(&track, delay, NOTE_OFF | ch, (uint8_t)old_note, 0);
+                    put_event(&track, 0, NOTE_OFF | ch, (uint8_t)(old_note + 7), 0);
+                    delay = 0;
+                }
+                put_event(&track, delay, NOTE_ON | ch, (uint8_t)note, 100);
+                put_event(&track, 0, NOTE_ON | ch, (uint8_t)(note + 7), 100);
+                delay = 0;
+            }
+            int bend = 8192 + ((s * 97 + ch * 512) % 4096) - 2048;
+            put_event(&track, delay, PITCH_BEND | ch, bend & 0x7F, (bend >> 7) & 0x7F);
+            put_event(&track, 0, CONTROL_CHANGE | ch, 7, 64 + (s + ch * 4) % 64);
+            put_event(&track, 0, CONTROL_CHANGE | ch, 10, (s * 3 + ch * 8) % 128);
+            put_event(&track, 0, CONTROL_CHANGE | ch, 1, (s + ch) % 128);
+            delay = 0;
+        }
+        delay = step;
+    }
+    finish_file(file, &track, delay);
+}
+
+/*
+ * Measurement
+ */
+
+static double now_seconds(void) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Reset the peak resident size so each file reports its own; only Linux
+// supports this, elsewhere the peak covers the whole run so far
+static void reset_peak_rss(void) {
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0) return;
+    if (write(fd, "5", 1) != 1) {
+        // Kernel too old, keep the process-wide peak
+    }
+    close(fd);
+}
+
+static long peak_rss_kb(void) {
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f) {
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "VmHWM:", 6) == 0) {
+                kb = atol(line + 6);
+                break;
+            }
+        }
+        fclose(f);
+        if (kb >= 0) return kb;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// FNV-1a over the samples; the same build on the same input has to print
+// the same value, and a change means the synthesis output changed
+static uint64_t hash_samples(uint64_t hash, const int16_t *samples, int count) {
+    for (int i = 0; i < count; i++) {
+        hash ^= (uint16_t)samples[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool render_once(const char *name, const uint8_t *data, size_t size, BenchResult *result) {
+    MidiRenderer *renderer = midi_renderer_new(SAMPLE_RATE, 100);
+    if (!midi_renderer_load_data(renderer, data, size, name)) {
+        midi_renderer_free(renderer);
+        return false;
+    }
+    renderer->profile = true;
+
+    int16_t buffer[BENCH_BLOCK * AUDIO_CHANNELS];
+    uint64_t checksum = 14695981039346656037ULL;
+    uint64_t frames = 0;
+    int got;
+
+    reset_peak_rss();
+    double start = now_seconds();
+    while ((got = midi_renderer_render(renderer, buffer, BENCH_BLOCK)) > 0) {
+        checksum = hash_samples(checksum, buffer, got * AUDIO_CHANNELS);
+        frames += got;
+    }
+    result->wall_seconds = now_seconds() - start;
+    result->peak_rss_kb = peak_rss_kb();
+
+    result->events = renderer->events.count;
+    result->frames = frames;
+    result->audio_seconds = (double)frames / SAMPLE_RATE;
+    result->dispatch_seconds = renderer->dispatch_ns / 1e9;
+    result->synth_seconds = renderer->synth_ns / 1e9;
+    result->checksum = checksum;
+    midi_renderer_free(renderer);
+    return true;
+}
+
+static void print_json_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char*)text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void report(const char *name, const BenchResult *r) {
+    double wall = r->wall_seconds > 0 ? r->wall_seconds : 1e-9;
+    fprintf(results, "{\"name\":");
+    print_json_string(results, name);
+    fprintf(results, ",\"backend\":\"%s\",\"chips\":%d,\"sample_rate\":%d,\"events\":%d"
+            ",\"frames\":%llu,\"audio_seconds\":%.3f,\"wall_seconds\":%.6f"
+            ",\"realtime\":%.2f,\"samples_per_sec\":%.0f"
+            ",\"dispatch_seconds\":%.6f,\"synth_seconds\":%.6f"
+            ",\"peak_rss_kb\":%ld,\"checksum\":\"%016llx\"}\n",
+            DBOPL::SimdBackend(), opl_get_chip_count(), SAMPLE_RATE, r->events,
+            (unsigned long long)r->frames, r->audio_seconds, r->wall_seconds,
+            r->audio_seconds / wall, r->frames / wall,
+            r->dispatch_seconds, r->synth_seconds,
+            r->peak_rss_kb, (unsigned long long)r->checksum);
+    fflush(results);
+}
+
+// Render repeats times and report the fastest run
+static bool bench_data(const char *name, const uint8_t *data, size_t size, int repeats, BenchResult *total) {
+    BenchResult best;
+    memset(&best, 0, sizeof(best));
+    for (int i = 0; i < repeats; i++) {
+        BenchResult run;
+        if (!render_once(name, data, size, &run)) {
+            fprintf(stderr, "Skipping %s: not a playable MIDI file\n", name);
+            return false;
+        }
+        if (i == 0 || run.wall_seconds < best.wall_seconds) best = run;
+    }
+    report(name, &best);
+
+    fprintf(stderr, "%s: %.1f s of audio in %.3f s (%.0fx realtime)\n",
+            name, best.audio_seconds, best.wall_seconds,
+            best.audio_seconds / (best.wall_seconds > 0 ? best.wall_seconds : 1e-9));
+
+    total->events += best.events;
+    total->frames += best.frames;
+    total->audio_seconds += best.audio_seconds;
+    total->wall_seconds += best.wall_seconds;
+    total->dispatch_seconds += best.dispatch_seconds;
+    total->synth_seconds += best.synth_seconds;
+    if (best.peak_rss_kb > total->peak_rss_kb) total->peak_rss_kb = best.peak_rss_kb;
+    total->checksum = total->checksum * 31 + best.checksum;
+    return true;
+}
+
+static bool bench_file(const char *path, int repeats, BenchResult *total) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Could not open file %s\n", path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = size > 0 ? (uint8_t*)malloc(size) : NULL;
+    bool ok = data && fread(data, 1, size, f) == (size_t)size;
+    fclose(f);
+
+    if (ok) ok = bench_data(path, data, size, repeats, total);
+    else fprintf(stderr, "Error: Could not read file %s\n", path);
+    free(data);
+    return ok;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-c chips] [-n repeats] [-S] [file.mid ...]\n", program);
+    fprintf(stderr, "  -c chips    OPL3 chips per renderer (1-%d, default %d)\n", OPL_MAX_CHIPS, OPL_DEFAULT_CHIPS);
+    fprintf(stderr, "  -n repeats  Render each file this many times and keep the fastest (default 1)\n");
+    fprintf(stderr, "  -S          Skip the synthetic stress files\n");
+    fprintf(stderr, "Prints one JSON object per file on stdout, then a \"total\" line.\n");
+}
+
+int main(int argc, char *argv[]) {
+    int chips = OPL_DEFAULT_CHIPS;
+    int repeats = 1;
+    bool stress = true;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:n:Sh")) != -1) {
+        switch (opt) {
+            case 'c': chips = atoi(optarg); break;
+            case 'n': repeats = atoi(optarg); break;
+            case 'S': stress = false; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (chips < 1 || chips > OPL_MAX_CHIPS || repeats < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Results own stdout; everything the player prints goes to stderr
+    int results_fd = dup(STDOUT_FILENO);
+    results = results_fd >= 0 ? fdopen(results_fd, "w") : NULL;
+    if (!results) {
+        fprintf(stderr, "Error: Could not open the results stream\n");
+        return 1;
+    }
+    fflush(stdout);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    opl_set_chip_count(chips);
+
+    BenchResult total;
+    memset(&total, 0, sizeof(total));
+    int failures = 0;
+
+    for (int i = optind; i < argc; i++) {
+        if (!bench_file(argv[i], repeats, &total)) failures++;
+    }
+
+    if (stress) {
+        ByteBuffer file = {NULL, 0, 0};
+        build_polyphony_stress(&file);
+        if (!bench_data("stress:polyphony", file.data, file.size, repeats, &total)) failures++;
+        free(file.data);
+
+        memset(&file, 0, sizeof(file));
+        build_controller_stress(&file);
+        if (!bench_data("stress:controllers", file.data, file.size, repeats, &total)) failures++;
+        free(file.data);
+    }
+
+    report("total", &total);
+    fclose(results);
+    return failures ? 1 : 0;
+}